@@ -17,11 +17,29 @@
 
 #include "DearImGui.hpp"
 #include "Application.hpp"
+#include "OpenGL.hpp"
 
 #ifndef DGL_NO_SHARED_RESOURCES
 # include "src/Resources.hpp"
 #endif
 
+#ifndef DGL_NO_SHARED_RESOURCES
+# include <cmath>
+# include <cstdlib>
+# include <mutex>
+# include <thread>
+# include <vector>
+#endif
+
+#if !defined(DGL_NO_SHARED_RESOURCES) && !defined(IMGUI_DPF_NO_SHARED_FONT_ATLAS)
+# define IMGUI_DPF_SHARED_FONT_ATLAS
+# include <list>
+#endif
+
+#if defined(IMGUI_DPF_SDF_FONT_ATLAS) && !defined(DGL_NO_SHARED_RESOURCES) && (defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3))
+# define IMGUI_DPF_DISTANCE_FIELD_FONTS
+#endif
+
 #if defined(DGL_USE_GLES2)
 # define IMGUI_IMPL_OPENGL_ES2
 #elif defined(DGL_USE_GLES3)
@@ -30,8 +48,39 @@
 # define IMGUI_IMPL_OPENGL_LOADER_CUSTOM
 #endif
 
+// also needed when skipping the implementation, so that the backend header declares DPF specific calls
+#define IMGUI_DPF_BACKEND
+
+#ifndef DGL_NO_SHARED_RESOURCES
+// stb_truetype is provided here instead of by the ImGui implementation, with plain allocations.
+// ImGui allocations write debug info into the current ImGui context, which is a process-wide global,
+// so fonts can only be rasterized in background threads without going through ImGui.
+# if defined(__clang__)
+#  pragma clang diagnostic push
+#  pragma clang diagnostic ignored "-Wunused-function"
+#  pragma clang diagnostic ignored "-Wimplicit-fallthrough"
+# elif defined(__GNUC__)
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wunused-function"
+#  pragma GCC diagnostic ignored "-Wtype-limits"
+#  pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
+# endif
+# define STBRP_STATIC
+# define STB_RECT_PACK_IMPLEMENTATION
+# include "DearImGui/imstb_rectpack.h"
+# define STBTT_malloc(x,u) ((void)(u), std::malloc(x))
+# define STBTT_free(x,u)   ((void)(u), std::free(x))
+# define STBTT_STATIC
+# define STB_TRUETYPE_IMPLEMENTATION
+# include "DearImGui/imstb_truetype.h"
+# if defined(__clang__)
+#  pragma clang diagnostic pop
+# elif defined(__GNUC__)
+#  pragma GCC diagnostic pop
+# endif
+#endif
+
 #ifndef IMGUI_SKIP_IMPLEMENTATION
-# define IMGUI_DPF_BACKEND
 # include "DearImGui/imgui.cpp"
 # include "DearImGui/imgui_demo.cpp"
 # include "DearImGui/imgui_draw.cpp"
@@ -60,6 +109,14 @@ START_NAMESPACE_DGL
 
 // --------------------------------------------------------------------------------------------------------------------
 
+// amount of frames to repaint after receiving input, so that hover and click states can settle
+static constexpr const uint kLazyRepaintInputFrames = 3;
+
+// time in seconds for ImGui delayed hovering and animations, used to keep repainting while those are active
+static constexpr const float kLazyRepaintAnimationTime = 1.f;
+
+// --------------------------------------------------------------------------------------------------------------------
+
 static const char* GetClipboardTextFn(void* const userData)
 {
     TopLevelWidget* const tlw = static_cast<TopLevelWidget*>(userData);
@@ -77,6 +134,448 @@ static void SetClipboardTextFn(void* const userData, const char* const text)
     tlw->setClipboard(nullptr, text, std::strlen(text)+1);
 }
 
+#if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
+// --------------------------------------------------------------------------------------------------------------------
+// retained framebuffer helpers
+
+// fast non-cryptographic hash, used for detecting changes in draw data
+static uint64_t hashData(uint64_t hash, const void* const data, const size_t size) noexcept
+{
+    const uint8_t* const bytes = static_cast<const uint8_t*>(data);
+    size_t i = 0;
+
+    for (uint64_t word; i + sizeof(word) <= size; i += sizeof(word))
+    {
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 29;
+    }
+
+    if (i != size)
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, bytes + i, size - i);
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 29;
+    }
+
+    return hash;
+}
+
+// custom draw callbacks and textures other than the font atlas (e.g. images updated in place) can change
+// what is drawn without changing the draw data, those are reported as volatile
+static uint64_t hashDrawData(const ImDrawData* const data, const ImTextureID fontTexture, bool& isVolatile) noexcept
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (int i = 0; i < data->CmdListsCount; ++i)
+    {
+        const ImDrawList* const list = data->CmdLists[i];
+        const int sizes[3] = { list->VtxBuffer.Size, list->IdxBuffer.Size, list->CmdBuffer.Size };
+
+        hash = hashData(hash, sizes, sizeof(sizes));
+        hash = hashData(hash, list->VtxBuffer.Data, list->VtxBuffer.size_in_bytes());
+        hash = hashData(hash, list->IdxBuffer.Data, list->IdxBuffer.size_in_bytes());
+        hash = hashData(hash, list->CmdBuffer.Data, list->CmdBuffer.size_in_bytes());
+
+        for (const ImDrawCmd& cmd : list->CmdBuffer)
+        {
+            if (cmd.UserCallback != nullptr)
+            {
+                if (cmd.UserCallback != ImDrawCallback_ResetRenderState)
+                    isVolatile = true;
+            }
+            else if (cmd.GetTexID() != fontTexture)
+            {
+                isVolatile = true;
+            }
+        }
+    }
+
+    return hash;
+}
+
+// the framebuffer contents have premultiplied alpha, blend them as such
+static void SetPremultipliedAlphaBlendingCallback(const ImDrawList*, const ImDrawCmd*)
+{
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+#endif
+
+#ifndef DGL_NO_SHARED_RESOURCES
+// --------------------------------------------------------------------------------------------------------------------
+// font rasterizing
+
+#ifdef IMGUI_DPF_DISTANCE_FIELD_FONTS
+// size at which distance field fonts are rasterized, text of any size is drawn from it
+static constexpr const float kDistanceFieldFontSize = 28.f;
+
+// distance around glyph edges kept in the distance field, in atlas pixels
+static constexpr const int kDistanceFieldPadding = 4;
+#endif
+
+// configuration of the default font, without oversampling
+static ImFontConfig getDefaultFontConfig()
+{
+    ImFontConfig fc;
+    fc.FontDataOwnedByAtlas = false;
+    fc.OversampleH = 1;
+    fc.OversampleV = 1;
+    fc.PixelSnapH = true;
+    return fc;
+}
+
+// glyphs of the default ImGui range, rasterized without going through ImGui
+struct FontRaster {
+    struct Glyph {
+        ImWchar codepoint;
+        int width;
+        int height;
+        ImVec2 offset;
+        float advance;
+        size_t pixelOffset;
+    };
+
+    float fontSize;
+    std::vector<Glyph> glyphs;
+    std::vector<uchar> pixels;
+};
+
+// rasterize the glyphs of a font, font size is ignored for distance field fonts
+// ImGui is not used here, so this can be done in background threads
+static void rasterizeFont(FontRaster& raster, const void* const fontData, const float fontSize, const ImFontConfig& fc)
+{
+    const uchar* const data = static_cast<const uchar*>(fontData);
+    stbtt_fontinfo info;
+    DISTRHO_SAFE_ASSERT_RETURN(stbtt_InitFont(&info, data, stbtt_GetFontOffsetForIndex(data, 0)) != 0,);
+
+   #ifdef IMGUI_DPF_DISTANCE_FIELD_FONTS
+    raster.fontSize = kDistanceFieldFontSize;
+    (void)fontSize;
+   #else
+    // same as ImGui, which truncates font sizes
+    raster.fontSize = std::trunc(fontSize);
+   #endif
+
+    const float scale = stbtt_ScaleForPixelHeight(&info, raster.fontSize);
+
+    // glyphs are placed relative to the same baseline as the ones rasterized by ImGui
+    int ascent, descent, lineGap;
+    stbtt_GetFontVMetrics(&info, &ascent, &descent, &lineGap);
+    const float baseline = std::ceil(ascent * scale);
+
+    // space is left to ImGui, which takes the font metrics from it
+    for (int codepoint = 0x21; codepoint <= 0xff; ++codepoint)
+    {
+        const int index = stbtt_FindGlyphIndex(&info, codepoint);
+        if (index == 0)
+            continue;
+
+        int advance, leftSideBearing;
+        stbtt_GetGlyphHMetrics(&info, index, &advance, &leftSideBearing);
+
+        FontRaster::Glyph glyph = { static_cast<ImWchar>(codepoint), 0, 0, ImVec2(0.f, baseline),
+                                    advance * scale, raster.pixels.size() };
+
+       #ifdef IMGUI_DPF_DISTANCE_FIELD_FONTS
+        int offsetX, offsetY;
+        uchar* const pixels = stbtt_GetGlyphSDF(&info, scale, index, kDistanceFieldPadding,
+                                                128, 128.f / kDistanceFieldPadding,
+                                                &glyph.width, &glyph.height, &offsetX, &offsetY);
+        if (pixels != nullptr)
+        {
+            glyph.offset = ImVec2(offsetX, offsetY + baseline);
+            raster.pixels.insert(raster.pixels.end(), pixels, pixels + glyph.width * glyph.height);
+            stbtt_FreeSDF(pixels, nullptr);
+        }
+        else
+        {
+            glyph.width = glyph.height = 0;
+        }
+       #else
+        int x0, y0, x1, y1;
+        stbtt_GetGlyphBitmapBox(&info, index, scale, scale, &x0, &y0, &x1, &y1);
+
+        glyph.width = x1 - x0;
+        glyph.height = y1 - y0;
+        glyph.offset = ImVec2(x0, y0 + baseline);
+
+        if (fc.PixelSnapH)
+            glyph.advance = std::floor(glyph.advance + 0.5f);
+
+        if (glyph.width > 0 && glyph.height > 0)
+        {
+            raster.pixels.resize(raster.pixels.size() + glyph.width * glyph.height);
+            stbtt_MakeGlyphBitmap(&info, raster.pixels.data() + glyph.pixelOffset,
+                                  glyph.width, glyph.height, glyph.width, scale, scale, index);
+        }
+       #endif
+
+        raster.glyphs.push_back(glyph);
+    }
+}
+
+// add a rasterized font to an atlas and pack it, this is quick but uses ImGui, so it must be done on the UI thread
+static void buildFontAtlas(ImFontAtlas* const atlas, const void* const fontData, const int fontDataSize,
+                           const FontRaster& raster, const ImFontConfig& fc)
+{
+    // font metrics come from the regular rasterizer, only used for space
+    static const ImWchar spaceGlyphRange[] = { 0x20, 0x20, 0 };
+
+    ImFontConfig rfc(fc);
+   #ifdef IMGUI_DPF_DISTANCE_FIELD_FONTS
+    rfc.PixelSnapH = false;
+   #endif
+
+    ImFont* const font = atlas->AddFontFromMemoryTTF(const_cast<void*>(fontData), fontDataSize,
+                                                     raster.fontSize, &rfc, spaceGlyphRange);
+    DISTRHO_SAFE_ASSERT_RETURN(font != nullptr,);
+
+    // every other glyph is added as a custom rectangle, filled after packing
+    ImVector<int> rectIds;
+    rectIds.reserve(static_cast<int>(raster.glyphs.size()));
+
+    for (const FontRaster::Glyph& glyph : raster.glyphs)
+    {
+        if (glyph.width > 0 && glyph.height > 0)
+            rectIds.push_back(atlas->AddCustomRectFontGlyph(font, glyph.codepoint, glyph.width, glyph.height,
+                                                            glyph.advance, glyph.offset));
+        else
+            rectIds.push_back(-1);
+    }
+
+   #ifdef IMGUI_DPF_DISTANCE_FIELD_FONTS
+    // baked lines are regular coverage, which the distance field shader would distort
+    atlas->Flags |= ImFontAtlasFlags_NoBakedLines;
+   #endif
+    atlas->Build();
+
+    bool hasBlankGlyphs = false;
+
+    for (int i = 0; i < rectIds.Size; ++i)
+    {
+        const FontRaster::Glyph& glyph(raster.glyphs[i]);
+
+        if (rectIds[i] < 0)
+        {
+            hasBlankGlyphs = true;
+            continue;
+        }
+
+        const ImFontAtlasCustomRect* const rect = atlas->GetCustomRectByIndex(rectIds[i]);
+
+        for (int y = 0; y < glyph.height; ++y)
+            std::memcpy(atlas->TexPixelsAlpha8 + (rect->Y + y) * atlas->TexWidth + rect->X,
+                        raster.pixels.data() + glyph.pixelOffset + y * glyph.width, glyph.width);
+    }
+
+    if (! hasBlankGlyphs)
+        return;
+
+    // glyphs without pixels (e.g. non-breaking space) cannot be packed, they are added after building
+    // the tab glyph made by ImGui has to stay last, it is made again when rebuilding the lookup table
+    if (! font->Glyphs.empty() && font->Glyphs.back().Codepoint == '\t')
+        font->Glyphs.pop_back();
+
+    for (int i = 0; i < rectIds.Size; ++i)
+    {
+        const FontRaster::Glyph& glyph(raster.glyphs[i]);
+
+        if (rectIds[i] < 0)
+            font->AddGlyph(nullptr, glyph.codepoint, glyph.offset.x, glyph.offset.y, glyph.offset.x, glyph.offset.y,
+                           0.f, 0.f, 0.f, 0.f, glyph.advance);
+    }
+
+    font->BuildLookupTable();
+}
+#endif
+
+#ifdef IMGUI_DPF_SHARED_FONT_ATLAS
+// --------------------------------------------------------------------------------------------------------------------
+// font atlas cache, shared by all ImGui widgets of the same process
+
+struct ImGuiFontAtlasCache {
+    struct Texture {
+        uintptr_t graphicsContext;
+        GLuint id;
+        uint refCount;
+    };
+
+    struct Entry {
+        const void* fontData;
+        int fontDataSize;
+        float fontSize;
+        double scaleFactor;
+        int oversampleH;
+        int oversampleV;
+        ImFontAtlas* atlas;
+        uint refCount;
+        std::vector<Texture> textures;
+    };
+
+    std::mutex mutex;
+    std::list<Entry> entries;
+
+    static ImGuiFontAtlasCache& getInstance()
+    {
+        static ImGuiFontAtlasCache cache;
+        return cache;
+    }
+
+    // find or build a font atlas, increasing its reference count, must be called from the UI thread
+    // glyphs are rasterized here unless given, as done by background threads
+    Entry* acquire(const void* const fontData, const int fontDataSize, const float fontSize, const double scaleFactor,
+                   const FontRaster* raster, bool* const built = nullptr)
+    {
+        const ImFontConfig fc(getDefaultFontConfig());
+        const std::lock_guard<std::mutex> lock(mutex);
+
+        if (Entry* const entry = find(fontData, fontDataSize, fontSize, scaleFactor, fc))
+        {
+            ++entry->refCount;
+            return entry;
+        }
+
+        FontRaster localRaster;
+
+        if (raster == nullptr)
+        {
+            rasterizeFont(localRaster, fontData, fontSize * scaleFactor, fc);
+            raster = &localRaster;
+        }
+
+        ImFontAtlas* const atlas = IM_NEW(ImFontAtlas)();
+        buildFontAtlas(atlas, fontData, fontDataSize, *raster, fc);
+
+        // keep RGBA pixels around, so uploading to other graphics contexts does not need rasterizing again
+        uchar* pixels;
+        int width, height;
+        atlas->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+        if (built != nullptr)
+            *built = true;
+
+        entries.push_back({ fontData, fontDataSize, fontSize, scaleFactor, fc.OversampleH, fc.OversampleV,
+                            atlas, 1, std::vector<Texture>() });
+        return &entries.back();
+    }
+
+    // decrease reference count of a font atlas, deleting it when no longer used
+    void release(Entry* const entry)
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+
+        DISTRHO_SAFE_ASSERT_RETURN(entry->refCount != 0,);
+
+        if (--entry->refCount != 0)
+            return;
+
+        DISTRHO_SAFE_ASSERT(entry->textures.empty());
+
+        IM_DELETE(entry->atlas);
+
+        for (std::list<Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+        {
+            if (&*it == entry)
+            {
+                entries.erase(it);
+                break;
+            }
+        }
+    }
+
+    // check if a font atlas is already built, so its glyphs do not need rasterizing, can be used from background threads
+    bool contains(const void* const fontData, const int fontDataSize, const float fontSize, const double scaleFactor)
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        return find(fontData, fontDataSize, fontSize, scaleFactor, getDefaultFontConfig()) != nullptr;
+    }
+
+    // find a matching font atlas, must be called with the lock held
+    Entry* find(const void* const fontData, const int fontDataSize, const float fontSize, const double scaleFactor,
+                const ImFontConfig& fc)
+    {
+        for (Entry& entry : entries)
+        {
+            if (entry.fontData == fontData &&
+                entry.fontDataSize == fontDataSize &&
+                d_isEqual(entry.fontSize, fontSize) &&
+                d_isEqual(entry.scaleFactor, scaleFactor) &&
+                entry.oversampleH == fc.OversampleH &&
+                entry.oversampleV == fc.OversampleV)
+            {
+                return &entry;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // find or upload the texture of a font atlas for a graphics context, which must be active
+    ImTextureID acquireTexture(Entry* const entry, const uintptr_t graphicsContext)
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+
+        for (Texture& texture : entry->textures)
+        {
+            if (texture.graphicsContext == graphicsContext)
+            {
+                ++texture.refCount;
+                return (ImTextureID)(intptr_t)texture.id;
+            }
+        }
+
+        uchar* pixels;
+        int width, height;
+        entry->atlas->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+        GLint lastTexture;
+        GLuint textureId = 0;
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &lastTexture);
+        glGenTextures(1, &textureId);
+        glBindTexture(GL_TEXTURE_2D, textureId);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+       #if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+       #else
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+       #endif
+       #ifdef GL_UNPACK_ROW_LENGTH
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+       #endif
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glBindTexture(GL_TEXTURE_2D, lastTexture);
+
+        entry->textures.push_back({ graphicsContext, textureId, 1 });
+        return (ImTextureID)(intptr_t)textureId;
+    }
+
+    // decrease reference count of a font atlas texture, deleting it when no longer used
+    void releaseTexture(Entry* const entry, const uintptr_t graphicsContext)
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+
+        for (std::vector<Texture>::iterator it = entry->textures.begin(); it != entry->textures.end(); ++it)
+        {
+            if (it->graphicsContext != graphicsContext)
+                continue;
+
+            if (--it->refCount == 0)
+            {
+                glDeleteTextures(1, &it->id);
+                entry->textures.erase(it);
+            }
+            return;
+        }
+    }
+};
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+
 template <class BaseWidget>
 struct ImGuiWidget<BaseWidget>::PrivateData {
     ImGuiWidget<BaseWidget>* const self;
@@ -84,16 +583,125 @@ struct ImGuiWidget<BaseWidget>::PrivateData {
     double scaleFactor;
     double lastFrameTime;
     uint lastModifiers;
+    bool lazyRepaint;
+    uint minFps;
+    uint maxFps;
+    uint pendingFrames;
+    uint32_t skippedFrames;
+    bool coalesceDrawCommands;
+    uint mergedDrawCommands;
+    ImVector<ImDrawList*> coalescedDrawLists;
+    ImDrawData coalescedDrawData;
+    bool coalesceInput;
+    bool hasPendingMousePos;
+    ImVec2 pendingMousePos;
+    ImVec2 pendingMouseWheel;
+   #ifdef IMGUI_DPF_SHARED_FONT_ATLAS
+    ImGuiFontAtlasCache::Entry* fontAtlas;
+    ImTextureID fontTexture;
+   #endif
+   #ifndef DGL_NO_SHARED_RESOURCES
+    // font rasterized by buildFont(), its atlas is built on the UI thread by swapFontBuildResult()
+    struct FontBuild {
+        float fontSize;
+        double scaleFactor;
+        bool rasterized;
+        FontRaster raster;
+    };
+    mutable std::mutex fontBuildMutex;
+    std::thread fontBuildThread;
+    bool fontBuildRunning;
+    float fontBuildRequest;
+    double fontBuildScaleFactor;
+    FontBuild* fontBuildResult;
+   #endif
+   #if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
+    bool retainedFramebuffer;
+    GLuint framebuffer;
+    GLuint framebufferTexture;
+    int framebufferWidth;
+    int framebufferHeight;
+    uint64_t framebufferHash;
+    ImDrawList* framebufferDrawList;
+   #endif
+   #ifdef IMGUI_DPF_FRAME_STATS
+    ImGuiFrameStats frameStats[kFrameStatsHistorySize];
+    ImGuiFrameStats currentFrameStats;
+    uint frameStatsIndex;
+    uint frameStatsCount;
+    bool frameStatsOverlay;
+   #endif
 
     explicit PrivateData(ImGuiWidget<BaseWidget>* const s, const float fontSize)
         : self(s),
           context(nullptr),
           scaleFactor(s->getTopLevelWidget()->getScaleFactor()),
           lastFrameTime(0.0),
-          lastModifiers(0)
+          lastModifiers(0),
+          lazyRepaint(false),
+          minFps(0),
+          maxFps(60),
+          pendingFrames(kLazyRepaintInputFrames),
+          skippedFrames(0),
+          coalesceDrawCommands(false),
+          mergedDrawCommands(0),
+          coalescedDrawLists(),
+          coalescedDrawData(),
+          coalesceInput(true),
+          hasPendingMousePos(false),
+          pendingMousePos(),
+          pendingMouseWheel()
+       #ifdef IMGUI_DPF_SHARED_FONT_ATLAS
+        , fontAtlas(nullptr),
+          fontTexture(0)
+       #endif
+       #ifndef DGL_NO_SHARED_RESOURCES
+        , fontBuildMutex(),
+          fontBuildThread(),
+          fontBuildRunning(false),
+          fontBuildRequest(0.f),
+          fontBuildScaleFactor(1.0),
+          fontBuildResult(nullptr)
+       #endif
+       #if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
+        , retainedFramebuffer(false),
+          framebuffer(0),
+          framebufferTexture(0),
+          framebufferWidth(0),
+          framebufferHeight(0),
+          framebufferHash(0),
+          framebufferDrawList(nullptr)
+       #endif
+       #ifdef IMGUI_DPF_FRAME_STATS
+        , frameStats(),
+          currentFrameStats(),
+          frameStatsIndex(0),
+          frameStatsCount(0),
+          frameStatsOverlay(false)
+       #endif
     {
         IMGUI_CHECKVERSION();
+
+       #ifdef IMGUI_DPF_SHARED_FONT_ATLAS
+        using namespace dpf_resources;
+        bool built = false;
+       #ifdef IMGUI_DPF_DISTANCE_FIELD_FONTS
+        // a single distance field atlas serves all font sizes and scale factors
+        fontAtlas = ImGuiFontAtlasCache::getInstance().acquire(dejavusans_ttf, dejavusans_ttf_size,
+                                                               kDistanceFieldFontSize, 1.0, nullptr, &built);
+       #else
+        fontAtlas = ImGuiFontAtlasCache::getInstance().acquire(dejavusans_ttf, dejavusans_ttf_size,
+                                                               fontSize, scaleFactor, nullptr, &built);
+       #endif
+       #ifdef IMGUI_DPF_FRAME_STATS
+        currentFrameStats.atlasRebuilds += built ? 1 : 0;
+       #else
+        (void)built;
+       #endif
+        context = ImGui::CreateContext(fontAtlas->atlas);
+       #else
         context = ImGui::CreateContext();
+       #endif
         ImGui::SetCurrentContext(context);
 
         ImGuiIO& io(ImGui::GetIO());
@@ -108,15 +716,15 @@ struct ImGuiWidget<BaseWidget>::PrivateData {
         ImGuiStyle& style(ImGui::GetStyle());
         style.ScaleAllSizes(scaleFactor);
 
-       #ifndef DGL_NO_SHARED_RESOURCES
+       #if !defined(DGL_NO_SHARED_RESOURCES) && !defined(IMGUI_DPF_SHARED_FONT_ATLAS)
         using namespace dpf_resources;
-        ImFontConfig fc;
-        fc.FontDataOwnedByAtlas = false;
-        fc.OversampleH = 1;
-        fc.OversampleV = 1;
-        fc.PixelSnapH = true;
-        io.Fonts->AddFontFromMemoryTTF((void*)dejavusans_ttf, dejavusans_ttf_size, fontSize * scaleFactor, &fc);
-        io.Fonts->Build();
+        const ImFontConfig fc(getDefaultFontConfig());
+        FontRaster raster;
+        rasterizeFont(raster, dejavusans_ttf, fontSize * scaleFactor, fc);
+        buildFontAtlas(io.Fonts, dejavusans_ttf, dejavusans_ttf_size, raster, fc);
+       #ifdef IMGUI_DPF_FRAME_STATS
+        ++currentFrameStats.atlasRebuilds;
+       #endif
        #endif
 
         io.GetClipboardTextFn = GetClipboardTextFn;
@@ -125,25 +733,64 @@ struct ImGuiWidget<BaseWidget>::PrivateData {
 
        #if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
         ImGui_ImplOpenGL3_Init();
+        // widgets on the same window share shader programs, only the first one compiles them
+        ImGui_ImplOpenGL3_DPF_SetProgramCacheKey(getGraphicsContextKey());
        #else
         ImGui_ImplOpenGL2_Init();
        #endif
+
+       #ifdef IMGUI_DPF_SHARED_FONT_ATLAS
+        fontTexture = ImGuiFontAtlasCache::getInstance().acquireTexture(fontAtlas, getGraphicsContextKey());
+       #endif
+
+       #ifdef IMGUI_DPF_DISTANCE_FIELD_FONTS
+        if (! ImGui_ImplOpenGL3_DPF_SetDistanceFieldFonts(true))
+            d_stderr2("ImGuiWidget: distance field fonts are not supported by this OpenGL version");
+
+        setFontScale(fontSize, scaleFactor);
+       #endif
     }
 
     ~PrivateData()
     {
+       #ifndef DGL_NO_SHARED_RESOURCES
+        cancelFontBuild();
+
+        if (fontBuildThread.joinable())
+            fontBuildThread.join();
+       #endif
+
         ImGui::SetCurrentContext(context);
        #if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
+        destroyFramebuffer();
         ImGui_ImplOpenGL3_Shutdown();
        #else
         ImGui_ImplOpenGL2_Shutdown();
        #endif
+
+        for (ImDrawList* list : coalescedDrawLists)
+            IM_DELETE(list);
+
         ImGui::DestroyContext(context);
+
+       #ifdef IMGUI_DPF_SHARED_FONT_ATLAS
+        ImGuiFontAtlasCache& cache(ImGuiFontAtlasCache::getInstance());
+        cache.releaseTexture(fontAtlas, getGraphicsContextKey());
+        cache.release(fontAtlas);
+       #endif
     }
 
     float getDisplayX() const noexcept;
     float getDisplayY() const noexcept;
     double getTime() const noexcept;
+    void addIdleCallback();
+    void removeIdleCallback();
+
+    // each DGL window has its own graphics context, shared by all of its widgets
+    inline uintptr_t getGraphicsContextKey() const noexcept
+    {
+        return reinterpret_cast<uintptr_t>(&self->getTopLevelWidget()->getWindow());
+    }
 
     inline double getTimeDelta() noexcept
     {
@@ -158,6 +805,9 @@ struct ImGuiWidget<BaseWidget>::PrivateData {
         if (lastModifiers == mods)
             return;
 
+        // modifiers apply to what comes after, e.g. ctrl+wheel
+        flushPendingInput(io);
+
         if ((mods & kModifierShift) != (lastModifiers & kModifierShift))
             io.AddKeyEvent(ImGuiMod_Shift, mods & kModifierShift);
 
@@ -173,6 +823,602 @@ struct ImGuiWidget<BaseWidget>::PrivateData {
         lastModifiers = mods;
     }
 
+   #ifndef DGL_NO_SHARED_RESOURCES
+    // rasterize the default font at a given size, ImGui is not used here so this can be done in background threads
+    FontBuild* buildFont(const float fontSize, const double scaleFactor)
+    {
+        using namespace dpf_resources;
+
+        FontBuild* const font = new FontBuild();
+        font->fontSize = fontSize;
+        font->scaleFactor = scaleFactor;
+
+       #ifdef IMGUI_DPF_SHARED_FONT_ATLAS
+        // no need to rasterize a font that other widgets already use
+        font->rasterized = ! ImGuiFontAtlasCache::getInstance().contains(dejavusans_ttf, dejavusans_ttf_size,
+                                                                         fontSize, scaleFactor);
+       #else
+        font->rasterized = true;
+       #endif
+
+        if (font->rasterized)
+            rasterizeFont(font->raster, dejavusans_ttf, fontSize * scaleFactor, getDefaultFontConfig());
+
+        return font;
+    }
+
+   #ifdef IMGUI_DPF_DISTANCE_FIELD_FONTS
+    // distance field fonts are drawn at any size from the same atlas, only their scale changes
+    void setFontScale(const float fontSize, const double scaleFactor)
+    {
+        ImGui::SetCurrentContext(context);
+        ImGui::GetIO().FontGlobalScale = fontSize * scaleFactor / kDistanceFieldFontSize;
+    }
+   #endif
+
+    // background thread, rasterizes the requested font size until no new size is requested
+    void runFontBuild()
+    {
+        std::unique_lock<std::mutex> lock(fontBuildMutex);
+
+        while (fontBuildRequest > 0.f)
+        {
+            const float fontSize = fontBuildRequest;
+            const double scaleFactor = fontBuildScaleFactor;
+
+            lock.unlock();
+            FontBuild* const font = buildFont(fontSize, scaleFactor);
+            lock.lock();
+
+            // cancelled by a synchronous font size change
+            if (fontBuildRequest <= 0.f)
+            {
+                delete font;
+                break;
+            }
+
+            // results for outdated sizes are still used if a frame happens before the next build is done
+            delete fontBuildResult;
+            fontBuildResult = font;
+
+            if (d_isEqual(fontBuildRequest, fontSize) && d_isEqual(fontBuildScaleFactor, scaleFactor))
+                fontBuildRequest = 0.f;
+        }
+
+        fontBuildRunning = false;
+    }
+
+    void requestFontBuild(const float fontSize, const double scaleFactor)
+    {
+        std::unique_lock<std::mutex> lock(fontBuildMutex);
+        fontBuildRequest = fontSize;
+        fontBuildScaleFactor = scaleFactor;
+
+        if (fontBuildRunning)
+            return;
+
+        fontBuildRunning = true;
+        lock.unlock();
+
+        // previous thread is done, but still needs to be joined
+        if (fontBuildThread.joinable())
+            fontBuildThread.join();
+
+        fontBuildThread = std::thread(&PrivateData::runFontBuild, this);
+    }
+
+    void cancelFontBuild()
+    {
+        const std::lock_guard<std::mutex> lock(fontBuildMutex);
+        fontBuildRequest = 0.f;
+
+        delete fontBuildResult;
+        fontBuildResult = nullptr;
+    }
+
+    void setFontBuildResult(FontBuild* const font)
+    {
+        const std::lock_guard<std::mutex> lock(fontBuildMutex);
+        DISTRHO_SAFE_ASSERT(fontBuildResult == nullptr);
+
+        fontBuildResult = font;
+    }
+
+    bool hasFontBuildResult() const
+    {
+        const std::lock_guard<std::mutex> lock(fontBuildMutex);
+        return fontBuildResult != nullptr;
+    }
+
+    // build the atlas of a newly rasterized font and swap it in with its texture, must be called before a new frame
+    void swapFontBuildResult(ImGuiIO& io)
+    {
+        FontBuild* font;
+
+        {
+            const std::lock_guard<std::mutex> lock(fontBuildMutex);
+            font = fontBuildResult;
+            fontBuildResult = nullptr;
+        }
+
+        if (font == nullptr)
+            return;
+
+        using namespace dpf_resources;
+
+       #ifdef IMGUI_DPF_SHARED_FONT_ATLAS
+        ImGuiFontAtlasCache& cache(ImGuiFontAtlasCache::getInstance());
+        bool built = false;
+
+        // an atlas that was not rasterized might have been released since, it is rasterized here then
+        ImGuiFontAtlasCache::Entry* const entry = cache.acquire(dejavusans_ttf, dejavusans_ttf_size,
+                                                                font->fontSize, font->scaleFactor,
+                                                                font->rasterized ? &font->raster : nullptr, &built);
+        delete font;
+
+       #ifdef IMGUI_DPF_FRAME_STATS
+        currentFrameStats.atlasRebuilds += built ? 1 : 0;
+       #endif
+
+        if (entry != fontAtlas)
+        {
+            const uintptr_t graphicsContext = getGraphicsContextKey();
+            fontTexture = cache.acquireTexture(entry, graphicsContext);
+            cache.releaseTexture(fontAtlas, graphicsContext);
+            cache.release(fontAtlas);
+            fontAtlas = entry;
+            io.Fonts = entry->atlas;
+        }
+        else
+        {
+            cache.release(entry);
+        }
+       #else
+        // the backend creates a new font texture on the next frame
+       #if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
+        ImGui_ImplOpenGL3_DestroyFontsTexture();
+       #else
+        ImGui_ImplOpenGL2_DestroyFontsTexture();
+       #endif
+        // the font atlas is owned by the context
+        IM_DELETE(io.Fonts);
+        io.Fonts = IM_NEW(ImFontAtlas)();
+        buildFontAtlas(io.Fonts, dejavusans_ttf, dejavusans_ttf_size, font->raster, getDefaultFontConfig());
+        delete font;
+
+       #ifdef IMGUI_DPF_FRAME_STATS
+        ++currentFrameStats.atlasRebuilds;
+       #endif
+       #endif
+    }
+   #endif
+
+    // mouse motion and wheel events are coalesced into one per frame, as ImGui would otherwise replay every single one
+    void addMousePos(ImGuiIO& io, const ImVec2& pos)
+    {
+        if (! coalesceInput)
+        {
+            io.AddMousePosEvent(pos.x, pos.y);
+            return;
+        }
+
+        // keep pending wheel events at the position they happened
+        if (pendingMouseWheel.x != 0.f || pendingMouseWheel.y != 0.f)
+            flushPendingInput(io);
+
+        pendingMousePos = pos;
+        hasPendingMousePos = true;
+    }
+
+    void addMouseWheel(ImGuiIO& io, const ImVec2& delta)
+    {
+        if (! coalesceInput)
+        {
+            io.AddMouseWheelEvent(delta.x, delta.y);
+            return;
+        }
+
+        pendingMouseWheel += delta;
+    }
+
+    // give pending mouse motion and wheel events to ImGui, must be called before any other event to keep their order
+    void flushPendingInput(ImGuiIO& io)
+    {
+        if (hasPendingMousePos)
+        {
+            io.AddMousePosEvent(pendingMousePos.x, pendingMousePos.y);
+            hasPendingMousePos = false;
+        }
+
+        if (pendingMouseWheel.x != 0.f || pendingMouseWheel.y != 0.f)
+        {
+            io.AddMouseWheelEvent(pendingMouseWheel.x, pendingMouseWheel.y);
+            pendingMouseWheel = ImVec2();
+        }
+    }
+
+   #if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
+    bool createFramebuffer(const int width, const int height)
+    {
+        destroyFramebuffer();
+
+        GLint lastFramebuffer, lastTexture;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &lastFramebuffer);
+        glGetIntegerv(GL_TEXTURE_BINDING_2D, &lastTexture);
+
+        glGenTextures(1, &framebufferTexture);
+        glBindTexture(GL_TEXTURE_2D, framebufferTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebufferTexture, 0);
+        const bool ok = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, lastFramebuffer);
+        glBindTexture(GL_TEXTURE_2D, lastTexture);
+
+        if (! ok)
+        {
+            d_stderr2("ImGuiWidget: failed to create framebuffer, retained rendering disabled");
+            destroyFramebuffer();
+            retainedFramebuffer = false;
+            return false;
+        }
+
+        framebufferWidth = width;
+        framebufferHeight = height;
+        return true;
+    }
+
+    void destroyFramebuffer()
+    {
+        if (framebuffer != 0)
+        {
+            glDeleteFramebuffers(1, &framebuffer);
+            framebuffer = 0;
+        }
+
+        if (framebufferTexture != 0)
+        {
+            glDeleteTextures(1, &framebufferTexture);
+            framebufferTexture = 0;
+        }
+
+        if (framebufferDrawList != nullptr)
+        {
+            IM_DELETE(framebufferDrawList);
+            framebufferDrawList = nullptr;
+        }
+
+        framebufferWidth = framebufferHeight = 0;
+    }
+
+    // render draw data into the retained framebuffer if changed, then draw its texture
+    bool renderRetained(ImDrawData* const data)
+    {
+        const int width = static_cast<int>(data->DisplaySize.x * data->FramebufferScale.x);
+        const int height = static_cast<int>(data->DisplaySize.y * data->FramebufferScale.y);
+        DISTRHO_SAFE_ASSERT_RETURN(width > 0 && height > 0, false);
+
+        bool isVolatile = false;
+        const uint64_t hash = hashDrawData(data, ImGui::GetIO().Fonts->TexID, isVolatile);
+
+        // custom draw callbacks and images can change their output at any time, cannot cache them
+        if (isVolatile)
+            return false;
+
+        bool needsRender = hash != framebufferHash;
+
+        if (framebuffer == 0 || framebufferWidth != width || framebufferHeight != height)
+        {
+            if (! createFramebuffer(width, height))
+                return false;
+
+            needsRender = true;
+        }
+
+        if (needsRender)
+        {
+            GLint lastFramebuffer;
+            GLfloat lastClearColor[4];
+            glGetIntegerv(GL_FRAMEBUFFER_BINDING, &lastFramebuffer);
+            glGetFloatv(GL_COLOR_CLEAR_VALUE, lastClearColor);
+            const GLboolean lastScissorTest = glIsEnabled(GL_SCISSOR_TEST);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glDisable(GL_SCISSOR_TEST);
+            glClearColor(0.f, 0.f, 0.f, 0.f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            data->DisplayPos = ImVec2(0.f, 0.f);
+            ImGui_ImplOpenGL3_RenderDrawData(data);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, lastFramebuffer);
+            glClearColor(lastClearColor[0], lastClearColor[1], lastClearColor[2], lastClearColor[3]);
+            if (lastScissorTest)
+                glEnable(GL_SCISSOR_TEST);
+
+            framebufferHash = hash;
+        }
+
+        if (framebufferDrawList == nullptr)
+            framebufferDrawList = IM_NEW(ImDrawList)(ImGui::GetDrawListSharedData());
+
+        // framebuffer texture is bottom-up, flip it vertically
+        ImDrawList* const dl = framebufferDrawList;
+        dl->_ResetForNewFrame();
+        dl->PushClipRectFullScreen();
+        dl->AddCallback(SetPremultipliedAlphaBlendingCallback, nullptr);
+        dl->AddImage((ImTextureID)(intptr_t)framebufferTexture,
+                     ImVec2(0.f, 0.f), data->DisplaySize, ImVec2(0.f, 1.f), ImVec2(1.f, 0.f));
+        dl->PopClipRect();
+
+        ImDrawData blitData;
+        blitData.Valid = true;
+        blitData.DisplayPos = ImVec2(-getDisplayX(), getDisplayY());
+        blitData.DisplaySize = data->DisplaySize;
+        blitData.FramebufferScale = data->FramebufferScale;
+        blitData.AddDrawList(dl);
+        ImGui_ImplOpenGL3_RenderDrawData(&blitData);
+        return true;
+    }
+   #endif
+
+    // join all draw lists into as few as possible, merging adjacent draw commands with the same state
+    ImDrawData* coalesceDrawData(ImDrawData* const data)
+    {
+        mergedDrawCommands = 0;
+
+        for (int i = 0; i < data->CmdListsCount; ++i)
+        {
+            const ImDrawList* const list = data->CmdLists[i];
+
+            // lists too big for rebasing 16-bit indices are only possible with vertex offsets, keep those as-is
+            if (sizeof(ImDrawIdx) == 2 && list->VtxBuffer.Size > 0x10000)
+                return data;
+
+            // custom draw callbacks receive their own draw list as argument, keep those as-is too
+            for (const ImDrawCmd& cmd : list->CmdBuffer)
+            {
+                if (cmd.UserCallback != nullptr && cmd.UserCallback != ImDrawCallback_ResetRenderState)
+                    return data;
+            }
+        }
+
+        int numLists = 0;
+        ImDrawList* out = nullptr;
+        bool lastUnclipped = false;
+
+        for (int i = 0; i < data->CmdListsCount; ++i)
+        {
+            const ImDrawList* const list = data->CmdLists[i];
+
+            if (out == nullptr || (sizeof(ImDrawIdx) == 2 && out->VtxBuffer.Size + list->VtxBuffer.Size > 0x10000))
+            {
+                if (numLists == coalescedDrawLists.Size)
+                    coalescedDrawLists.push_back(IM_NEW(ImDrawList)(ImGui::GetDrawListSharedData()));
+
+                out = coalescedDrawLists[numLists++];
+                out->CmdBuffer.resize(0);
+                out->IdxBuffer.resize(0);
+                out->VtxBuffer.resize(0);
+                lastUnclipped = false;
+            }
+
+            const int vtxStart = out->VtxBuffer.Size;
+            out->VtxBuffer.resize(vtxStart + list->VtxBuffer.Size);
+            std::memcpy(out->VtxBuffer.Data + vtxStart, list->VtxBuffer.Data, list->VtxBuffer.size_in_bytes());
+
+            for (const ImDrawCmd& cmd : list->CmdBuffer)
+            {
+                // copy indices of this command, rebased to the start of its vertices in the joined list,
+                // while finding the bounds of its geometry
+                const ImDrawIdx* const srcIdx = list->IdxBuffer.Data + cmd.IdxOffset;
+                const ImDrawVert* const srcVtx = list->VtxBuffer.Data + cmd.VtxOffset;
+                const int idxStart = out->IdxBuffer.Size;
+                const uint vtxOffset = vtxStart + cmd.VtxOffset;
+                ImVec2 boundsMin(FLT_MAX, FLT_MAX);
+                ImVec2 boundsMax(-FLT_MAX, -FLT_MAX);
+                out->IdxBuffer.resize(idxStart + cmd.ElemCount);
+
+                for (uint j = 0; j < cmd.ElemCount; ++j)
+                {
+                    const ImVec2& pos(srcVtx[srcIdx[j]].pos);
+                    boundsMin = ImMin(boundsMin, pos);
+                    boundsMax = ImMax(boundsMax, pos);
+                    out->IdxBuffer.Data[idxStart + j] = static_cast<ImDrawIdx>(srcIdx[j] + vtxOffset);
+                }
+
+                // geometry fully inside the clip rectangle (with a safety margin for scissor rounding)
+                // does not depend on it, so the clip rectangle can be enlarged
+                const bool unclipped = cmd.UserCallback == nullptr &&
+                                       boundsMin.x >= cmd.ClipRect.x + 1.f && boundsMin.y >= cmd.ClipRect.y + 1.f &&
+                                       boundsMax.x <= cmd.ClipRect.z - 1.f && boundsMax.y <= cmd.ClipRect.w - 1.f;
+
+                if (out->CmdBuffer.Size != 0)
+                {
+                    ImDrawCmd& prev(out->CmdBuffer.back());
+
+                    if (cmd.UserCallback == nullptr && prev.UserCallback == nullptr &&
+                        cmd.GetTexID() == prev.GetTexID())
+                    {
+                        if (std::memcmp(&cmd.ClipRect, &prev.ClipRect, sizeof(ImVec4)) == 0)
+                        {
+                            prev.ElemCount += cmd.ElemCount;
+                            lastUnclipped = lastUnclipped && unclipped;
+                            ++mergedDrawCommands;
+                            continue;
+                        }
+
+                        if (lastUnclipped && unclipped)
+                        {
+                            prev.ClipRect.x = ImMin(prev.ClipRect.x, cmd.ClipRect.x);
+                            prev.ClipRect.y = ImMin(prev.ClipRect.y, cmd.ClipRect.y);
+                            prev.ClipRect.z = ImMax(prev.ClipRect.z, cmd.ClipRect.z);
+                            prev.ClipRect.w = ImMax(prev.ClipRect.w, cmd.ClipRect.w);
+                            prev.ElemCount += cmd.ElemCount;
+                            ++mergedDrawCommands;
+                            continue;
+                        }
+                    }
+                }
+
+                out->CmdBuffer.push_back(cmd);
+                out->CmdBuffer.back().VtxOffset = 0;
+                out->CmdBuffer.back().IdxOffset = idxStart;
+                lastUnclipped = unclipped;
+            }
+        }
+
+        ImDrawData& coalesced(coalescedDrawData);
+        coalesced.Valid = true;
+        coalesced.CmdListsCount = numLists;
+        coalesced.TotalIdxCount = data->TotalIdxCount;
+        coalesced.TotalVtxCount = data->TotalVtxCount;
+        coalesced.CmdLists.resize(0);
+        for (int i = 0; i < numLists; ++i)
+            coalesced.CmdLists.push_back(coalescedDrawLists[i]);
+        coalesced.DisplayPos = data->DisplayPos;
+        coalesced.DisplaySize = data->DisplaySize;
+        coalesced.FramebufferScale = data->FramebufferScale;
+        coalesced.OwnerViewport = data->OwnerViewport;
+        return &coalesced;
+    }
+
+    void renderDrawData(ImDrawData* data)
+    {
+        if (coalesceDrawCommands)
+            data = coalesceDrawData(data);
+
+       #if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
+        if (retainedFramebuffer && renderRetained(data))
+            return;
+       #endif
+
+        data->DisplayPos.x = -getDisplayX();
+        data->DisplayPos.y = getDisplayY();
+       #if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
+        ImGui_ImplOpenGL3_RenderDrawData(data);
+       #else
+        ImGui_ImplOpenGL2_RenderDrawData(data);
+       #endif
+    }
+
+   #ifdef IMGUI_DPF_FRAME_STATS
+    void pushFrameStats(const ImDrawData* const data, const double frameStartTime, const double newFrameEndTime,
+                        const double displayEndTime, const double renderEndTime, const double submitEndTime)
+    {
+        ImGuiFrameStats& stats(currentFrameStats);
+        stats.newFrameTime = (newFrameEndTime - frameStartTime) * 1000.0;
+        stats.displayTime = (displayEndTime - newFrameEndTime) * 1000.0;
+        stats.renderTime = (renderEndTime - displayEndTime) * 1000.0;
+        stats.submitTime = (submitEndTime - renderEndTime) * 1000.0;
+
+        if (data != nullptr)
+        {
+            stats.vertexCount = data->TotalVtxCount;
+            stats.indexCount = data->TotalIdxCount;
+            stats.drawListCount = data->CmdListsCount;
+            stats.mergedDrawCommandCount = mergedDrawCommands;
+
+            for (int i = 0; i < data->CmdListsCount; ++i)
+                stats.drawCommandCount += data->CmdLists[i]->CmdBuffer.Size;
+        }
+
+        frameStats[frameStatsIndex] = stats;
+        frameStatsIndex = (frameStatsIndex + 1) % kFrameStatsHistorySize;
+
+        if (frameStatsCount < kFrameStatsHistorySize)
+            ++frameStatsCount;
+
+        stats = ImGuiFrameStats();
+    }
+
+    void showFrameStatsOverlay()
+    {
+        if (frameStatsCount == 0)
+            return;
+
+        float frameTimes[kFrameStatsHistorySize];
+        ImGuiFrameStats average = {};
+
+        for (uint i = 0; i < frameStatsCount; ++i)
+        {
+            const ImGuiFrameStats& stats(frameStats[(frameStatsIndex + kFrameStatsHistorySize - frameStatsCount + i)
+                                                    % kFrameStatsHistorySize]);
+            frameTimes[i] = stats.newFrameTime + stats.displayTime + stats.renderTime + stats.submitTime;
+            average.newFrameTime += stats.newFrameTime / frameStatsCount;
+            average.displayTime += stats.displayTime / frameStatsCount;
+            average.renderTime += stats.renderTime / frameStatsCount;
+            average.submitTime += stats.submitTime / frameStatsCount;
+        }
+
+        const ImGuiFrameStats& last(frameStats[(frameStatsIndex + kFrameStatsHistorySize - 1) % kFrameStatsHistorySize]);
+
+        ImGui::SetNextWindowPos(ImVec2(8 * scaleFactor, 8 * scaleFactor), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowBgAlpha(0.75f);
+
+        if (ImGui::Begin("Frame stats", &frameStatsOverlay, ImGuiWindowFlags_AlwaysAutoResize|
+                                                            ImGuiWindowFlags_NoSavedSettings|
+                                                            ImGuiWindowFlags_NoFocusOnAppearing|
+                                                            ImGuiWindowFlags_NoNav))
+        {
+            ImGui::Text("new frame: %.3f ms", average.newFrameTime);
+            ImGui::Text("display:   %.3f ms", average.displayTime);
+            ImGui::Text("render:    %.3f ms", average.renderTime);
+            ImGui::Text("submit:    %.3f ms", average.submitTime);
+            ImGui::Text("%u vertices, %u indices", last.vertexCount, last.indexCount);
+            ImGui::Text("%u draw commands, %u draw lists", last.drawCommandCount, last.drawListCount);
+            if (coalesceDrawCommands)
+                ImGui::Text("%u draw commands merged", last.mergedDrawCommandCount);
+            ImGui::PlotLines("##frametimes", frameTimes, frameStatsCount, 0, "frame time",
+                             0.f, FLT_MAX, ImVec2(0, 40 * scaleFactor));
+        }
+        ImGui::End();
+    }
+   #endif
+
+    inline void inputReceived() noexcept
+    {
+        pendingFrames = kLazyRepaintInputFrames;
+       #ifdef IMGUI_DPF_FRAME_STATS
+        ++currentFrameStats.inputEvents;
+       #endif
+    }
+
+    bool needsRepaint() const noexcept
+    {
+        if (pendingFrames != 0)
+            return true;
+
+        const ImGuiContext& g(*context);
+
+        // something is being clicked, dragged or typed into, or a popup/menu is open
+        if (g.ActiveId != 0 || g.OpenPopupStack.Size != 0 || g.IO.WantTextInput || g.NavWindowingTarget != nullptr)
+            return true;
+
+        // modal background fading, delayed hover tooltips and animations of recently activated items
+        if (g.DimBgRatio > 0.f && g.DimBgRatio < 1.f)
+            return true;
+        if (g.HoveredId != 0 && g.HoveredIdTimer < kLazyRepaintAnimationTime)
+            return true;
+        if (g.LastActiveId != 0 && g.LastActiveIdTimer < kLazyRepaintAnimationTime)
+            return true;
+
+       #ifndef DGL_NO_SHARED_RESOURCES
+        // a font atlas was rasterized in the background and is ready to be swapped in
+        if (hasFontBuildResult())
+            return true;
+       #endif
+
+        return minFps != 0 && getTime() - lastFrameTime >= 1.0 / minFps;
+    }
+
     DISTRHO_DECLARE_NON_COPYABLE(PrivateData)
 };
 
@@ -181,27 +1427,141 @@ struct ImGuiWidget<BaseWidget>::PrivateData {
 template <class BaseWidget>
 void ImGuiWidget<BaseWidget>::setFontSize(const float fontSize)
 {
-    ImGui::SetCurrentContext(imData->context);
-    ImGuiIO& io(ImGui::GetIO());
-
+   #if defined(IMGUI_DPF_DISTANCE_FIELD_FONTS)
+    imData->setFontScale(fontSize, BaseWidget::getTopLevelWidget()->getScaleFactor());
+   #elif !defined(DGL_NO_SHARED_RESOURCES)
     const double scaleFactor = BaseWidget::getTopLevelWidget()->getScaleFactor();
 
-   #ifndef DGL_NO_SHARED_RESOURCES
-    using namespace dpf_resources;
-    ImFontConfig fc;
-    fc.FontDataOwnedByAtlas = false;
-    fc.OversampleH = 1;
-    fc.OversampleV = 1;
-    fc.PixelSnapH = true;
-    io.Fonts->Clear();
-    io.Fonts->AddFontFromMemoryTTF((void*)dejavusans_ttf, dejavusans_ttf_size, fontSize * scaleFactor, &fc);
-    io.Fonts->Build();
+    imData->cancelFontBuild();
+    imData->setFontBuildResult(imData->buildFont(fontSize, scaleFactor));
+   #else
+    // no font to rasterize
+    (void)fontSize;
    #endif
+
+    imData->inputReceived();
 }
 
+template <class BaseWidget>
+void ImGuiWidget<BaseWidget>::setFontSizeAsync(const float fontSize)
+{
+   #if defined(IMGUI_DPF_DISTANCE_FIELD_FONTS)
+    // nothing to rasterize, apply right away
+    imData->setFontScale(fontSize, BaseWidget::getTopLevelWidget()->getScaleFactor());
+   #elif !defined(DGL_NO_SHARED_RESOURCES)
+    imData->requestFontBuild(fontSize, BaseWidget::getTopLevelWidget()->getScaleFactor());
+   #else
+    // no font to rasterize
+    (void)fontSize;
+   #endif
+
+    imData->inputReceived();
+}
+
+template <class BaseWidget>
+void ImGuiWidget<BaseWidget>::setLazyRepaint(const bool lazyRepaint)
+{
+    imData->lazyRepaint = lazyRepaint;
+    imData->inputReceived();
+}
+
+template <class BaseWidget>
+void ImGuiWidget<BaseWidget>::setFrameRateLimits(const uint minFps, const uint maxFps)
+{
+    // idle callbacks are timed in whole milliseconds, 0 would mean running on every idle
+    DISTRHO_SAFE_ASSERT_RETURN(maxFps != 0 && maxFps <= 1000,);
+    DISTRHO_SAFE_ASSERT_RETURN(minFps <= maxFps,);
+
+    imData->minFps = minFps;
+
+    if (imData->maxFps == maxFps)
+        return;
+
+    imData->removeIdleCallback();
+    imData->maxFps = maxFps;
+    imData->addIdleCallback();
+}
+
+template <class BaseWidget>
+uint32_t ImGuiWidget<BaseWidget>::getSkippedFrameCount() const noexcept
+{
+    return imData->skippedFrames;
+}
+
+template <class BaseWidget>
+void ImGuiWidget<BaseWidget>::setRetainedFramebuffer(const bool retained)
+{
+   #if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
+    imData->retainedFramebuffer = retained;
+    imData->framebufferHash = 0;
+   #else
+    // not available on legacy OpenGL
+    (void)retained;
+   #endif
+}
+
+template <class BaseWidget>
+void ImGuiWidget<BaseWidget>::setInputCoalescing(const bool coalesce)
+{
+    if (! coalesce)
+    {
+        ImGui::SetCurrentContext(imData->context);
+        imData->flushPendingInput(ImGui::GetIO());
+    }
+
+    imData->coalesceInput = coalesce;
+}
+
+template <class BaseWidget>
+void ImGuiWidget<BaseWidget>::setDrawCommandCoalescing(const bool coalesce)
+{
+    imData->coalesceDrawCommands = coalesce;
+    imData->mergedDrawCommands = 0;
+}
+
+template <class BaseWidget>
+uint ImGuiWidget<BaseWidget>::getMergedDrawCommandCount() const noexcept
+{
+    return imData->mergedDrawCommands;
+}
+
+template <class BaseWidget>
+uint ImGuiWidget<BaseWidget>::getShaderCacheHitCount() noexcept
+{
+   #if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
+    return ImGui_ImplOpenGL3_DPF_GetProgramCacheHits();
+   #else
+    return 0;
+   #endif
+}
+
+#ifdef IMGUI_DPF_FRAME_STATS
+template <class BaseWidget>
+const ImGuiFrameStats* ImGuiWidget<BaseWidget>::getFrameStats(const uint index) const noexcept
+{
+    if (index >= imData->frameStatsCount)
+        return nullptr;
+
+    return &imData->frameStats[(imData->frameStatsIndex + kFrameStatsHistorySize - 1 - index) % kFrameStatsHistorySize];
+}
+
+template <class BaseWidget>
+void ImGuiWidget<BaseWidget>::setFrameStatsOverlayVisible(const bool visible)
+{
+    imData->frameStatsOverlay = visible;
+    imData->inputReceived();
+}
+#endif
+
 template <class BaseWidget>
 void ImGuiWidget<BaseWidget>::idleCallback()
 {
+    if (imData->lazyRepaint && ! imData->needsRepaint())
+    {
+        ++imData->skippedFrames;
+        return;
+    }
+
     BaseWidget::repaint();
 }
 
@@ -214,15 +1574,48 @@ void ImGuiWidget<BaseWidget>::onDisplay()
 
     io.DeltaTime = imData->getTimeDelta();
 
+    if (imData->pendingFrames != 0)
+        --imData->pendingFrames;
+
+   #ifdef IMGUI_DPF_FRAME_STATS
+    const double frameStartTime = imData->getTime();
+   #endif
+
+   #ifndef DGL_NO_SHARED_RESOURCES
+    // font size changes are applied at the start of a frame
+    imData->swapFontBuildResult(io);
+   #endif
+
+   #ifdef IMGUI_DPF_SHARED_FONT_ATLAS
+    // the font atlas is shared, but each graphics context needs its own texture
+    io.Fonts->SetTexID(imData->fontTexture);
+   #endif
+
    #if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
     ImGui_ImplOpenGL3_NewFrame();
    #else
     ImGui_ImplOpenGL2_NewFrame();
    #endif
 
+    imData->flushPendingInput(io);
+
     ImGui::NewFrame();
+   #ifdef IMGUI_DPF_FRAME_STATS
+    const double newFrameEndTime = imData->getTime();
+   #endif
+
     onImGuiDisplay();
+   #ifdef IMGUI_DPF_FRAME_STATS
+    const double displayEndTime = imData->getTime();
+
+    if (imData->frameStatsOverlay)
+        imData->showFrameStatsOverlay();
+   #endif
+
     ImGui::Render();
+   #ifdef IMGUI_DPF_FRAME_STATS
+    const double renderEndTime = imData->getTime();
+   #endif
 
     /*
     const GraphicsContext& gc(getGraphicsContext());
@@ -231,16 +1624,20 @@ void ImGuiWidget<BaseWidget>::onDisplay()
     r.draw(gc);
     */
 
-    if (ImDrawData* const data = ImGui::GetDrawData())
-    {
-        data->DisplayPos.x = -imData->getDisplayX();
-        data->DisplayPos.y = imData->getDisplayY();
-       #if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
-        ImGui_ImplOpenGL3_RenderDrawData(data);
-       #else
-        ImGui_ImplOpenGL2_RenderDrawData(data);
-       #endif
-    }
+   #if defined(DGL_USE_GLES2) || defined(DGL_USE_GLES3) || defined(DGL_USE_OPENGL3)
+    // framebuffer can only be deleted while the graphics context is active
+    if (! imData->retainedFramebuffer && imData->framebuffer != 0)
+        imData->destroyFramebuffer();
+   #endif
+
+    ImDrawData* const data = ImGui::GetDrawData();
+
+    if (data != nullptr)
+        imData->renderDrawData(data);
+
+   #ifdef IMGUI_DPF_FRAME_STATS
+    imData->pushFrameStats(data, frameStartTime, newFrameEndTime, displayEndTime, renderEndTime, imData->getTime());
+   #endif
 }
 
 template <class BaseWidget>
@@ -252,6 +1649,7 @@ bool ImGuiWidget<BaseWidget>::onKeyboard(const Widget::KeyboardEvent& event)
     ImGui::SetCurrentContext(imData->context);
 
     ImGuiIO& io(ImGui::GetIO());
+    imData->flushPendingInput(io);
     imData->handleModifiers(io, event.mod);
 
     // d_stdout("onKeyboard %u %u %u", event.key, event.mod, event.keycode);
@@ -385,6 +1783,7 @@ bool ImGuiWidget<BaseWidget>::onKeyboard(const Widget::KeyboardEvent& event)
     }
 
     io.AddKeyEvent(key, event.press);
+    imData->inputReceived();
     return io.WantCaptureKeyboard;
 }
 
@@ -397,11 +1796,13 @@ bool ImGuiWidget<BaseWidget>::onCharacterInput(const Widget::CharacterInputEvent
     ImGui::SetCurrentContext(imData->context);
 
     ImGuiIO& io(ImGui::GetIO());
+    imData->flushPendingInput(io);
     imData->handleModifiers(io, event.mod);
 
     // d_stdout("input %u %u %lu '%s'", event.keycode, event.character, std::strlen(event.string), event.string);
 
     io.AddInputCharacter(event.character);
+    imData->inputReceived();
     return io.WantCaptureKeyboard;
 }
 
@@ -414,6 +1815,7 @@ bool ImGuiWidget<BaseWidget>::onMouse(const Widget::MouseEvent& event)
     ImGui::SetCurrentContext(imData->context);
 
     ImGuiIO& io(ImGui::GetIO());
+    imData->flushPendingInput(io);
     imData->handleModifiers(io, event.mod);
 
     ImGuiMouseButton button;
@@ -426,6 +1828,7 @@ bool ImGuiWidget<BaseWidget>::onMouse(const Widget::MouseEvent& event)
     }
 
     io.AddMouseButtonEvent(button, event.press);
+    imData->inputReceived();
     return io.WantCaptureMouse;
 }
 
@@ -440,7 +1843,8 @@ bool ImGuiWidget<BaseWidget>::onMotion(const Widget::MotionEvent& event)
     ImGuiIO& io(ImGui::GetIO());
     imData->handleModifiers(io, event.mod);
 
-    io.AddMousePosEvent(event.pos.getX(), event.pos.getY());
+    imData->addMousePos(io, ImVec2(event.pos.getX(), event.pos.getY()));
+    imData->inputReceived();
     return false;
 }
 
@@ -455,7 +1859,8 @@ bool ImGuiWidget<BaseWidget>::onScroll(const Widget::ScrollEvent& event)
     ImGuiIO& io(ImGui::GetIO());
     imData->handleModifiers(io, event.mod);
 
-    io.AddMouseWheelEvent(event.delta.getX(), event.delta.getY());
+    imData->addMouseWheel(io, ImVec2(event.delta.getX(), event.delta.getY()));
+    imData->inputReceived();
     return io.WantCaptureMouse;
 }
 
@@ -469,6 +1874,8 @@ void ImGuiWidget<BaseWidget>::onResize(const Widget::ResizeEvent& event)
     ImGuiIO& io(ImGui::GetIO());
     io.DisplaySize.x = event.size.getWidth();
     io.DisplaySize.y = event.size.getHeight();
+
+    imData->inputReceived();
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -492,18 +1899,30 @@ double ImGuiWidget<SubWidget>::PrivateData::getTime() const noexcept
     return self->getApp().getTime();
 }
 
+template <>
+void ImGuiWidget<SubWidget>::PrivateData::addIdleCallback()
+{
+    self->getWindow().addIdleCallback(self, 1000 / maxFps);
+}
+
+template <>
+void ImGuiWidget<SubWidget>::PrivateData::removeIdleCallback()
+{
+    self->getWindow().removeIdleCallback(self);
+}
+
 template <>
 ImGuiWidget<SubWidget>::ImGuiWidget(Widget* const parent, const float fontSize)
     : SubWidget(parent),
       imData(new PrivateData(this, fontSize))
 {
-    getWindow().addIdleCallback(this, 1000 / 60); // 60 fps
+    imData->addIdleCallback();
 }
 
 template <>
 ImGuiWidget<SubWidget>::~ImGuiWidget()
 {
-    getWindow().removeIdleCallback(this);
+    imData->removeIdleCallback();
     delete imData;
 }
 
@@ -530,18 +1949,30 @@ double ImGuiWidget<TopLevelWidget>::PrivateData::getTime() const noexcept
     return self->getApp().getTime();
 }
 
+template <>
+void ImGuiWidget<TopLevelWidget>::PrivateData::addIdleCallback()
+{
+    self->addIdleCallback(self, 1000 / maxFps);
+}
+
+template <>
+void ImGuiWidget<TopLevelWidget>::PrivateData::removeIdleCallback()
+{
+    self->removeIdleCallback(self);
+}
+
 template <>
 ImGuiWidget<TopLevelWidget>::ImGuiWidget(Window& windowToMapTo, const float fontSize)
     : TopLevelWidget(windowToMapTo),
       imData(new PrivateData(this, fontSize))
 {
-    addIdleCallback(this, 1000 / 60); // 60 fps
+    imData->addIdleCallback();
 }
 
 template <>
 ImGuiWidget<TopLevelWidget>::~ImGuiWidget()
 {
-    removeIdleCallback(this);
+    imData->removeIdleCallback();
     delete imData;
 }
 
@@ -568,12 +1999,24 @@ double ImGuiWidget<StandaloneWindow>::PrivateData::getTime() const noexcept
     return self->getApp().getTime();
 }
 
+template <>
+void ImGuiWidget<StandaloneWindow>::PrivateData::addIdleCallback()
+{
+    self->Window::addIdleCallback(self, 1000 / maxFps);
+}
+
+template <>
+void ImGuiWidget<StandaloneWindow>::PrivateData::removeIdleCallback()
+{
+    self->Window::removeIdleCallback(self);
+}
+
 template <>
 ImGuiWidget<StandaloneWindow>::ImGuiWidget(Application& app, const float fontSize)
     : StandaloneWindow(app),
       imData(new PrivateData(this, fontSize))
 {
-    Window::addIdleCallback(this, 1000 / 60); // 60 fps
+    imData->addIdleCallback();
 }
 
 template <>
@@ -581,13 +2024,13 @@ ImGuiWidget<StandaloneWindow>::ImGuiWidget(Application& app, Window& transientPa
     : StandaloneWindow(app, transientParentWindow),
       imData(new PrivateData(this, fontSize))
 {
-    Window::addIdleCallback(this, 1000 / 60); // 60 fps
+    imData->addIdleCallback();
 }
 
 template <>
 ImGuiWidget<StandaloneWindow>::~ImGuiWidget()
 {
-    Window::removeIdleCallback(this);
+    imData->removeIdleCallback();
     delete imData;
 }
 
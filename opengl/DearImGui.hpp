@@ -42,6 +42,45 @@ START_NAMESPACE_DGL
 
 // --------------------------------------------------------------------------------------------------------------------
 
+#ifdef IMGUI_DPF_FRAME_STATS
+/**
+   Statistics of a single rendered ImGuiWidget frame.
+   Only available when IMGUI_DPF_FRAME_STATS is defined.
+
+   Timings are measured on the CPU side and given in milliseconds.
+ */
+struct ImGuiFrameStats {
+   /** Time spent in the backend and ImGui NewFrame calls. */
+    double newFrameTime;
+
+   /** Time spent in onImGuiDisplay(). */
+    double displayTime;
+
+   /** Time spent in ImGui::Render(). */
+    double renderTime;
+
+   /** Time spent submitting draw data to OpenGL. */
+    double submitTime;
+
+   /** Amount of vertices, indices, draw commands and draw lists in the frame draw data. */
+    uint vertexCount;
+    uint indexCount;
+    uint drawCommandCount;
+    uint drawListCount;
+
+   /** Amount of draw commands merged by draw command coalescing. */
+    uint mergedDrawCommandCount;
+
+   /** Amount of font atlas builds triggered since the previous frame. */
+    uint atlasRebuilds;
+
+   /** Amount of input events given to ImGui since the previous frame. */
+    uint inputEvents;
+};
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+
 /**
    Dear ImGui Widget class.
 
@@ -84,9 +123,116 @@ public:
 
    /**
       Change global font size.
+
+      The font atlas is rasterized right away, then it and its texture are swapped in at the start of the next frame.
+      Font atlases are rasterized once per process and shared between all ImGui widgets
+      that use the same font size and scale factor, so io.Fonts must not be modified directly.
+      Define IMGUI_DPF_NO_SHARED_FONT_ATLAS to give each widget its own font atlas instead.
+
+      Define IMGUI_DPF_SDF_FONT_ATLAS to rasterize the font once as a signed distance field atlas,
+      which is then drawn at any font size and scale factor without rasterizing again (OpenGL3 and GLES3 only).
+      In that mode font size changes apply right away and text scaled with ImGui::SetWindowFontScale() stays crisp.
     */
     void setFontSize(float fontSize);
 
+   /**
+      Change global font size asynchronously.
+
+      Same as setFontSize(), but the font atlas is rasterized in a background thread while the current one keeps being used.
+      When called again before rasterizing is done, only the latest font size is kept,
+      which allows to follow something like a zoom slider without stalling the UI.
+    */
+    void setFontSizeAsync(float fontSize);
+
+   /**
+      Enable or disable lazy repaints.
+
+      By default the widget is repainted on every idle callback, at the maximum frame rate.
+      With lazy repaints enabled, idle callbacks only trigger a repaint after user input,
+      or while ImGui still needs new frames (active item, open popup, text caret, animations).
+      Calling repaint() keeps working as usual for explicit invalidation.
+
+      @see setFrameRateLimits, getSkippedFrameCount
+    */
+    void setLazyRepaint(bool lazyRepaint);
+
+   /**
+      Set the minimum and maximum frame rates used for idle repaints.
+
+      The maximum frame rate defines how often the idle callback runs, 60 fps by default and at most 1000.
+      The minimum frame rate forces a repaint at least that often while lazy repaints are enabled,
+      with 0 (the default) meaning no forced repaints.
+    */
+    void setFrameRateLimits(uint minFps, uint maxFps);
+
+   /**
+      Get the amount of idle callbacks that did not trigger a repaint because of lazy repaints.
+    */
+    uint32_t getSkippedFrameCount() const noexcept;
+
+   /**
+      Enable or disable retained framebuffer rendering.
+
+      When enabled, ImGui contents are rendered into an offscreen framebuffer that is reused
+      for as long as the generated draw data stays the same, so unchanged frames only draw a single textured quad.
+      Draw data containing custom draw callbacks or textures other than the font atlas is always rendered directly,
+      as those can change without changing the draw data (e.g. ImGui::Image() with a texture updated in place).
+      Only available for OpenGL3 and GLES builds, does nothing on legacy OpenGL.
+    */
+    void setRetainedFramebuffer(bool retained);
+
+   /**
+      Enable or disable input coalescing, enabled by default.
+
+      When enabled, mouse motion events are reduced to the latest position per frame and mouse wheel deltas are summed,
+      while mouse button and keyboard events keep their order relative to them.
+      Disable this for widgets that need every single mouse position, like precise drags or free-hand drawing.
+    */
+    void setInputCoalescing(bool coalesce);
+
+   /**
+      Enable or disable draw command coalescing.
+
+      When enabled, the draw lists of each frame are joined before rendering,
+      merging adjacent draw commands that use the same texture into a single draw call
+      as long as they share the same clip rectangle or their geometry is not clipped at all.
+      This is mostly useful for legacy OpenGL, where each draw call is expensive.
+      Frames containing custom draw callbacks are rendered as-is.
+
+      @see getMergedDrawCommandCount
+    */
+    void setDrawCommandCoalescing(bool coalesce);
+
+   /**
+      Get the amount of draw commands merged by draw command coalescing in the last rendered frame.
+    */
+    uint getMergedDrawCommandCount() const noexcept;
+
+   /**
+      Get the amount of times an ImGui widget reused the shader programs of another widget on the same window,
+      instead of compiling its own.
+      This is a process-wide counter, always 0 on legacy OpenGL where no shaders are used.
+    */
+    static uint getShaderCacheHitCount() noexcept;
+
+#ifdef IMGUI_DPF_FRAME_STATS
+   /**
+      Amount of frames kept in the frame statistics history.
+    */
+    static constexpr const uint kFrameStatsHistorySize = 120;
+
+   /**
+      Get the statistics of a recent frame, with index 0 being the most recent one.
+      Returns null if no frame has been recorded for @a index yet.
+    */
+    const ImGuiFrameStats* getFrameStats(uint index = 0) const noexcept;
+
+   /**
+      Show or hide an overlay window with a summary of the frame statistics.
+    */
+    void setFrameStatsOverlayVisible(bool visible);
+#endif
+
 protected:
    /**
       New virtual onDisplay function.
@@ -270,6 +270,12 @@ bool ImGui_ImplOpenGL2_CreateFontsTexture()
     // Build texture atlas
     ImGuiIO& io = ImGui::GetIO();
     ImGui_ImplOpenGL2_Data* bd = ImGui_ImplOpenGL2_GetBackendData();
+
+#ifdef IMGUI_DPF_BACKEND
+    // Font texture is already provided by DPF (shared font atlas cache)
+    if (io.Fonts->TexID != 0)
+        return true;
+#endif
     unsigned char* pixels;
     int width, height;
     io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);   // Load as RGBA 32-bit (75% of the memory is wasted, but default font is so small) because it is more likely to be compatible with user's existing shaders. If your ImTextureId represent a higher-level concept than just a GL texture id, consider calling GetTexDataAsAlpha8() instead to save on GPU memory.
@@ -212,6 +212,20 @@
 #define IMGUI_IMPL_OPENGL_MAY_HAVE_BIND_SAMPLER
 #endif
 
+#ifdef IMGUI_DPF_BACKEND
+#include <mutex>        // [DPF] Program cache lock
+// [DPF] Desktop GL 3.2+ and GL ES 3.0+ have glMapBufferRange() and fences, used to stream all draw lists of a frame into a single ring buffer.
+// Desktop GL 4.4+ (or ARB_buffer_storage) additionally allows to keep that ring buffer persistently mapped.
+// Windows builds only get the GL entry points resolved by DPF, so they keep using the regular upload path.
+#if !defined(IMGUI_DPF_NO_STREAMING_BUFFER) && !defined(IMGUI_IMPL_OPENGL_ES2) && !defined(_WIN32) && defined(GL_MAP_WRITE_BIT) && defined(GL_SYNC_GPU_COMMANDS_COMPLETE)
+#define IMGUI_DPF_STREAMING_BUFFER
+#define IMGUI_DPF_STREAMING_BUFFER_SEGMENTS 3
+#if defined(GL_MAP_PERSISTENT_BIT)
+#define IMGUI_DPF_STREAMING_BUFFER_MAY_HAVE_PERSISTENT_MAPPING
+#endif
+#endif
+#endif
+
 // [Debugging]
 //#define IMGUI_IMPL_OPENGL_DEBUG
 #ifdef IMGUI_IMPL_OPENGL_DEBUG
@@ -243,6 +257,24 @@ struct ImGui_ImplOpenGL3_Data
     bool            HasPolygonMode;
     bool            HasClipOrigin;
     bool            UseBufferSubData;
+#ifdef IMGUI_DPF_STREAMING_BUFFER
+    int             StreamMode;              // [DPF] 0 = disabled, 1 = orphaning + glMapBufferRange(), 2 = persistent mapping
+    int             StreamSegment;           // [DPF] Ring buffer segment used by the current frame (persistent mapping only)
+    int             StreamVtxCapacity;       // [DPF] Vertices per segment
+    int             StreamIdxCapacity;       // [DPF] Indices per segment
+    char*           StreamVtxData;           // [DPF] Persistently mapped buffers
+    char*           StreamIdxData;
+    GLsync          StreamFences[IMGUI_DPF_STREAMING_BUFFER_SEGMENTS];
+    bool            StreamHasBaseVertex;     // [DPF] Use glDrawElementsBaseVertex(), otherwise vertex attributes are re-pointed for every draw list
+#endif
+#ifdef IMGUI_DPF_BACKEND
+    bool            DistanceFieldFonts;      // [DPF] Font atlas texture holds signed distance fields, drawn with a separate shader
+    GLuint          DistanceFieldShaderHandle;
+    GLint           DistanceFieldLocationTex;
+    GLint           DistanceFieldLocationProjMtx;
+    GLuint          CurrentShaderHandle;     // [DPF] Shader used by the last draw command
+    uintptr_t       ProgramCacheKey;         // [DPF] Identifies the GL context for sharing shader programs, 0 if not shared
+#endif
 
     ImGui_ImplOpenGL3_Data() { memset((void*)this, 0, sizeof(*this)); }
 };
@@ -386,6 +418,9 @@ bool    ImGui_ImplOpenGL3_Init(const char* glsl_version)
     bd->HasPolygonMode = (!bd->GlProfileIsES2 && !bd->GlProfileIsES3);
 #endif
     bd->HasClipOrigin = (bd->GlVersion >= 450);
+#ifdef IMGUI_DPF_STREAMING_BUFFER_MAY_HAVE_PERSISTENT_MAPPING
+    bool has_buffer_storage = (bd->GlVersion >= 440 && !bd->GlProfileIsES3);
+#endif
 #ifdef IMGUI_IMPL_OPENGL_HAS_EXTENSIONS
     GLint num_extensions = 0;
     glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
@@ -394,9 +429,26 @@ bool    ImGui_ImplOpenGL3_Init(const char* glsl_version)
         const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
         if (extension != nullptr && strcmp(extension, "GL_ARB_clip_control") == 0)
             bd->HasClipOrigin = true;
+#ifdef IMGUI_DPF_STREAMING_BUFFER_MAY_HAVE_PERSISTENT_MAPPING
+        if (extension != nullptr && strcmp(extension, "GL_ARB_buffer_storage") == 0)
+            has_buffer_storage = true;
+#endif
     }
 #endif
 
+#ifdef IMGUI_DPF_STREAMING_BUFFER
+    // [DPF] Select streaming buffer mode
+    if (bd->GlVersion >= 320 || (bd->GlProfileIsES3 && bd->GlVersion >= 300))
+        bd->StreamMode = 1;
+#ifdef IMGUI_DPF_STREAMING_BUFFER_MAY_HAVE_PERSISTENT_MAPPING
+    if (bd->StreamMode != 0 && has_buffer_storage && !bd->GlProfileIsES3)
+        bd->StreamMode = 2;
+#endif
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
+    bd->StreamHasBaseVertex = (bd->GlVersion >= 320 && !bd->GlProfileIsES3);
+#endif
+#endif
+
     return true;
 }
 
@@ -475,6 +527,15 @@ static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_wid
         { 0.0f,         0.0f,        -1.0f,   0.0f },
         { (R+L)/(L-R),  (T+B)/(B-T),  0.0f,   1.0f },
     };
+#ifdef IMGUI_DPF_BACKEND
+    if (bd->DistanceFieldShaderHandle)
+    {
+        glUseProgram(bd->DistanceFieldShaderHandle);
+        glUniform1i(bd->DistanceFieldLocationTex, 0);
+        glUniformMatrix4fv(bd->DistanceFieldLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]);
+    }
+    bd->CurrentShaderHandle = bd->ShaderHandle;
+#endif
     glUseProgram(bd->ShaderHandle);
     glUniform1i(bd->AttribLocationTex, 0);
     glUniformMatrix4fv(bd->AttribLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]);
@@ -500,6 +561,153 @@ static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_wid
     GL_CALL(glVertexAttribPointer(bd->AttribLocationVtxColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)offsetof(ImDrawVert, col)));
 }
 
+#ifdef IMGUI_DPF_STREAMING_BUFFER
+// [DPF] Point vertex attributes at a vertex offset of the streaming buffer, used when glDrawElementsBaseVertex() is not available
+static void ImGui_ImplOpenGL3_DPF_SetStreamVertexOffset(ImGui_ImplOpenGL3_Data* bd, int vtx_offset)
+{
+    const intptr_t offset = (intptr_t)vtx_offset * (intptr_t)sizeof(ImDrawVert);
+    GL_CALL(glVertexAttribPointer(bd->AttribLocationVtxPos,   2, GL_FLOAT,         GL_FALSE, sizeof(ImDrawVert), (GLvoid*)(offset + offsetof(ImDrawVert, pos))));
+    GL_CALL(glVertexAttribPointer(bd->AttribLocationVtxUV,    2, GL_FLOAT,         GL_FALSE, sizeof(ImDrawVert), (GLvoid*)(offset + offsetof(ImDrawVert, uv))));
+    GL_CALL(glVertexAttribPointer(bd->AttribLocationVtxColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)(offset + offsetof(ImDrawVert, col))));
+}
+
+// [DPF] Release fences and persistent mappings of the streaming buffer
+static void ImGui_ImplOpenGL3_DPF_DestroyStreamBuffers(ImGui_ImplOpenGL3_Data* bd)
+{
+    for (int i = 0; i < IMGUI_DPF_STREAMING_BUFFER_SEGMENTS; i++)
+        if (bd->StreamFences[i]) { glDeleteSync(bd->StreamFences[i]); bd->StreamFences[i] = nullptr; }
+    bd->StreamSegment = 0;
+    bd->StreamVtxCapacity = 0;
+    bd->StreamIdxCapacity = 0;
+    bd->StreamVtxData = nullptr; // Persistent mappings go away together with the buffers
+    bd->StreamIdxData = nullptr;
+}
+
+// [DPF] (Re)create the streaming buffer so that each segment holds at least the given amount of vertices and indices.
+// Buffers must be bound to the vertex array object of the current frame, vertex attributes need to be set up again afterwards.
+static void ImGui_ImplOpenGL3_DPF_CreateStreamBuffers(ImGui_ImplOpenGL3_Data* bd, int vtx_count, int idx_count)
+{
+    ImGui_ImplOpenGL3_DPF_DestroyStreamBuffers(bd);
+
+    // Grow in powers of two to avoid reallocating while a UI is being built up
+    int vtx_capacity = 8192, idx_capacity = 16384;
+    while (vtx_capacity < vtx_count) vtx_capacity *= 2;
+    while (idx_capacity < idx_count) idx_capacity *= 2;
+
+#ifdef IMGUI_DPF_STREAMING_BUFFER_MAY_HAVE_PERSISTENT_MAPPING
+    if (bd->StreamMode == 2)
+    {
+        // Buffer storage is immutable, so new buffer names are needed for every size change
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const GLsizeiptr vtx_size = (GLsizeiptr)vtx_capacity * IMGUI_DPF_STREAMING_BUFFER_SEGMENTS * (int)sizeof(ImDrawVert);
+        const GLsizeiptr idx_size = (GLsizeiptr)idx_capacity * IMGUI_DPF_STREAMING_BUFFER_SEGMENTS * (int)sizeof(ImDrawIdx);
+        glDeleteBuffers(1, &bd->VboHandle);
+        glDeleteBuffers(1, &bd->ElementsHandle);
+        glGenBuffers(1, &bd->VboHandle);
+        glGenBuffers(1, &bd->ElementsHandle);
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, bd->VboHandle));
+        GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bd->ElementsHandle));
+        GL_CALL(glBufferStorage(GL_ARRAY_BUFFER, vtx_size, nullptr, flags));
+        GL_CALL(glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, idx_size, nullptr, flags));
+        bd->StreamVtxData = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, vtx_size, flags);
+        bd->StreamIdxData = (char*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, idx_size, flags);
+
+        if (bd->StreamVtxData == nullptr || bd->StreamIdxData == nullptr)
+        {
+            // Driver refused the persistent mapping, fallback to orphaning from now on (which needs mutable buffers)
+            bd->StreamMode = 1;
+            bd->StreamVtxData = bd->StreamIdxData = nullptr;
+            glDeleteBuffers(1, &bd->VboHandle);
+            glDeleteBuffers(1, &bd->ElementsHandle);
+            glGenBuffers(1, &bd->VboHandle);
+            glGenBuffers(1, &bd->ElementsHandle);
+            GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, bd->VboHandle));
+            GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bd->ElementsHandle));
+        }
+    }
+#endif
+
+    bd->StreamVtxCapacity = vtx_capacity;
+    bd->StreamIdxCapacity = idx_capacity;
+}
+
+// [DPF] Copy all draw lists of a frame into the streaming buffer, using a single map/upload per buffer.
+// Offsets of the first vertex and index of the frame are written into vtx_offset and idx_offset.
+// Returns true if the buffers were recreated, in which case the render state needs to be set up again.
+static bool ImGui_ImplOpenGL3_DPF_UploadStreamBuffers(ImGui_ImplOpenGL3_Data* bd, ImDrawData* draw_data, int* vtx_offset, int* idx_offset)
+{
+    *vtx_offset = *idx_offset = 0;
+    if (draw_data->TotalVtxCount <= 0 || draw_data->TotalIdxCount <= 0)
+        return false;
+
+    bool recreated = false;
+    if (bd->StreamVtxCapacity < draw_data->TotalVtxCount || bd->StreamIdxCapacity < draw_data->TotalIdxCount)
+    {
+        ImGui_ImplOpenGL3_DPF_CreateStreamBuffers(bd, draw_data->TotalVtxCount, draw_data->TotalIdxCount);
+        recreated = true;
+    }
+
+    const GLsizeiptr vtx_size = (GLsizeiptr)draw_data->TotalVtxCount * (int)sizeof(ImDrawVert);
+    const GLsizeiptr idx_size = (GLsizeiptr)draw_data->TotalIdxCount * (int)sizeof(ImDrawIdx);
+    char* vtx_dst;
+    char* idx_dst;
+
+    if (bd->StreamMode == 2)
+    {
+        // Wait until the GPU is done reading the segment we are about to overwrite (usually long done with triple buffering)
+        if (GLsync fence = bd->StreamFences[bd->StreamSegment])
+        {
+            GLenum result;
+            do {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            } while (result == GL_TIMEOUT_EXPIRED);
+            glDeleteSync(fence);
+            bd->StreamFences[bd->StreamSegment] = nullptr;
+        }
+        *vtx_offset = bd->StreamSegment * bd->StreamVtxCapacity;
+        *idx_offset = bd->StreamSegment * bd->StreamIdxCapacity;
+        vtx_dst = bd->StreamVtxData + (size_t)*vtx_offset * sizeof(ImDrawVert);
+        idx_dst = bd->StreamIdxData + (size_t)*idx_offset * sizeof(ImDrawIdx);
+    }
+    else
+    {
+        // Orphan the previous storage, so the driver does not need to synchronize with pending draws
+        GL_CALL(glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)bd->StreamVtxCapacity * (int)sizeof(ImDrawVert), nullptr, GL_STREAM_DRAW));
+        GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)bd->StreamIdxCapacity * (int)sizeof(ImDrawIdx), nullptr, GL_STREAM_DRAW));
+        vtx_dst = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, vtx_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        idx_dst = (char*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, idx_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+
+        if (vtx_dst == nullptr || idx_dst == nullptr)
+        {
+            // Mapping is not working on this driver, use the regular per draw list upload path from now on
+            if (vtx_dst != nullptr) glUnmapBuffer(GL_ARRAY_BUFFER);
+            if (idx_dst != nullptr) glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+            bd->StreamMode = 0;
+            return recreated;
+        }
+    }
+
+    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    {
+        const ImDrawList* draw_list = draw_data->CmdLists[n];
+        const size_t vtx_list_size = (size_t)draw_list->VtxBuffer.Size * sizeof(ImDrawVert);
+        const size_t idx_list_size = (size_t)draw_list->IdxBuffer.Size * sizeof(ImDrawIdx);
+        memcpy(vtx_dst, draw_list->VtxBuffer.Data, vtx_list_size);
+        memcpy(idx_dst, draw_list->IdxBuffer.Data, idx_list_size);
+        vtx_dst += vtx_list_size;
+        idx_dst += idx_list_size;
+    }
+
+    if (bd->StreamMode == 1)
+    {
+        GL_CALL(glUnmapBuffer(GL_ARRAY_BUFFER));
+        GL_CALL(glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER));
+    }
+
+    return recreated;
+}
+#endif
+
 // OpenGL3 Render function.
 // Note that this implementation is little overcomplicated because we are saving/setting up/restoring every OpenGL state explicitly.
 // This is in order to be able to run within an OpenGL engine that doesn't do so.
@@ -566,6 +774,17 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
     // Will project scissor/clipping rectangles into framebuffer space
     ImVec2 clip_off = draw_data->DisplayPos;         // (0,0) unless using multi-viewports
     ImVec2 clip_scale = draw_data->FramebufferScale; // (1,1) unless using retina display which are often (2,2)
+#ifdef IMGUI_DPF_BACKEND
+    const ImTextureID font_tex_id = ImGui::GetIO().Fonts->TexID;
+#endif
+
+#ifdef IMGUI_DPF_STREAMING_BUFFER
+    // [DPF] Upload all command lists at once into the streaming buffer
+    int stream_vtx_offset = 0, stream_idx_offset = 0;
+    if (bd->StreamMode != 0 && ImGui_ImplOpenGL3_DPF_UploadStreamBuffers(bd, draw_data, &stream_vtx_offset, &stream_idx_offset))
+        ImGui_ImplOpenGL3_SetupRenderState(draw_data, fb_width, fb_height, vertex_array_object);
+    const bool use_stream = (bd->StreamMode != 0);
+#endif
 
     // Render command lists
     for (int n = 0; n < draw_data->CmdListsCount; n++)
@@ -582,6 +801,15 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
         // - See https://github.com/ocornut/imgui/issues/4468 and please report any corruption issues.
         const GLsizeiptr vtx_buffer_size = (GLsizeiptr)draw_list->VtxBuffer.Size * (int)sizeof(ImDrawVert);
         const GLsizeiptr idx_buffer_size = (GLsizeiptr)draw_list->IdxBuffer.Size * (int)sizeof(ImDrawIdx);
+#ifdef IMGUI_DPF_STREAMING_BUFFER
+        if (use_stream)
+        {
+            // [DPF] Already uploaded, only need to point vertex attributes at this draw list when lacking base vertex support
+            if (!bd->StreamHasBaseVertex)
+                ImGui_ImplOpenGL3_DPF_SetStreamVertexOffset(bd, stream_vtx_offset);
+        }
+        else
+#endif
         if (bd->UseBufferSubData)
         {
             if (bd->VertexBufferSize < vtx_buffer_size)
@@ -611,7 +839,13 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
                 // User callback, registered via ImDrawList::AddCallback()
                 // (ImDrawCallback_ResetRenderState is a special callback value used by the user to request the renderer to reset render state.)
                 if (pcmd->UserCallback == ImDrawCallback_ResetRenderState)
+                {
                     ImGui_ImplOpenGL3_SetupRenderState(draw_data, fb_width, fb_height, vertex_array_object);
+#ifdef IMGUI_DPF_STREAMING_BUFFER
+                    if (use_stream && !bd->StreamHasBaseVertex)
+                        ImGui_ImplOpenGL3_DPF_SetStreamVertexOffset(bd, stream_vtx_offset);
+#endif
+                }
                 else
                     pcmd->UserCallback(draw_list, pcmd);
             }
@@ -626,8 +860,34 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
                 // Apply scissor/clipping rectangle (Y is inverted in OpenGL)
                 GL_CALL(glScissor((int)clip_min.x, (int)((float)fb_height - clip_max.y), (int)(clip_max.x - clip_min.x), (int)(clip_max.y - clip_min.y)));
 
+#ifdef IMGUI_DPF_BACKEND
+                // [DPF] Draw the font atlas with the distance field shader
+                if (bd->DistanceFieldShaderHandle)
+                {
+                    const GLuint shader_handle = pcmd->GetTexID() == font_tex_id ? bd->DistanceFieldShaderHandle : bd->ShaderHandle;
+                    if (bd->CurrentShaderHandle != shader_handle)
+                    {
+                        GL_CALL(glUseProgram(shader_handle));
+                        bd->CurrentShaderHandle = shader_handle;
+                    }
+                }
+#endif
+
                 // Bind texture, Draw
                 GL_CALL(glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->GetTexID()));
+#ifdef IMGUI_DPF_STREAMING_BUFFER
+                if (use_stream)
+                {
+                    const GLvoid* idx_ptr = (GLvoid*)(intptr_t)((stream_idx_offset + (int)pcmd->IdxOffset) * (int)sizeof(ImDrawIdx));
+#ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
+                    if (bd->StreamHasBaseVertex)
+                        GL_CALL(glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_ptr, (GLint)(stream_vtx_offset + (int)pcmd->VtxOffset)));
+                    else
+#endif
+                    GL_CALL(glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, idx_ptr));
+                }
+                else
+#endif
 #ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
                 if (bd->GlVersion >= 320)
                     GL_CALL(glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(pcmd->IdxOffset * sizeof(ImDrawIdx)), (GLint)pcmd->VtxOffset));
@@ -636,7 +896,20 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
                 GL_CALL(glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(pcmd->IdxOffset * sizeof(ImDrawIdx))));
             }
         }
+#ifdef IMGUI_DPF_STREAMING_BUFFER
+        stream_vtx_offset += draw_list->VtxBuffer.Size;
+        stream_idx_offset += draw_list->IdxBuffer.Size;
+#endif
+    }
+
+#ifdef IMGUI_DPF_STREAMING_BUFFER
+    // [DPF] Fence the streaming buffer segment of this frame and move on to the next one
+    if (bd->StreamMode == 2)
+    {
+        bd->StreamFences[bd->StreamSegment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        bd->StreamSegment = (bd->StreamSegment + 1) % IMGUI_DPF_STREAMING_BUFFER_SEGMENTS;
     }
+#endif
 
     // Destroy the temporary VAO
 #ifdef IMGUI_IMPL_OPENGL_USE_VERTEX_ARRAY
@@ -688,6 +961,12 @@ bool ImGui_ImplOpenGL3_CreateFontsTexture()
     ImGuiIO& io = ImGui::GetIO();
     ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
 
+#ifdef IMGUI_DPF_BACKEND
+    // Font texture is already provided by DPF (shared font atlas cache)
+    if (io.Fonts->TexID != 0)
+        return true;
+#endif
+
     // Build texture atlas
     unsigned char* pixels;
     int width, height;
@@ -729,6 +1008,20 @@ void ImGui_ImplOpenGL3_DestroyFontsTexture()
     }
 }
 
+#ifdef IMGUI_DPF_BACKEND
+bool ImGui_ImplOpenGL3_DPF_SetDistanceFieldFonts(bool enabled)
+{
+    ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
+    IM_ASSERT(bd != nullptr && "Context or backend not initialized! Did you call ImGui_ImplOpenGL3_Init()?");
+    if (enabled && bd->GlProfileIsES2)
+        return false;
+    if (bd->DistanceFieldFonts != enabled && bd->ShaderHandle)
+        ImGui_ImplOpenGL3_DestroyDeviceObjects();
+    bd->DistanceFieldFonts = enabled;
+    return true;
+}
+#endif
+
 // If you get an error please report on github. You may try different GL context version or GLSL version. See GL<>GLSL version table at the top of this file.
 static bool CheckShader(GLuint handle, const char* desc)
 {
@@ -767,6 +1060,117 @@ static bool CheckProgram(GLuint handle, const char* desc)
     return (GLboolean)status == GL_TRUE;
 }
 
+#ifdef IMGUI_DPF_BACKEND
+// [DPF] Shader programs shared by all backend instances using the same GL context, reference counted.
+// Instances may live on different threads (one per GL context), so the cache is only accessed with its lock held.
+struct ImGui_ImplOpenGL3_DPF_CachedPrograms
+{
+    uintptr_t       ContextKey;
+    char            GlslVersionString[32];
+    bool            DistanceFieldFonts;
+    GLuint          ShaderHandle;
+    GLint           AttribLocationTex;
+    GLint           AttribLocationProjMtx;
+    GLuint          AttribLocationVtxPos;
+    GLuint          AttribLocationVtxUV;
+    GLuint          AttribLocationVtxColor;
+    GLuint          DistanceFieldShaderHandle;
+    GLint           DistanceFieldLocationTex;
+    GLint           DistanceFieldLocationProjMtx;
+    int             RefCount;
+};
+static ImVector<ImGui_ImplOpenGL3_DPF_CachedPrograms> g_DpfCachedPrograms;
+static unsigned int g_DpfCachedProgramsHits = 0;
+static std::mutex g_DpfCachedProgramsMutex;
+
+static bool ImGui_ImplOpenGL3_DPF_AcquireCachedPrograms(ImGui_ImplOpenGL3_Data* bd)
+{
+    if (bd->ProgramCacheKey == 0)
+        return false;
+    const std::lock_guard<std::mutex> lock(g_DpfCachedProgramsMutex);
+    for (ImGui_ImplOpenGL3_DPF_CachedPrograms& entry : g_DpfCachedPrograms)
+    {
+        if (entry.ContextKey != bd->ProgramCacheKey || entry.DistanceFieldFonts != bd->DistanceFieldFonts || strcmp(entry.GlslVersionString, bd->GlslVersionString) != 0)
+            continue;
+        bd->ShaderHandle = entry.ShaderHandle;
+        bd->AttribLocationTex = entry.AttribLocationTex;
+        bd->AttribLocationProjMtx = entry.AttribLocationProjMtx;
+        bd->AttribLocationVtxPos = entry.AttribLocationVtxPos;
+        bd->AttribLocationVtxUV = entry.AttribLocationVtxUV;
+        bd->AttribLocationVtxColor = entry.AttribLocationVtxColor;
+        bd->DistanceFieldShaderHandle = entry.DistanceFieldShaderHandle;
+        bd->DistanceFieldLocationTex = entry.DistanceFieldLocationTex;
+        bd->DistanceFieldLocationProjMtx = entry.DistanceFieldLocationProjMtx;
+        entry.RefCount++;
+        g_DpfCachedProgramsHits++;
+        return true;
+    }
+    return false;
+}
+
+static void ImGui_ImplOpenGL3_DPF_StoreCachedPrograms(ImGui_ImplOpenGL3_Data* bd)
+{
+    if (bd->ProgramCacheKey == 0)
+        return;
+    ImGui_ImplOpenGL3_DPF_CachedPrograms entry;
+    entry.ContextKey = bd->ProgramCacheKey;
+    memcpy(entry.GlslVersionString, bd->GlslVersionString, sizeof(entry.GlslVersionString));
+    entry.DistanceFieldFonts = bd->DistanceFieldFonts;
+    entry.ShaderHandle = bd->ShaderHandle;
+    entry.AttribLocationTex = bd->AttribLocationTex;
+    entry.AttribLocationProjMtx = bd->AttribLocationProjMtx;
+    entry.AttribLocationVtxPos = bd->AttribLocationVtxPos;
+    entry.AttribLocationVtxUV = bd->AttribLocationVtxUV;
+    entry.AttribLocationVtxColor = bd->AttribLocationVtxColor;
+    entry.DistanceFieldShaderHandle = bd->DistanceFieldShaderHandle;
+    entry.DistanceFieldLocationTex = bd->DistanceFieldLocationTex;
+    entry.DistanceFieldLocationProjMtx = bd->DistanceFieldLocationProjMtx;
+    entry.RefCount = 1;
+    const std::lock_guard<std::mutex> lock(g_DpfCachedProgramsMutex);
+    g_DpfCachedPrograms.push_back(entry);
+}
+
+// Returns true if the programs were shared, in which case they are only deleted by their last user
+static bool ImGui_ImplOpenGL3_DPF_ReleaseCachedPrograms(ImGui_ImplOpenGL3_Data* bd)
+{
+    const std::lock_guard<std::mutex> lock(g_DpfCachedProgramsMutex);
+    for (int i = 0; i < g_DpfCachedPrograms.Size; i++)
+    {
+        ImGui_ImplOpenGL3_DPF_CachedPrograms& entry = g_DpfCachedPrograms[i];
+        if (entry.ContextKey != bd->ProgramCacheKey || entry.ShaderHandle != bd->ShaderHandle)
+            continue;
+        if (--entry.RefCount == 0)
+        {
+            glDeleteProgram(entry.ShaderHandle);
+            if (entry.DistanceFieldShaderHandle)
+                glDeleteProgram(entry.DistanceFieldShaderHandle);
+            g_DpfCachedPrograms.erase(g_DpfCachedPrograms.Data + i);
+            if (g_DpfCachedPrograms.Size == 0)
+                g_DpfCachedPrograms.clear(); // Free memory while an ImGui context is still around
+        }
+        bd->ShaderHandle = 0;
+        bd->DistanceFieldShaderHandle = 0;
+        return true;
+    }
+    return false;
+}
+
+void ImGui_ImplOpenGL3_DPF_SetProgramCacheKey(uintptr_t key)
+{
+    ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
+    IM_ASSERT(bd != nullptr && "Context or backend not initialized! Did you call ImGui_ImplOpenGL3_Init()?");
+    if (bd->ProgramCacheKey != key && bd->ShaderHandle)
+        ImGui_ImplOpenGL3_DestroyDeviceObjects();
+    bd->ProgramCacheKey = key;
+}
+
+unsigned int ImGui_ImplOpenGL3_DPF_GetProgramCacheHits()
+{
+    const std::lock_guard<std::mutex> lock(g_DpfCachedProgramsMutex);
+    return g_DpfCachedProgramsHits;
+}
+#endif
+
 bool    ImGui_ImplOpenGL3_CreateDeviceObjects()
 {
     ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
@@ -888,62 +1292,178 @@ bool    ImGui_ImplOpenGL3_CreateDeviceObjects()
         "    Out_Color = Frag_Color * texture(Texture, Frag_UV.st);\n"
         "}\n";
 
+#ifdef IMGUI_DPF_BACKEND
+    // [DPF] Signed distance field font shaders, using screen-space derivatives for anti-aliasing at any scale
+    const GLchar* sdf_fragment_shader_glsl_120 =
+        "#ifdef GL_ES\n"
+        "    precision mediump float;\n"
+        "#endif\n"
+        "uniform sampler2D Texture;\n"
+        "varying vec2 Frag_UV;\n"
+        "varying vec4 Frag_Color;\n"
+        "void main()\n"
+        "{\n"
+        "    vec4 tex = texture2D(Texture, Frag_UV.st);\n"
+        "    float alpha = clamp((tex.a - 0.5) / max(fwidth(tex.a), 0.0001) + 0.5, 0.0, 1.0);\n"
+        "    gl_FragColor = Frag_Color * vec4(tex.rgb, alpha);\n"
+        "}\n";
+
+    const GLchar* sdf_fragment_shader_glsl_130 =
+        "uniform sampler2D Texture;\n"
+        "in vec2 Frag_UV;\n"
+        "in vec4 Frag_Color;\n"
+        "out vec4 Out_Color;\n"
+        "void main()\n"
+        "{\n"
+        "    vec4 tex = texture(Texture, Frag_UV.st);\n"
+        "    float alpha = clamp((tex.a - 0.5) / max(fwidth(tex.a), 0.0001) + 0.5, 0.0, 1.0);\n"
+        "    Out_Color = Frag_Color * vec4(tex.rgb, alpha);\n"
+        "}\n";
+
+    const GLchar* sdf_fragment_shader_glsl_300_es =
+        "precision mediump float;\n"
+        "uniform sampler2D Texture;\n"
+        "in vec2 Frag_UV;\n"
+        "in vec4 Frag_Color;\n"
+        "layout (location = 0) out vec4 Out_Color;\n"
+        "void main()\n"
+        "{\n"
+        "    vec4 tex = texture(Texture, Frag_UV.st);\n"
+        "    float alpha = clamp((tex.a - 0.5) / max(fwidth(tex.a), 0.0001) + 0.5, 0.0, 1.0);\n"
+        "    Out_Color = Frag_Color * vec4(tex.rgb, alpha);\n"
+        "}\n";
+
+    const GLchar* sdf_fragment_shader_glsl_410_core =
+        "in vec2 Frag_UV;\n"
+        "in vec4 Frag_Color;\n"
+        "uniform sampler2D Texture;\n"
+        "layout (location = 0) out vec4 Out_Color;\n"
+        "void main()\n"
+        "{\n"
+        "    vec4 tex = texture(Texture, Frag_UV.st);\n"
+        "    float alpha = clamp((tex.a - 0.5) / max(fwidth(tex.a), 0.0001) + 0.5, 0.0, 1.0);\n"
+        "    Out_Color = Frag_Color * vec4(tex.rgb, alpha);\n"
+        "}\n";
+#endif
+
     // Select shaders matching our GLSL versions
     const GLchar* vertex_shader = nullptr;
     const GLchar* fragment_shader = nullptr;
+#ifdef IMGUI_DPF_BACKEND
+    const GLchar* sdf_fragment_shader = nullptr;
+#endif
     if (glsl_version < 130)
     {
         vertex_shader = vertex_shader_glsl_120;
         fragment_shader = fragment_shader_glsl_120;
+#ifdef IMGUI_DPF_BACKEND
+        sdf_fragment_shader = sdf_fragment_shader_glsl_120;
+#endif
     }
     else if (glsl_version >= 410)
     {
         vertex_shader = vertex_shader_glsl_410_core;
         fragment_shader = fragment_shader_glsl_410_core;
+#ifdef IMGUI_DPF_BACKEND
+        sdf_fragment_shader = sdf_fragment_shader_glsl_410_core;
+#endif
     }
     else if (glsl_version == 300)
     {
         vertex_shader = vertex_shader_glsl_300_es;
         fragment_shader = fragment_shader_glsl_300_es;
+#ifdef IMGUI_DPF_BACKEND
+        sdf_fragment_shader = sdf_fragment_shader_glsl_300_es;
+#endif
     }
     else
     {
         vertex_shader = vertex_shader_glsl_130;
         fragment_shader = fragment_shader_glsl_130;
+#ifdef IMGUI_DPF_BACKEND
+        sdf_fragment_shader = sdf_fragment_shader_glsl_130;
+#endif
     }
 
-    // Create shaders
-    const GLchar* vertex_shader_with_version[2] = { bd->GlslVersionString, vertex_shader };
-    GLuint vert_handle;
-    GL_CALL(vert_handle = glCreateShader(GL_VERTEX_SHADER));
-    glShaderSource(vert_handle, 2, vertex_shader_with_version, nullptr);
-    glCompileShader(vert_handle);
-    CheckShader(vert_handle, "vertex shader");
-
-    const GLchar* fragment_shader_with_version[2] = { bd->GlslVersionString, fragment_shader };
-    GLuint frag_handle;
-    GL_CALL(frag_handle = glCreateShader(GL_FRAGMENT_SHADER));
-    glShaderSource(frag_handle, 2, fragment_shader_with_version, nullptr);
-    glCompileShader(frag_handle);
-    CheckShader(frag_handle, "fragment shader");
-
-    // Link
-    bd->ShaderHandle = glCreateProgram();
-    glAttachShader(bd->ShaderHandle, vert_handle);
-    glAttachShader(bd->ShaderHandle, frag_handle);
-    glLinkProgram(bd->ShaderHandle);
-    CheckProgram(bd->ShaderHandle, "shader program");
-
-    glDetachShader(bd->ShaderHandle, vert_handle);
-    glDetachShader(bd->ShaderHandle, frag_handle);
-    glDeleteShader(vert_handle);
-    glDeleteShader(frag_handle);
-
-    bd->AttribLocationTex = glGetUniformLocation(bd->ShaderHandle, "Texture");
-    bd->AttribLocationProjMtx = glGetUniformLocation(bd->ShaderHandle, "ProjMtx");
-    bd->AttribLocationVtxPos = (GLuint)glGetAttribLocation(bd->ShaderHandle, "Position");
-    bd->AttribLocationVtxUV = (GLuint)glGetAttribLocation(bd->ShaderHandle, "UV");
-    bd->AttribLocationVtxColor = (GLuint)glGetAttribLocation(bd->ShaderHandle, "Color");
+#ifdef IMGUI_DPF_BACKEND
+    // [DPF] Reuse the shader programs of another backend instance on the same GL context
+    if (!ImGui_ImplOpenGL3_DPF_AcquireCachedPrograms(bd))
+#endif
+    {
+        // Create shaders
+        const GLchar* vertex_shader_with_version[2] = { bd->GlslVersionString, vertex_shader };
+        GLuint vert_handle;
+        GL_CALL(vert_handle = glCreateShader(GL_VERTEX_SHADER));
+        glShaderSource(vert_handle, 2, vertex_shader_with_version, nullptr);
+        glCompileShader(vert_handle);
+        CheckShader(vert_handle, "vertex shader");
+
+        const GLchar* fragment_shader_with_version[2] = { bd->GlslVersionString, fragment_shader };
+        GLuint frag_handle;
+        GL_CALL(frag_handle = glCreateShader(GL_FRAGMENT_SHADER));
+        glShaderSource(frag_handle, 2, fragment_shader_with_version, nullptr);
+        glCompileShader(frag_handle);
+        CheckShader(frag_handle, "fragment shader");
+
+        // Link
+        bd->ShaderHandle = glCreateProgram();
+        glAttachShader(bd->ShaderHandle, vert_handle);
+        glAttachShader(bd->ShaderHandle, frag_handle);
+        glLinkProgram(bd->ShaderHandle);
+        CheckProgram(bd->ShaderHandle, "shader program");
+
+    #ifdef IMGUI_DPF_BACKEND
+        // [DPF] Link the distance field font shader with the same vertex shader and attribute locations
+        if (bd->DistanceFieldFonts)
+        {
+            const GLchar* sdf_fragment_shader_with_version[2] = { bd->GlslVersionString, sdf_fragment_shader };
+            GLuint sdf_frag_handle;
+            GL_CALL(sdf_frag_handle = glCreateShader(GL_FRAGMENT_SHADER));
+            glShaderSource(sdf_frag_handle, 2, sdf_fragment_shader_with_version, nullptr);
+            glCompileShader(sdf_frag_handle);
+            CheckShader(sdf_frag_handle, "distance field fragment shader");
+
+            bd->DistanceFieldShaderHandle = glCreateProgram();
+            glAttachShader(bd->DistanceFieldShaderHandle, vert_handle);
+            glAttachShader(bd->DistanceFieldShaderHandle, sdf_frag_handle);
+            glBindAttribLocation(bd->DistanceFieldShaderHandle, (GLuint)glGetAttribLocation(bd->ShaderHandle, "Position"), "Position");
+            glBindAttribLocation(bd->DistanceFieldShaderHandle, (GLuint)glGetAttribLocation(bd->ShaderHandle, "UV"), "UV");
+            glBindAttribLocation(bd->DistanceFieldShaderHandle, (GLuint)glGetAttribLocation(bd->ShaderHandle, "Color"), "Color");
+            glLinkProgram(bd->DistanceFieldShaderHandle);
+            const bool sdf_linked = CheckProgram(bd->DistanceFieldShaderHandle, "distance field shader program");
+
+            glDetachShader(bd->DistanceFieldShaderHandle, vert_handle);
+            glDetachShader(bd->DistanceFieldShaderHandle, sdf_frag_handle);
+            glDeleteShader(sdf_frag_handle);
+
+            if (sdf_linked)
+            {
+                bd->DistanceFieldLocationTex = glGetUniformLocation(bd->DistanceFieldShaderHandle, "Texture");
+                bd->DistanceFieldLocationProjMtx = glGetUniformLocation(bd->DistanceFieldShaderHandle, "ProjMtx");
+            }
+            else
+            {
+                glDeleteProgram(bd->DistanceFieldShaderHandle);
+                bd->DistanceFieldShaderHandle = 0;
+            }
+        }
+    #endif
+
+        glDetachShader(bd->ShaderHandle, vert_handle);
+        glDetachShader(bd->ShaderHandle, frag_handle);
+        glDeleteShader(vert_handle);
+        glDeleteShader(frag_handle);
+
+        bd->AttribLocationTex = glGetUniformLocation(bd->ShaderHandle, "Texture");
+        bd->AttribLocationProjMtx = glGetUniformLocation(bd->ShaderHandle, "ProjMtx");
+        bd->AttribLocationVtxPos = (GLuint)glGetAttribLocation(bd->ShaderHandle, "Position");
+        bd->AttribLocationVtxUV = (GLuint)glGetAttribLocation(bd->ShaderHandle, "UV");
+        bd->AttribLocationVtxColor = (GLuint)glGetAttribLocation(bd->ShaderHandle, "Color");
+
+#ifdef IMGUI_DPF_BACKEND
+        ImGui_ImplOpenGL3_DPF_StoreCachedPrograms(bd);
+#endif
+    }
 
     // Create buffers
     glGenBuffers(1, &bd->VboHandle);
@@ -967,9 +1487,18 @@ bool    ImGui_ImplOpenGL3_CreateDeviceObjects()
 void    ImGui_ImplOpenGL3_DestroyDeviceObjects()
 {
     ImGui_ImplOpenGL3_Data* bd = ImGui_ImplOpenGL3_GetBackendData();
+#ifdef IMGUI_DPF_STREAMING_BUFFER
+    ImGui_ImplOpenGL3_DPF_DestroyStreamBuffers(bd);
+#endif
     if (bd->VboHandle)      { glDeleteBuffers(1, &bd->VboHandle); bd->VboHandle = 0; }
     if (bd->ElementsHandle) { glDeleteBuffers(1, &bd->ElementsHandle); bd->ElementsHandle = 0; }
+#ifdef IMGUI_DPF_BACKEND
+    if (bd->ShaderHandle)   { ImGui_ImplOpenGL3_DPF_ReleaseCachedPrograms(bd); }
+#endif
     if (bd->ShaderHandle)   { glDeleteProgram(bd->ShaderHandle); bd->ShaderHandle = 0; }
+#ifdef IMGUI_DPF_BACKEND
+    if (bd->DistanceFieldShaderHandle) { glDeleteProgram(bd->DistanceFieldShaderHandle); bd->DistanceFieldShaderHandle = 0; }
+#endif
     ImGui_ImplOpenGL3_DestroyFontsTexture();
 }
 
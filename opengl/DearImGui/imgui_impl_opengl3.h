@@ -41,6 +41,19 @@ IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DestroyFontsTexture();
 IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_CreateDeviceObjects();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DestroyDeviceObjects();
 
+#ifdef IMGUI_DPF_BACKEND
+#include <stdint.h>     // uintptr_t
+
+// [DPF] Draw the font atlas texture as a signed distance field, which needs shader derivatives (not available on GL ES 2).
+// Returns false if not supported, device objects are recreated on the next frame when changed.
+IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_DPF_SetDistanceFieldFonts(bool enabled);
+
+// [DPF] Share shader programs with other backend instances using the same key, which must identify a single GL context.
+// Only the first instance compiles them, others are counted as cache hits. A key of 0 (the default) disables sharing.
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DPF_SetProgramCacheKey(uintptr_t key);
+IMGUI_IMPL_API unsigned int ImGui_ImplOpenGL3_DPF_GetProgramCacheHits();
+#endif
+
 // Configuration flags to add in your imconfig file:
 //#define IMGUI_IMPL_OPENGL_ES2     // Enable ES 2 (Auto-detected on Emscripten)
 //#define IMGUI_IMPL_OPENGL_ES3     // Enable ES 3 (Auto-detected on iOS/Android)
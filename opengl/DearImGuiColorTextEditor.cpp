@@ -32,10 +32,162 @@
 
 #include "Application.hpp"
 
-#include <fstream>
+#include <cstdio>
+
+#ifdef DISTRHO_OS_WINDOWS
+# include <windows.h>
+#else
+# include <climits>
+# include <cstdlib>
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
 
 START_NAMESPACE_DGL
 
+// --------------------------------------------------------------------------------------------------------------------
+// amount of bytes appended to the editor per frame while loading a file
+
+static constexpr const size_t kFileLoadChunkSize = 1024 * 1024;
+
+#ifdef DISTRHO_OS_WINDOWS
+static std::wstring toWideString(const char* const str)
+{
+    const int len = MultiByteToWideChar(CP_UTF8, 0, str, -1, nullptr, 0);
+    if (len <= 0)
+        return std::wstring();
+
+    std::wstring wstr(static_cast<size_t>(len), L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, str, -1, &wstr[0], len);
+    wstr.resize(static_cast<size_t>(len - 1));
+    return wstr;
+}
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+// read-only memory mapping of a whole file
+
+class MappedFile
+{
+public:
+    MappedFile() noexcept
+        : data(nullptr),
+          size(0) {}
+
+    ~MappedFile() noexcept
+    {
+        close();
+    }
+
+    bool open(const char* const filename)
+    {
+        close();
+
+       #ifdef DISTRHO_OS_WINDOWS
+        const HANDLE file = CreateFileW(toWideString(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(file, &fileSize) == FALSE)
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        // empty files can not be mapped
+        if (fileSize.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return true;
+        }
+
+        // the view keeps the mapping and file alive, so their handles are closed right away
+        const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+
+        if (mapping == nullptr)
+            return false;
+
+        data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        CloseHandle(mapping);
+
+        if (data == nullptr)
+            return false;
+
+        size = static_cast<size_t>(fileSize.QuadPart);
+       #else
+        const int fd = ::open(filename, O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        // empty files can not be mapped
+        if (st.st_size == 0)
+        {
+            ::close(fd);
+            return true;
+        }
+
+        // the mapping stays valid after closing the file
+        void* const ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (ptr == MAP_FAILED)
+            return false;
+
+       #ifdef MADV_SEQUENTIAL
+        madvise(ptr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+       #endif
+
+        data = static_cast<const char*>(ptr);
+        size = static_cast<size_t>(st.st_size);
+       #endif
+
+        return true;
+    }
+
+    void close() noexcept
+    {
+        if (data == nullptr)
+            return;
+
+       #ifdef DISTRHO_OS_WINDOWS
+        UnmapViewOfFile(data);
+       #else
+        munmap(const_cast<char*>(data), size);
+       #endif
+
+        data = nullptr;
+        size = 0;
+    }
+
+    const char* getData() const noexcept
+    {
+        return data;
+    }
+
+    size_t getSize() const noexcept
+    {
+        return size;
+    }
+
+private:
+    const char* data;
+    size_t size;
+
+    DISTRHO_DECLARE_NON_COPYABLE(MappedFile)
+};
+
 // --------------------------------------------------------------------------------------------------------------------
 
 template <class BaseWidget>
@@ -46,12 +198,248 @@ struct ImGuiTextEditor<BaseWidget>::TextEditorPrivateData {
     bool isStandalone;
     bool showMenu;
 
+    // file being loaded, appended to the editor one chunk per frame
+    MappedFile loadingFile;
+    size_t loadingOffset;
+    bool loading;
+    bool readOnlyBeforeLoading;
+
+    // find bar, opened with Ctrl+F
+    char searchText[256];
+    char replaceText[256];
+    bool searchCaseSensitive;
+    bool searchWholeWord;
+    bool showFindBar;
+    bool focusFindBar;
+
+    Callback* callback;
+
     explicit TextEditorPrivateData(ImGuiTextEditor<BaseWidget>* const s)
         : self(s),
+          editor(TextEditor::LanguageDefinition::CPlusPlus()),
           isStandalone(false),
-          showMenu(false)
+          showMenu(false),
+          loadingOffset(0),
+          loading(false),
+          readOnlyBeforeLoading(false),
+          searchCaseSensitive(false),
+          searchWholeWord(false),
+          showFindBar(false),
+          focusFindBar(false),
+          callback(nullptr)
+    {
+        searchText[0] = replaceText[0] = '\0';
+    }
+
+    bool openFile(const char* const filename)
+    {
+        if (loading)
+            finishLoading();
+
+        if (! loadingFile.open(filename))
+            return false;
+
+        file = filename;
+        loadingOffset = 0;
+        loading = true;
+        readOnlyBeforeLoading = editor.IsReadOnly();
+
+        // the text can not be edited until the whole file is in
+        editor.SetText(std::string());
+        editor.SetReadOnly(true);
+
+        // load the first chunk right away, so there is something to show on the next frame
+        loadNextChunk();
+        return true;
+    }
+
+    void loadNextChunk()
+    {
+        const size_t remaining = loadingFile.getSize() - loadingOffset;
+        const size_t size = remaining < kFileLoadChunkSize ? remaining : kFileLoadChunkSize;
+
+        if (size != 0)
+        {
+            editor.AppendText(loadingFile.getData() + loadingOffset, size);
+            loadingOffset += size;
+        }
+
+        if (loadingOffset == loadingFile.getSize())
+            finishLoading();
+        else
+            self->repaint();
+    }
+
+    void finishLoading()
     {
-        editor.SetLanguageDefinition(TextEditor::LanguageDefinition::CPlusPlus());
+        loadingFile.close();
+        loading = false;
+        editor.SetReadOnly(readOnlyBeforeLoading);
+    }
+
+    static bool writeToFile(const char* const data, const size_t size, void* const userData)
+    {
+        return std::fwrite(data, 1, size, static_cast<FILE*>(userData)) == size;
+    }
+
+    // writes to a temporary file next to the target one, then moves it into place
+    // so the previous file contents are kept intact if anything goes wrong
+    bool saveFile()
+    {
+        DISTRHO_SAFE_ASSERT_RETURN(! file.empty() && ! loading, false);
+
+       #ifdef DISTRHO_OS_WINDOWS
+        const std::wstring filename = toWideString(file.c_str());
+        const size_t separator = filename.find_last_of(L"\\/");
+        const std::wstring dirname = separator != std::wstring::npos ? filename.substr(0, separator + 1) : L".";
+
+        // creates a new empty file with a unique name, never reusing an existing one
+        wchar_t tmpname[MAX_PATH];
+        if (GetTempFileNameW(dirname.c_str(), L"tmp", 0, tmpname) == 0)
+            return false;
+
+        FILE* const f = _wfopen(tmpname, L"wb");
+        if (f == nullptr)
+        {
+            DeleteFileW(tmpname);
+            return false;
+        }
+
+        bool ok = editor.WriteText(writeToFile, f) && std::fflush(f) == 0;
+        ok = std::fclose(f) == 0 && ok;
+
+        // keep the attributes and permissions of the existing file
+        if (ok && GetFileAttributesW(filename.c_str()) != INVALID_FILE_ATTRIBUTES)
+            ok = ReplaceFileW(filename.c_str(), tmpname, nullptr, REPLACEFILE_IGNORE_MERGE_ERRORS, nullptr, nullptr) != FALSE;
+        else if (ok)
+            ok = MoveFileExW(tmpname, filename.c_str(), MOVEFILE_WRITE_THROUGH) != FALSE;
+
+        if (! ok)
+            DeleteFileW(tmpname);
+       #else
+        // write through symbolic links instead of replacing them
+        std::string filename(file);
+        char realname[PATH_MAX];
+        if (realpath(file.c_str(), realname) != nullptr)
+            filename = realname;
+
+        std::string tmpname(filename + ".XXXXXX");
+        const int fd = mkstemp(&tmpname[0]);
+        if (fd < 0)
+            return false;
+
+        // keep the permissions of the existing file
+        struct stat st;
+        if (stat(filename.c_str(), &st) == 0)
+            fchmod(fd, st.st_mode & 07777);
+
+        FILE* const f = fdopen(fd, "wb");
+        if (f == nullptr)
+        {
+            ::close(fd);
+            unlink(tmpname.c_str());
+            return false;
+        }
+
+        bool ok = editor.WriteText(writeToFile, f) && std::fflush(f) == 0 && fsync(fileno(f)) == 0;
+        ok = std::fclose(f) == 0 && ok;
+        ok = ok && std::rename(tmpname.c_str(), filename.c_str()) == 0;
+
+        if (! ok)
+            unlink(tmpname.c_str());
+       #endif
+
+        return ok;
+    }
+
+    void save()
+    {
+        if (! saveFile())
+            d_stderr2("ImGuiTextEditor: failed to save '%s'", file.c_str());
+    }
+
+    static void textChanged(const TextEditor::TextChange& change, const uint64_t version, void* const userData)
+    {
+        TextEditorPrivateData* const pData = static_cast<TextEditorPrivateData*>(userData);
+        DISTRHO_SAFE_ASSERT_RETURN(pData->callback != nullptr,);
+
+        const ImGuiTextEditorChange c = {
+            change.mFirstLine,
+            change.mRemovedLines,
+            change.mAddedLines,
+            change.mText.c_str(),
+            change.mText.size(),
+        };
+        pData->callback->textEditorChanged(pData->self, c, version);
+    }
+
+    void updateSearch()
+    {
+        editor.SetSearch(showFindBar ? searchText : "", searchCaseSensitive, searchWholeWord);
+    }
+
+    void openFindBar()
+    {
+        // start from the selected text, if any
+        const std::string selected(editor.GetSelectedText());
+        if (selected.size() != 0 && selected.find('\n') == std::string::npos)
+            std::snprintf(searchText, sizeof(searchText), "%s", selected.c_str());
+
+        showFindBar = focusFindBar = true;
+        updateSearch();
+    }
+
+    void closeFindBar()
+    {
+        showFindBar = false;
+        updateSearch();
+    }
+
+    void renderFindBar()
+    {
+        bool changed = false;
+
+        if (focusFindBar)
+        {
+            ImGui::SetKeyboardFocusHere();
+            focusFindBar = false;
+        }
+
+        ImGui::SetNextItemWidth(ImGui::GetFontSize() * 16);
+        if (ImGui::InputTextWithHint("##find", "Find", searchText, sizeof(searchText), ImGuiInputTextFlags_EnterReturnsTrue))
+        {
+            editor.FindNext(ImGui::GetIO().KeyShift);
+            ImGui::SetKeyboardFocusHere(-1);
+        }
+        changed |= ImGui::IsItemEdited();
+
+        ImGui::SameLine();
+        changed |= ImGui::Checkbox("Match case", &searchCaseSensitive);
+        ImGui::SameLine();
+        changed |= ImGui::Checkbox("Whole word", &searchWholeWord);
+
+        if (changed)
+            updateSearch();
+
+        ImGui::SameLine();
+        if (ImGui::Button("Previous"))
+            editor.FindNext(true);
+        ImGui::SameLine();
+        if (ImGui::Button("Next"))
+            editor.FindNext();
+
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(ImGui::GetFontSize() * 16);
+        ImGui::InputTextWithHint("##replace", "Replace", replaceText, sizeof(replaceText));
+        ImGui::SameLine();
+        ImGui::BeginDisabled(editor.IsReadOnly());
+        if (ImGui::Button("Replace all"))
+            editor.ReplaceAll(replaceText);
+        ImGui::EndDisabled();
+
+        ImGui::SameLine();
+        if (ImGui::Button("Close") || ImGui::IsKeyPressed(ImGuiKey_Escape, false))
+            closeFindBar();
     }
 
     void renderMenuContent()
@@ -66,10 +454,9 @@ struct ImGuiTextEditor<BaseWidget>::TextEditorPrivateData {
                     {
                         self->getWindow().openFileBrowser();
                     }
-                    if (ImGui::MenuItem("Save", "Ctrl+S", nullptr, file.size() != 0))
+                    if (ImGui::MenuItem("Save", "Ctrl+S", nullptr, file.size() != 0 && ! loading))
                     {
-                        // auto textToSave = editor.GetText();
-                        /// save text....
+                        save();
                     }
                     if (ImGui::MenuItem("Quit", "Ctrl+Q"))
                     {
@@ -115,6 +502,15 @@ struct ImGuiTextEditor<BaseWidget>::TextEditorPrivateData {
                 if (ImGui::MenuItem("Select all", "Ctrl-A", nullptr))
                     editor.SetSelection(TextEditor::Coordinates(), TextEditor::Coordinates(editor.GetTotalLines(), 0));
 
+                ImGui::Separator();
+
+                if (ImGui::MenuItem("Find...", "Ctrl-F"))
+                    openFindBar();
+                if (ImGui::MenuItem("Find next", "F3", nullptr, editor.GetSearchText().size() != 0))
+                    editor.FindNext();
+                if (ImGui::MenuItem("Find previous", "Shift-F3", nullptr, editor.GetSearchText().size() != 0))
+                    editor.FindNext(true);
+
                 ImGui::EndMenu();
             }
 
@@ -126,6 +522,13 @@ struct ImGuiTextEditor<BaseWidget>::TextEditorPrivateData {
                     editor.SetPalette(TextEditor::GetLightPalette());
                 if (ImGui::MenuItem("Retro blue palette"))
                     editor.SetPalette(TextEditor::GetRetroBluePalette());
+
+                ImGui::Separator();
+
+                bool wordWrap = editor.IsWordWrapEnabled();
+                if (ImGui::MenuItem("Word wrap", nullptr, &wordWrap))
+                    editor.SetWordWrap(wordWrap);
+
                 ImGui::EndMenu();
             }
             ImGui::EndMenuBar();
@@ -197,6 +600,52 @@ bool ImGuiTextEditor<BaseWidget>::hasTextChangedSinceLastTime()
     return teData->editor.IsTextChangedSinceLastTime();
 }
 
+template <class BaseWidget>
+void ImGuiTextEditor<BaseWidget>::setCallback(Callback* const callback)
+{
+    teData->callback = callback;
+    teData->editor.SetTextChangeCallback(callback != nullptr ? TextEditorPrivateData::textChanged : nullptr, teData);
+}
+
+template <class BaseWidget>
+uint64_t ImGuiTextEditor<BaseWidget>::getTextVersion() const
+{
+    return teData->editor.GetTextVersion();
+}
+
+template <class BaseWidget>
+void ImGuiTextEditor<BaseWidget>::setWordWrap(const bool wordWrap)
+{
+    teData->editor.SetWordWrap(wordWrap);
+}
+
+template <class BaseWidget>
+bool ImGuiTextEditor<BaseWidget>::isWordWrapEnabled() const
+{
+    return teData->editor.IsWordWrapEnabled();
+}
+
+template <class BaseWidget>
+void ImGuiTextEditor<BaseWidget>::setSearch(const std::string& text, const bool caseSensitive, const bool wholeWord)
+{
+    std::snprintf(teData->searchText, sizeof(teData->searchText), "%s", text.c_str());
+    teData->searchCaseSensitive = caseSensitive;
+    teData->searchWholeWord = wholeWord;
+    teData->editor.SetSearch(text, caseSensitive, wholeWord);
+}
+
+template <class BaseWidget>
+bool ImGuiTextEditor<BaseWidget>::findNext(const bool backwards)
+{
+    return teData->editor.FindNext(backwards);
+}
+
+template <class BaseWidget>
+int ImGuiTextEditor<BaseWidget>::replaceAll(const std::string& replacement)
+{
+    return teData->editor.ReplaceAll(replacement);
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 
 template <class BaseWidget>
@@ -219,11 +668,25 @@ void ImGuiTextEditor<BaseWidget>::onImGuiDisplay()
 
     if (ImGui::Begin("TextEdit", nullptr, flags))
     {
+        if (teData->loading)
+            teData->loadNextChunk();
+
         if (teData->showMenu)
             teData->renderMenuContent();
 
+        if (teData->isStandalone && teData->file.size() != 0 && ! teData->loading
+            && ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_S))
+            teData->save();
+
         TextEditor& editor(teData->editor);
 
+        if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_F))
+            teData->openFindBar();
+        else if (ImGui::IsKeyChordPressed(ImGuiKey_F3))
+            editor.FindNext();
+        else if (ImGui::IsKeyChordPressed(ImGuiMod_Shift | ImGuiKey_F3))
+            editor.FindNext(true);
+
         const TextEditor::Coordinates cpos = editor.GetCursorPosition();
 
         ImGui::Text("%6d/%-6d %6d lines  | %s | %s | %s | %s", cpos.mLine + 1, cpos.mColumn + 1, editor.GetTotalLines(),
@@ -231,6 +694,9 @@ void ImGuiTextEditor<BaseWidget>::onImGuiDisplay()
                     editor.CanUndo() ? "*" : " ",
                     editor.GetLanguageDefinition().mName.c_str(), teData->file.c_str());
 
+        if (teData->showFindBar)
+            teData->renderFindBar();
+
         editor.Render("TextEditor");
     }
 
@@ -269,14 +735,8 @@ void ImGuiTextEditorStandaloneWindow::onFileSelected(const char* const filename)
     if (filename == nullptr)
         return;
 
-    std::ifstream t(filename);
-
-    if (t.good())
-    {
-        const std::string str((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
-        editor.teData->editor.SetText(str);
-        editor.teData->file = filename;
-    }
+    if (! editor.teData->openFile(filename))
+        d_stderr2("ImGuiTextEditor: failed to open '%s'", filename);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -35,6 +35,19 @@ START_NAMESPACE_DGL
 
 // TODO integrate fixes from https://github.com/BalazsJako/ImGuiColorTextEdit/pulls
 
+/**
+   A change of the text in a text editor.
+   @a removedLines lines starting at @a firstLine were replaced by @a addedLines lines,
+   whose text joined by new lines is @a text, only valid during the callback.
+ */
+struct ImGuiTextEditorChange {
+    int firstLine;
+    int removedLines;
+    int addedLines;
+    const char* text;
+    std::size_t textLength;
+};
+
 /**
    Text Editor Widget class, based on ImGuiColorTextEdit.
  */
@@ -42,6 +55,17 @@ template <class BaseWidget>
 class ImGuiTextEditor : public BaseWidget
 {
 public:
+   /**
+      Callback for text changes, as an alternative to polling hasTextChangedSinceLastTime() and getText().
+      All edits of a single operation arrive as one change: a paste, an undo step, a replace all, a whole frame of typing.
+      @a version increases with every change, it is the same as returned by getTextVersion() at that point.
+      The text editor must not be modified from the callback.
+    */
+    struct Callback {
+        virtual ~Callback() {}
+        virtual void textEditorChanged(ImGuiTextEditor* textEditor, const ImGuiTextEditorChange& change, uint64_t version) = 0;
+    };
+
    /**
       Constructor for a ImGuiTextEditorSubWidget.
     */
@@ -71,6 +95,34 @@ public:
 
 	bool hasTextChangedSinceLastTime();
 
+   /**
+      Set the callback for text changes, or null to remove it.
+    */
+    void setCallback(Callback* callback);
+
+   /**
+      Get the current text version, which increases with every change.
+    */
+    uint64_t getTextVersion() const;
+
+   /**
+      Soft wrap lines at the width of the editor instead of scrolling horizontally.
+      Also available to the user from the View menu.
+    */
+    void setWordWrap(bool wordWrap = true);
+    bool isWordWrapEnabled() const;
+
+   /**
+      Search and replace.
+      Matches of the search text are highlighted while visible, an empty text turns the search off.
+      findNext() selects the next or previous match from the cursor, wrapping around the document.
+      replaceAll() replaces all matches as a single undo step and returns how many were replaced.
+      The same operations are available to the user through a find bar, opened with Ctrl+F.
+    */
+    void setSearch(const std::string& text, bool caseSensitive = true, bool wholeWord = false);
+    bool findNext(bool backwards = false);
+    int replaceAll(const std::string& replacement);
+
 protected:
    /**
       Whether to show top-bar menu.
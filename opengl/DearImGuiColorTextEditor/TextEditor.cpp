@@ -1,8 +1,39 @@
 #include <algorithm>
+#include <bitset>
 #include <chrono>
+#include <iterator>
+#include <stdexcept>
 #include <string>
 #include <regex>
 #include <cmath>
+#include <cstring>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__) && !defined(TEXTEDITOR_NO_THREADS)
+#define TEXTEDITOR_NO_THREADS
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TEXTEDITOR_SEARCH_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTEDITOR_SEARCH_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifndef TEXTEDITOR_NO_THREADS
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
 
 #include "TextEditor.h"
 
@@ -24,2425 +55,5279 @@ bool equals(InputIt1 first1, InputIt1 last1,
 	return first1 == last1 && first2 == last2;
 }
 
-TextEditor::TextEditor()
-	: mLineSpacing(1.0f)
-	, mUndoIndex(0)
-	, mTabSize(4)
-	, mOverwrite(false)
-	, mReadOnly(false)
-	, mWithinRender(false)
-	, mScrollToCursor(false)
-	, mScrollToTop(false)
-	, mTextChanged(false)
-	, mTextChangedSinceLastTime(false)
-	, mColorizerEnabled(true)
-	, mTextStart(20.0f)
-	, mLeftMargin(10)
-	, mCursorPositionChanged(false)
-	, mColorRangeMin(0)
-	, mColorRangeMax(0)
-	, mSelectionMode(SelectionMode::Normal)
-	, mHandleKeyboardInputs(true)
-	, mHandleMouseInputs(true)
-	, mIgnoreImGuiChild(false)
-	, mShowWhitespaces(true)
-	, mCheckComments(true)
-	, mStartTime(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count())
-	, mLastClick(-1.0f)
-{
-	SetPalette(GetDarkPalette());
-	SetLanguageDefinition(LanguageDefinition::HLSL());
-	mLines.push_back(Line());
-}
+// Maximum amount of lines per leaf and children per inner node of the line storage tree.
+// Nodes are split when going over these, and merged with a sibling when dropping under a quarter of them.
+static const size_t kLinesLeafCapacity = 256;
+static const size_t kLinesNodeCapacity = 32;
 
-TextEditor::~TextEditor()
+struct TextEditor::Lines::Node
 {
-}
+	bool mLeaf;
+	size_t mCount;
+	std::vector<Line> mLines;
+	std::vector<Node*> mChildren;
+	std::vector<size_t> mCounts; // line count of each child, kept contiguous for fast lookups
 
-void TextEditor::SetLanguageDefinition(const LanguageDefinition & aLanguageDef)
-{
-	mLanguageDefinition = aLanguageDef;
-	mRegexList.clear();
+	explicit Node(bool aLeaf) : mLeaf(aLeaf), mCount(0) {}
 
-	for (auto& r : mLanguageDefinition.mTokenRegexStrings)
-		mRegexList.push_back(std::make_pair(std::regex(r.first, std::regex_constants::optimize), r.second));
+	~Node()
+	{
+		for (auto child : mChildren)
+			delete child;
+	}
 
-	Colorize();
-}
+	Node* Clone() const
+	{
+		auto node = new Node(mLeaf);
+		node->mCount = mCount;
+		node->mLines = mLines;
+		node->mCounts = mCounts;
+		node->mChildren.reserve(mChildren.size());
+		for (auto child : mChildren)
+			node->mChildren.push_back(child->Clone());
+		return node;
+	}
 
-void TextEditor::SetPalette(const Palette & aValue)
-{
-	mPaletteBase = aValue;
-}
+	size_t Width() const
+	{
+		return mLeaf ? mLines.size() : mChildren.size();
+	}
 
-std::string TextEditor::GetText(const Coordinates & aStart, const Coordinates & aEnd) const
-{
-	std::string result;
+	// Inserts aLine at aIndex within this subtree, setting aResult to its final location.
+	// Returns the new right sibling if this node had to be split.
+	Node* Insert(size_t aIndex, Line&& aLine, Line*& aResult)
+	{
+		++mCount;
 
-	auto lstart = aStart.mLine;
-	auto lend = aEnd.mLine;
-	auto istart = GetCharacterIndex(aStart);
-	auto iend = GetCharacterIndex(aEnd);
-	size_t s = 0;
+		if (mLeaf)
+		{
+			mLines.insert(mLines.begin() + aIndex, std::move(aLine));
 
-	for (size_t i = lstart; i < lend; i++)
-		s += mLines[i].size();
+			if (mLines.size() <= kLinesLeafCapacity)
+			{
+				aResult = &mLines[aIndex];
+				return nullptr;
+			}
 
-	result.reserve(s + s / 8);
+			const size_t half = mLines.size() / 2;
+			auto sibling = new Node(true);
+			sibling->mLines.reserve(kLinesLeafCapacity);
+			std::move(mLines.begin() + half, mLines.end(), std::back_inserter(sibling->mLines));
+			mLines.erase(mLines.begin() + half, mLines.end());
+			sibling->mCount = sibling->mLines.size();
+			mCount = mLines.size();
+			aResult = aIndex < half ? &mLines[aIndex] : &sibling->mLines[aIndex - half];
+			return sibling;
+		}
 
-	while (istart < iend || lstart < lend)
+		size_t i = 0;
+		for (; i + 1 < mChildren.size() && aIndex > mCounts[i]; ++i)
+			aIndex -= mCounts[i];
+
+		// when inserting at a child boundary, prefer the least filled child
+		if (i + 1 < mChildren.size() && aIndex == mCounts[i] && mChildren[i]->Width() >= mChildren[i + 1]->Width())
+		{
+			aIndex = 0;
+			++i;
+		}
+
+		auto split = mChildren[i]->Insert(aIndex, std::move(aLine), aResult);
+		mCounts[i] = mChildren[i]->mCount;
+
+		if (split == nullptr)
+			return nullptr;
+
+		mChildren.insert(mChildren.begin() + i + 1, split);
+		mCounts.insert(mCounts.begin() + i + 1, split->mCount);
+
+		if (mChildren.size() <= kLinesNodeCapacity)
+			return nullptr;
+
+		const size_t half = mChildren.size() / 2;
+		auto sibling = new Node(false);
+		sibling->mChildren.assign(mChildren.begin() + half, mChildren.end());
+		sibling->mCounts.assign(mCounts.begin() + half, mCounts.end());
+		mChildren.erase(mChildren.begin() + half, mChildren.end());
+		mCounts.erase(mCounts.begin() + half, mCounts.end());
+		for (auto count : sibling->mCounts)
+			sibling->mCount += count;
+		mCount -= sibling->mCount;
+		return sibling;
+	}
+
+	// Adds empty lines to the end of this subtree of the given height until it is full, taking them from aCount.
+	// New nodes are filled to capacity, except the last ones.
+	void Append(size_t& aCount, size_t aHeight)
 	{
-		if (lstart >= (int)mLines.size())
-			break;
+		const size_t count = aCount;
 
-		auto& line = mLines[lstart];
-		if (istart < (int)line.size())
+		if (mLeaf)
 		{
-			result += line[istart].mChar;
-			istart++;
+			const size_t added = std::min(aCount, kLinesLeafCapacity - std::min(mLines.size(), kLinesLeafCapacity));
+			mLines.resize(mLines.size() + added);
+			aCount -= added;
 		}
 		else
 		{
-			istart = 0;
-			++lstart;
-			result += '\n';
-		}
-	}
+			if (!mChildren.empty())
+			{
+				mChildren.back()->Append(aCount, aHeight - 1);
+				mCounts.back() = mChildren.back()->mCount;
+			}
 
-	return result;
-}
+			while (aCount != 0 && mChildren.size() < kLinesNodeCapacity)
+			{
+				auto child = new Node(aHeight == 1);
+				child->Append(aCount, aHeight - 1);
+				mChildren.push_back(child);
+				mCounts.push_back(child->mCount);
+			}
+		}
 
-TextEditor::Coordinates TextEditor::GetActualCursorCoordinates() const
-{
-	return SanitizeCoordinates(mState.mCursorPosition);
-}
+		mCount += count - aCount;
+	}
 
-TextEditor::Coordinates TextEditor::SanitizeCoordinates(const Coordinates & aValue) const
-{
-	auto line = aValue.mLine;
-	auto column = aValue.mColumn;
-	if (line >= (int)mLines.size())
+	// Removes lines [aFirst, aLast) from this subtree.
+	void Erase(size_t aFirst, size_t aLast)
 	{
-		if (mLines.empty())
+		mCount -= aLast - aFirst;
+
+		if (mLeaf)
 		{
-			line = 0;
-			column = 0;
+			mLines.erase(mLines.begin() + aFirst, mLines.begin() + aLast);
+			return;
 		}
-		else
+
+		size_t start = 0;
+		for (size_t i = 0; i < mChildren.size() && aFirst < aLast;)
 		{
-			line = (int)mLines.size() - 1;
-			column = GetLineMaxColumn(line);
+			const size_t end = start + mCounts[i];
+
+			if (end <= aFirst)
+			{
+				start = end;
+				++i;
+				continue;
+			}
+
+			const size_t from = aFirst - start;
+			const size_t to = std::min(aLast, end) - start;
+
+			if (from == 0 && to == mCounts[i])
+			{
+				delete mChildren[i];
+				mChildren.erase(mChildren.begin() + i);
+				mCounts.erase(mCounts.begin() + i);
+			}
+			else
+			{
+				mChildren[i]->Erase(from, to);
+				mCounts[i] = mChildren[i]->mCount;
+				start += mCounts[i];
+				++i;
+			}
+
+			aLast -= to - from;
 		}
-		return Coordinates(line, column);
+
+		Rebalance();
 	}
-	else
+
+	// Removes empty children and merges undersized neighbours.
+	void Rebalance()
 	{
-		column = mLines.empty() ? 0 : std::min(column, GetLineMaxColumn(line));
-		return Coordinates(line, column);
+		for (size_t i = 0; i < mChildren.size();)
+		{
+			auto child = mChildren[i];
+
+			if (mCounts[i] == 0)
+			{
+				delete child;
+				mChildren.erase(mChildren.begin() + i);
+				mCounts.erase(mCounts.begin() + i);
+				continue;
+			}
+
+			if (i + 1 < mChildren.size())
+			{
+				auto next = mChildren[i + 1];
+				const size_t capacity = child->mLeaf ? kLinesLeafCapacity : kLinesNodeCapacity;
+
+				if ((child->Width() < capacity / 4 || next->Width() < capacity / 4) && child->Width() + next->Width() <= capacity)
+				{
+					if (child->mLeaf)
+					{
+						std::move(next->mLines.begin(), next->mLines.end(), std::back_inserter(child->mLines));
+					}
+					else
+					{
+						child->mChildren.insert(child->mChildren.end(), next->mChildren.begin(), next->mChildren.end());
+						child->mCounts.insert(child->mCounts.end(), next->mCounts.begin(), next->mCounts.end());
+						next->mChildren.clear();
+					}
+
+					child->mCount += next->mCount;
+					mCounts[i] = child->mCount;
+					delete next;
+					mChildren.erase(mChildren.begin() + i + 1);
+					mCounts.erase(mCounts.begin() + i + 1);
+					continue;
+				}
+			}
+
+			++i;
+		}
 	}
+};
+
+TextEditor::Lines::Lines()
+	: mRoot(new Node(true))
+	, mSize(0)
+	, mCachedLines(nullptr)
+	, mCachedStart(0)
+	, mCachedCount(0)
+{
 }
 
-// https://en.wikipedia.org/wiki/UTF-8
-// We assume that the char is a standalone character (<128) or a leading byte of an UTF-8 code sequence (non-10xxxxxx code)
-static int UTF8CharLength(TextEditor::Char c)
+TextEditor::Lines::Lines(const Lines& aOther)
+	: mRoot(aOther.mRoot->Clone())
+	, mSize(aOther.mSize)
+	, mCachedLines(nullptr)
+	, mCachedStart(0)
+	, mCachedCount(0)
 {
-	if ((c & 0xFE) == 0xFC)
-		return 6;
-	if ((c & 0xFC) == 0xF8)
-		return 5;
-	if ((c & 0xF8) == 0xF0)
-		return 4;
-	else if ((c & 0xF0) == 0xE0)
-		return 3;
-	else if ((c & 0xE0) == 0xC0)
-		return 2;
-	return 1;
 }
 
-// "Borrowed" from ImGui source
-static inline int ImTextCharToUtf8(char* buf, int buf_size, unsigned int c)
+TextEditor::Lines::Lines(Lines&& aOther) noexcept
+	: mRoot(aOther.mRoot)
+	, mSize(aOther.mSize)
+	, mCachedLines(aOther.mCachedLines)
+	, mCachedStart(aOther.mCachedStart)
+	, mCachedCount(aOther.mCachedCount)
 {
-	if (c < 0x80)
-	{
-		buf[0] = (char)c;
-		return 1;
-	}
-	if (c < 0x800)
-	{
-		if (buf_size < 2) return 0;
-		buf[0] = (char)(0xc0 + (c >> 6));
-		buf[1] = (char)(0x80 + (c & 0x3f));
-		return 2;
-	}
-	if (c >= 0xdc00 && c < 0xe000)
-	{
-		return 0;
-	}
-	if (c >= 0xd800 && c < 0xdc00)
+	aOther.mRoot = new Node(true);
+	aOther.mSize = 0;
+	aOther.mCachedCount = 0;
+}
+
+TextEditor::Lines::~Lines()
+{
+	delete mRoot;
+}
+
+TextEditor::Lines& TextEditor::Lines::operator=(const Lines& aOther)
+{
+	if (this != &aOther)
 	{
-		if (buf_size < 4) return 0;
-		buf[0] = (char)(0xf0 + (c >> 18));
-		buf[1] = (char)(0x80 + ((c >> 12) & 0x3f));
-		buf[2] = (char)(0x80 + ((c >> 6) & 0x3f));
-		buf[3] = (char)(0x80 + ((c) & 0x3f));
-		return 4;
+		Node* root = aOther.mRoot->Clone();
+		delete mRoot;
+		mRoot = root;
+		mSize = aOther.mSize;
+		mCachedCount = 0;
 	}
-	//else if (c < 0x10000)
+	return *this;
+}
+
+TextEditor::Lines& TextEditor::Lines::operator=(Lines&& aOther) noexcept
+{
+	std::swap(mRoot, aOther.mRoot);
+	std::swap(mSize, aOther.mSize);
+	std::swap(mCachedLines, aOther.mCachedLines);
+	std::swap(mCachedStart, aOther.mCachedStart);
+	std::swap(mCachedCount, aOther.mCachedCount);
+	return *this;
+}
+
+TextEditor::Lines::Node* TextEditor::Lines::FindLeaf(size_t aIndex, size_t& aOffset) const
+{
+	assert(aIndex < mSize);
+
+	Node* node = mRoot;
+	aOffset = aIndex;
+
+	while (!node->mLeaf)
 	{
-		if (buf_size < 3) return 0;
-		buf[0] = (char)(0xe0 + (c >> 12));
-		buf[1] = (char)(0x80 + ((c >> 6) & 0x3f));
-		buf[2] = (char)(0x80 + ((c) & 0x3f));
-		return 3;
+		const size_t* counts = node->mCounts.data();
+		size_t i = 0;
+		for (; aOffset >= counts[i]; ++i)
+			aOffset -= counts[i];
+		node = node->mChildren[i];
 	}
+
+	return node;
 }
 
-void TextEditor::Advance(Coordinates & aCoordinates) const
+TextEditor::Line& TextEditor::Lines::Lookup(size_t aIndex) const
 {
-	if (aCoordinates.mLine < (int)mLines.size())
-	{
-		auto& line = mLines[aCoordinates.mLine];
-		auto cindex = GetCharacterIndex(aCoordinates);
+	size_t offset;
+	Node* node = FindLeaf(aIndex, offset);
 
-		if (cindex + 1 < (int)line.size())
-		{
-			auto delta = UTF8CharLength(line[cindex].mChar);
-			cindex = std::min(cindex + delta, (int)line.size() - 1);
-		}
-		else
-		{
-			++aCoordinates.mLine;
-			cindex = 0;
-		}
-		aCoordinates.mColumn = GetCharacterColumn(aCoordinates.mLine, cindex);
-	}
+	mCachedLines = node->mLines.data();
+	mCachedStart = aIndex - offset;
+	mCachedCount = node->mLines.size();
+	return mCachedLines[offset];
 }
 
-void TextEditor::DeleteRange(const Coordinates & aStart, const Coordinates & aEnd)
+TextEditor::Line* TextEditor::Lines::GetContiguous(size_t aIndex, size_t& aCount)
 {
-	assert(aEnd >= aStart);
-	assert(!mReadOnly);
+	size_t offset;
+	Node* node = FindLeaf(aIndex, offset);
 
-	//printf("D(%d.%d)-(%d.%d)\n", aStart.mLine, aStart.mColumn, aEnd.mLine, aEnd.mColumn);
+	aCount = node->mLines.size() - offset;
+	return node->mLines.data() + offset;
+}
 
-	if (aEnd == aStart)
-		return;
+TextEditor::Line& TextEditor::Lines::at(size_t aIndex)
+{
+	if (aIndex >= mSize)
+		throw std::out_of_range("TextEditor::Lines::at");
+	return (*this)[aIndex];
+}
 
-	auto start = GetCharacterIndex(aStart);
-	auto end = GetCharacterIndex(aEnd);
+const TextEditor::Line& TextEditor::Lines::at(size_t aIndex) const
+{
+	if (aIndex >= mSize)
+		throw std::out_of_range("TextEditor::Lines::at");
+	return (*this)[aIndex];
+}
 
-	if (aStart.mLine == aEnd.mLine)
-	{
-		auto& line = mLines[aStart.mLine];
-		auto n = GetLineMaxColumn(aStart.mLine);
-		if (aEnd.mColumn >= n)
-			line.erase(line.begin() + start, line.end());
-		else
-			line.erase(line.begin() + start, line.begin() + end);
-	}
-	else
-	{
-		auto& firstLine = mLines[aStart.mLine];
-		auto& lastLine = mLines[aEnd.mLine];
+void TextEditor::Lines::clear()
+{
+	delete mRoot;
+	mRoot = new Node(true);
+	mSize = 0;
+	mCachedCount = 0;
+}
 
-		firstLine.erase(firstLine.begin() + start, firstLine.end());
-		lastLine.erase(lastLine.begin(), lastLine.begin() + end);
+TextEditor::Line& TextEditor::Lines::insert(size_t aIndex, Line&& aLine)
+{
+	assert(aIndex <= mSize);
 
-		if (aStart.mLine < aEnd.mLine)
-			firstLine.insert(firstLine.end(), lastLine.begin(), lastLine.end());
+	Line* result = nullptr;
+	mCachedCount = 0;
 
-		if (aStart.mLine < aEnd.mLine)
-			RemoveLine(aStart.mLine + 1, aEnd.mLine + 1);
+	if (auto split = mRoot->Insert(aIndex, std::move(aLine), result))
+	{
+		auto root = new Node(false);
+		root->mChildren.push_back(mRoot);
+		root->mChildren.push_back(split);
+		root->mCounts.push_back(mRoot->mCount);
+		root->mCounts.push_back(split->mCount);
+		root->mCount = mRoot->mCount + split->mCount;
+		mRoot = root;
 	}
 
-	mTextChanged = mTextChangedSinceLastTime = true;
+	++mSize;
+	return *result;
 }
 
-int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValue)
+void TextEditor::Lines::append(size_t aCount)
 {
-	assert(!mReadOnly);
+	mCachedCount = 0;
+	mSize += aCount;
 
-	int cindex = GetCharacterIndex(aWhere);
-	int totalLines = 0;
-	while (*aValue != '\0')
+	size_t height = 0;
+	for (Node* node = mRoot; !node->mLeaf; node = node->mChildren.back())
+		++height;
+
+	// fill the right edge of the tree, growing a new root each time it is full
+	mRoot->Append(aCount, height);
+
+	while (aCount != 0)
 	{
-		assert(!mLines.empty());
+		auto root = new Node(false);
+		root->mChildren.push_back(mRoot);
+		root->mCounts.push_back(mRoot->mCount);
+		root->mCount = mRoot->mCount;
+		mRoot = root;
+		mRoot->Append(aCount, ++height);
+	}
+}
 
-		if (*aValue == '\r')
-		{
-			// skip
-			++aValue;
-		}
-		else if (*aValue == '\n')
+void TextEditor::Lines::erase(size_t aFirst, size_t aLast)
+{
+	assert(aFirst <= aLast && aLast <= mSize);
+
+	if (aFirst == aLast)
+		return;
+
+	mCachedCount = 0;
+	mRoot->Erase(aFirst, aLast);
+	mSize -= aLast - aFirst;
+
+	while (!mRoot->mLeaf && mRoot->mChildren.size() <= 1)
+	{
+		Node* root = mRoot->mChildren.empty() ? new Node(true) : mRoot->mChildren.front();
+		mRoot->mChildren.clear();
+		delete mRoot;
+		mRoot = root;
+	}
+}
+
+// Token regular expressions of a language compiled into a single DFA.
+// Matches the same as trying each std::regex in turn: the first pattern matching at a position wins,
+// with the match an ECMAScript backtracking engine would find. DFA states are priority ordered lists of NFA states,
+// cut after the first accepting one, so lower priority alternatives can not override an earlier match.
+// Only the regex subset needed by language definitions is supported: literals, escapes, '.', bracket expressions,
+// groups, '|', '*', '+' and '?'. For anything else no scanner is created, and std::regex is used instead.
+class TextEditor::TokenScanner
+{
+public:
+	static std::shared_ptr<const TokenScanner> Get(const LanguageDefinition::TokenRegexStrings& aPatterns)
+	{
+		if (aPatterns.empty())
+			return nullptr;
+
+#ifndef TEXTEDITOR_NO_THREADS
+		static std::mutex mutex;
+		std::lock_guard<std::mutex> lock(mutex);
+#endif
+		static std::map<LanguageDefinition::TokenRegexStrings, std::shared_ptr<const TokenScanner>> cache;
+
+		auto it = cache.find(aPatterns);
+		if (it != cache.end())
+			return it->second;
+
+		std::shared_ptr<TokenScanner> scanner(new TokenScanner());
+		if (!scanner->Compile(aPatterns))
+			scanner.reset();
+
+		cache[aPatterns] = scanner;
+		return scanner;
+	}
+
+	bool Match(const char * aBegin, const char * aEnd, const char *& aTokenEnd, PaletteIndex& aColor) const
+	{
+		int pattern = -1;
+		const char * end = nullptr;
+		int state = kStartState;
+
+		for (const char * p = aBegin; ; ++p)
 		{
-			if (cindex < (int)mLines[aWhere.mLine].size())
+			// a later match can only come from higher priority alternatives, so it always wins
+			if (mAccept[state] >= 0)
 			{
-				auto& newLine = InsertLine(aWhere.mLine + 1);
-				auto& line = mLines[aWhere.mLine];
-				newLine.insert(newLine.begin(), line.begin() + cindex, line.end());
-				line.erase(line.begin() + cindex, line.end());
-			}
-			else
-			{
-				InsertLine(aWhere.mLine + 1);
+				pattern = mAccept[state];
+				end = p;
 			}
-			++aWhere.mLine;
-			aWhere.mColumn = 0;
-			cindex = 0;
-			++totalLines;
-			++aValue;
-		}
-		else
-		{
-			auto& line = mLines[aWhere.mLine];
-			auto d = UTF8CharLength(*aValue);
-			while (d-- > 0 && *aValue != '\0')
-				line.insert(line.begin() + cindex++, Glyph(*aValue++, PaletteIndex::Default));
-			++aWhere.mColumn;
+
+			if (p == aEnd)
+				break;
+
+			state = mTransitions[state * mClassCount + mClasses[(uint8_t)*p]];
+			if (state == kDeadState)
+				break;
 		}
 
-		mTextChanged = mTextChangedSinceLastTime = true;
+		if (end == nullptr)
+			return false;
+
+		aTokenEnd = end;
+		aColor = mColors[pattern];
+		return true;
 	}
 
-	return totalLines;
-}
+private:
+	static const int kMaxStates = 4096;
+	static const int kDeadState = 0;
+	static const int kStartState = 1;
 
-void TextEditor::AddUndo(UndoRecord& aValue)
-{
-	assert(!mReadOnly);
-	//printf("AddUndo: (@%d.%d) +\'%s' [%d.%d .. %d.%d], -\'%s', [%d.%d .. %d.%d] (@%d.%d)\n",
-	//	aValue.mBefore.mCursorPosition.mLine, aValue.mBefore.mCursorPosition.mColumn,
-	//	aValue.mAdded.c_str(), aValue.mAddedStart.mLine, aValue.mAddedStart.mColumn, aValue.mAddedEnd.mLine, aValue.mAddedEnd.mColumn,
-	//	aValue.mRemoved.c_str(), aValue.mRemovedStart.mLine, aValue.mRemovedStart.mColumn, aValue.mRemovedEnd.mLine, aValue.mRemovedEnd.mColumn,
-	//	aValue.mAfter.mCursorPosition.mLine, aValue.mAfter.mCursorPosition.mColumn
-	//	);
+	typedef std::bitset<256> CharSet;
 
-	mUndoBuffer.resize((size_t)(mUndoIndex + 1));
-	mUndoBuffer.back() = aValue;
-	++mUndoIndex;
-}
+	// Thompson NFA, states either match a set of characters, split in two, or accept a pattern
+	struct NfaState
+	{
+		enum Type { Chars, Split, Accept } mType;
+		CharSet mChars;
+		int mOut, mOut2;
+	};
 
-TextEditor::Coordinates TextEditor::ScreenPosToCoordinates(const ImVec2& aPosition) const
-{
-	ImVec2 origin = ImGui::GetCursorScreenPos();
-	ImVec2 local(aPosition.x - origin.x, aPosition.y - origin.y);
+	struct Fragment
+	{
+		int mStart, mEnd;
+	};
+
+	class Parser
+	{
+	public:
+		Parser(std::vector<NfaState>& aStates, const std::string& aPattern)
+			: mStates(aStates), mPos(aPattern.c_str()), mEnd(aPattern.c_str() + aPattern.size()), mError(false)
+		{
+		}
 
-	int lineNo = std::max(0, (int)floor(local.y / mCharAdvance.y));
+		bool Parse(Fragment& aFragment)
+		{
+			aFragment = Alternation();
+			return !mError && mPos == mEnd;
+		}
 
-	int columnCoord = 0;
+	private:
+		int AddState(NfaState::Type aType, int aOut = -1, int aOut2 = -1)
+		{
+			NfaState state;
+			state.mType = aType;
+			state.mOut = aOut;
+			state.mOut2 = aOut2;
+			mStates.push_back(state);
+			return (int)mStates.size() - 1;
+		}
 
-	if (lineNo >= 0 && lineNo < (int)mLines.size())
-	{
-		auto& line = mLines.at(lineNo);
+		// fragment ends are always splits with both outputs pointing to the same state, so they can be patched
+		int AddEnd()
+		{
+			return AddState(NfaState::Split);
+		}
 
-		int columnIndex = 0;
-		float columnX = 0.0f;
+		void Patch(int aEnd, int aTarget)
+		{
+			mStates[aEnd].mOut = mStates[aEnd].mOut2 = aTarget;
+		}
 
-		while ((size_t)columnIndex < line.size())
+		Fragment Empty()
 		{
-			float columnWidth = 0.0f;
+			const int end = AddEnd();
+			return { end, end };
+		}
 
-			if (line[columnIndex].mChar == '\t')
+		Fragment Alternation()
+		{
+			Fragment result = Concatenation();
+			while (!mError && mPos != mEnd && *mPos == '|')
 			{
-				float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ").x;
-				float oldX = columnX;
-				float newColumnX = (1.0f + std::floor((1.0f + columnX) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-				columnWidth = newColumnX - oldX;
-				if (mTextStart + columnX + columnWidth * 0.5f > local.x)
-					break;
-				columnX = newColumnX;
-				columnCoord = (columnCoord / mTabSize) * mTabSize + mTabSize;
-				columnIndex++;
+				++mPos;
+				const Fragment other = Concatenation();
+				const int end = AddEnd();
+				Patch(result.mEnd, end);
+				Patch(other.mEnd, end);
+				result = { AddState(NfaState::Split, result.mStart, other.mStart), end };
 			}
-			else
+			return result;
+		}
+
+		Fragment Concatenation()
+		{
+			Fragment result = Empty();
+			while (!mError && mPos != mEnd && *mPos != '|' && *mPos != ')')
 			{
-				char buf[7];
-				auto d = UTF8CharLength(line[columnIndex].mChar);
-				int i = 0;
-				while (i < 6 && d-- > 0)
-					buf[i++] = line[columnIndex++].mChar;
-				buf[i] = '\0';
-				columnWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf).x;
-				if (mTextStart + columnX + columnWidth * 0.5f > local.x)
-					break;
-				columnX += columnWidth;
-				columnCoord++;
+				const Fragment next = Repetition();
+				Patch(result.mEnd, next.mStart);
+				result.mEnd = next.mEnd;
 			}
+			return result;
 		}
-	}
-
-	return SanitizeCoordinates(Coordinates(lineNo, columnCoord));
-}
 
-TextEditor::Coordinates TextEditor::FindWordStart(const Coordinates & aFrom) const
-{
-	Coordinates at = aFrom;
-	if (at.mLine >= (int)mLines.size())
-		return at;
+		Fragment Repetition()
+		{
+			Fragment atom = Atom();
+			while (!mError && mPos != mEnd && (*mPos == '*' || *mPos == '+' || *mPos == '?'))
+			{
+				const char op = *mPos++;
 
-	auto& line = mLines[at.mLine];
-	auto cindex = GetCharacterIndex(at);
+				// lazy quantifiers do not give the longest match
+				if (mPos != mEnd && *mPos == '?')
+					mError = true;
 
-	if (cindex >= (int)line.size())
-		return at;
+				const int end = AddEnd();
+				const int split = AddState(NfaState::Split, atom.mStart, end);
 
-	while (cindex > 0 && isspace(line[cindex].mChar))
-		--cindex;
+				if (op == '*')
+				{
+					Patch(atom.mEnd, split);
+					atom = { split, end };
+				}
+				else if (op == '+')
+				{
+					Patch(atom.mEnd, split);
+					atom.mEnd = end;
+				}
+				else
+				{
+					Patch(atom.mEnd, end);
+					atom = { split, end };
+				}
+			}
+			return atom;
+		}
 
-	auto cstart = (PaletteIndex)line[cindex].mColorIndex;
-	while (cindex > 0)
-	{
-		auto c = line[cindex].mChar;
-		if ((c & 0xC0) != 0x80)	// not UTF code sequence 10xxxxxx
+		Fragment Atom()
 		{
-			if (c <= 32 && isspace(c))
+			CharSet chars;
+			const char c = *mPos++;
+
+			switch (c)
 			{
-				cindex++;
-				break;
+			case '(':
+			{
+				if (mEnd - mPos >= 2 && mPos[0] == '?' && mPos[1] == ':')
+					mPos += 2;
+				const Fragment group = Alternation();
+				if (mPos == mEnd || *mPos != ')')
+					mError = true;
+				else
+					++mPos;
+				return group;
 			}
-			if (cstart != (PaletteIndex)line[size_t(cindex - 1)].mColorIndex)
+			case '[':
+				BracketExpression(chars);
+				break;
+			case '.':
+				chars.set();
+				chars.reset('\n');
+				chars.reset('\r');
 				break;
+			case '\\':
+				Escape(chars, false);
+				break;
+			case ')': case '*': case '+': case '?': case '{': case '}': case '^': case '$':
+				mError = true;
+				return Empty();
+			default:
+				chars.set((uint8_t)c);
+				break;
+			}
+
+			const int end = AddEnd();
+			const int state = AddState(NfaState::Chars, end);
+			mStates[state].mChars = chars;
+			return { state, end };
 		}
-		--cindex;
-	}
-	return Coordinates(at.mLine, GetCharacterColumn(at.mLine, cindex));
-}
 
-TextEditor::Coordinates TextEditor::FindWordEnd(const Coordinates & aFrom) const
-{
-	Coordinates at = aFrom;
-	if (at.mLine >= (int)mLines.size())
-		return at;
+		void BracketExpression(CharSet& aChars)
+		{
+			const bool negate = mPos != mEnd && *mPos == '^';
+			if (negate)
+				++mPos;
 
-	auto& line = mLines[at.mLine];
-	auto cindex = GetCharacterIndex(at);
+			while (!mError && mPos != mEnd && *mPos != ']')
+			{
+				CharSet item;
+				int low = ClassAtom(item);
 
-	if (cindex >= (int)line.size())
-		return at;
+				if (low >= 0 && mEnd - mPos >= 2 && mPos[0] == '-' && mPos[1] != ']')
+				{
+					++mPos;
+					const int high = ClassAtom(item);
+					if (high < low)
+						mError = true;
+					for (int i = low; i <= high; ++i)
+						item.set(i);
+				}
+				aChars |= item;
+			}
 
-	bool prevspace = (bool)isspace(line[cindex].mChar);
-	auto cstart = (PaletteIndex)line[cindex].mColorIndex;
-	while (cindex < (int)line.size())
-	{
-		auto c = line[cindex].mChar;
-		auto d = UTF8CharLength(c);
-		if (cstart != (PaletteIndex)line[cindex].mColorIndex)
-			break;
+			if (mPos == mEnd)
+				mError = true;
+			else
+				++mPos;
 
-		if (prevspace != !!isspace(c))
+			if (negate)
+				aChars.flip();
+		}
+
+		// returns the character for single character atoms, which can start or end a range
+		int ClassAtom(CharSet& aChars)
 		{
-			if (isspace(c))
-				while (cindex < (int)line.size() && isspace(line[cindex].mChar))
-					++cindex;
-			break;
+			const char c = *mPos++;
+			if (c != '\\')
+			{
+				aChars.set((uint8_t)c);
+				return (uint8_t)c;
+			}
+			return Escape(aChars, true);
 		}
-		cindex += d;
-	}
-	return Coordinates(aFrom.mLine, GetCharacterColumn(aFrom.mLine, cindex));
-}
 
-TextEditor::Coordinates TextEditor::FindNextWord(const Coordinates & aFrom) const
-{
-	Coordinates at = aFrom;
-	if (at.mLine >= (int)mLines.size())
-		return at;
+		int Escape(CharSet& aChars, bool aInClass)
+		{
+			if (mPos == mEnd)
+			{
+				mError = true;
+				return -1;
+			}
 
-	// skip to the next non-word character
-	auto cindex = GetCharacterIndex(aFrom);
-	bool isword = false;
-	bool skip = false;
-	if (cindex < (int)mLines[at.mLine].size())
+			int c = (uint8_t)*mPos++;
+			switch (c)
+			{
+			case 'd': case 'D': case 'w': case 'W': case 's': case 'S':
+			{
+				CharSet set;
+				for (int i = 0; i < 256; ++i)
+				{
+					if ((c == 'd' || c == 'D') && i >= '0' && i <= '9')
+						set.set(i);
+					else if ((c == 'w' || c == 'W') && i < 128 && (isalnum(i) || i == '_'))
+						set.set(i);
+					else if ((c == 's' || c == 'S') && (i == ' ' || (i >= '\t' && i <= '\r')))
+						set.set(i);
+				}
+				if (isupper(c))
+					set.flip();
+				aChars |= set;
+				return -1;
+			}
+			case 't': c = '\t'; break;
+			case 'n': c = '\n'; break;
+			case 'r': c = '\r'; break;
+			case 'f': c = '\f'; break;
+			case 'v': c = '\v'; break;
+			case 'b':
+				// word boundary outside of brackets
+				if (!aInClass)
+				{
+					mError = true;
+					return -1;
+				}
+				c = '\b';
+				break;
+			default:
+				// back references and other letter escapes are not supported
+				if (isalnum(c))
+				{
+					mError = true;
+					return -1;
+				}
+				break;
+			}
+
+			aChars.set(c);
+			return c;
+		}
+
+		std::vector<NfaState>& mStates;
+		const char * mPos;
+		const char * mEnd;
+		bool mError;
+	};
+
+	// appends the character and accepting states reachable from aState, in priority order
+	static void Closure(const std::vector<NfaState>& aStates, int aState, std::vector<bool>& aVisited, std::vector<int>& aResult)
 	{
-		auto& line = mLines[at.mLine];
-		isword = isalnum(line[cindex].mChar);
-		skip = isword;
+		if (aState < 0 || aVisited[aState])
+			return;
+
+		aVisited[aState] = true;
+		if (aStates[aState].mType == NfaState::Split)
+		{
+			Closure(aStates, aStates[aState].mOut, aVisited, aResult);
+			Closure(aStates, aStates[aState].mOut2, aVisited, aResult);
+		}
+		else
+		{
+			aResult.push_back(aState);
+		}
 	}
 
-	while (!isword || skip)
+	// lower priority states can not win anymore once an earlier one matched
+	static void CutAfterAccept(const std::vector<NfaState>& aStates, std::vector<int>& aList)
 	{
-		if (at.mLine >= mLines.size())
+		for (size_t i = 0; i < aList.size(); ++i)
 		{
-			auto l = std::max(0, (int) mLines.size() - 1);
-			return Coordinates(l, GetLineMaxColumn(l));
+			if (aStates[aList[i]].mType == NfaState::Accept)
+			{
+				aList.resize(i + 1);
+				break;
+			}
 		}
+	}
 
-		auto& line = mLines[at.mLine];
-		if (cindex < (int)line.size())
+	bool Compile(const LanguageDefinition::TokenRegexStrings& aPatterns)
+	{
+		std::vector<NfaState> states;
+		std::vector<int> starts;
+
+		for (auto& pattern : aPatterns)
 		{
-			isword = isalnum(line[cindex].mChar);
+			Fragment fragment;
+			Parser parser(states, pattern.first);
+			if (!parser.Parse(fragment))
+				return false;
 
-			if (isword && !skip)
-				return Coordinates(at.mLine, GetCharacterColumn(at.mLine, cindex));
+			NfaState accept;
+			accept.mType = NfaState::Accept;
+			accept.mOut = (int)mColors.size();
+			accept.mOut2 = -1;
+			states.push_back(accept);
+			states[fragment.mEnd].mOut = states[fragment.mEnd].mOut2 = (int)states.size() - 1;
 
-			if (!isword)
-				skip = false;
+			starts.push_back(fragment.mStart);
+			mColors.push_back(pattern.second);
+		}
 
-			cindex++;
+		// bytes that no pattern tells apart share the same column of the transition table
+		std::map<std::vector<bool>, uint8_t> classes;
+		std::vector<int> representatives;
+		for (int i = 0; i < 256; ++i)
+		{
+			std::vector<bool> signature;
+			for (auto& state : states)
+				if (state.mType == NfaState::Chars)
+					signature.push_back(state.mChars[i]);
+
+			auto it = classes.find(signature);
+			if (it == classes.end())
+			{
+				it = classes.insert(std::make_pair(signature, (uint8_t)classes.size())).first;
+				representatives.push_back(i);
+			}
+			mClasses[i] = it->second;
 		}
-		else
+		mClassCount = (int)classes.size();
+
+		// subset construction, state 0 being the dead state
+		std::map<std::vector<int>, int> dfaStates;
+		std::vector<std::vector<int>> pending;
+		std::vector<bool> visited(states.size());
+
+		std::vector<int> start;
+		for (int s : starts)
+			Closure(states, s, visited, start);
+		CutAfterAccept(states, start);
+
+		dfaStates[std::vector<int>()] = kDeadState;
+		dfaStates[start] = kStartState;
+		pending.push_back(std::vector<int>());
+		pending.push_back(start);
+		mTransitions.assign(2 * mClassCount, kDeadState);
+		mAccept.assign(2, -1);
+
+		for (size_t current = 0; current < pending.size(); ++current)
 		{
-			cindex = 0;
-			++at.mLine;
-			skip = false;
-			isword = false;
+			const std::vector<int> list = pending[current];
+
+			if (!list.empty() && states[list.back()].mType == NfaState::Accept)
+				mAccept[current] = (int16_t)states[list.back()].mOut;
+
+			for (int i : representatives)
+			{
+				std::vector<int> next;
+				std::fill(visited.begin(), visited.end(), false);
+				for (int s : list)
+					if (states[s].mType == NfaState::Chars && states[s].mChars[i])
+						Closure(states, states[s].mOut, visited, next);
+				CutAfterAccept(states, next);
+
+				auto it = dfaStates.find(next);
+				if (it == dfaStates.end())
+				{
+					if ((int)pending.size() >= kMaxStates)
+						return false;
+
+					it = dfaStates.insert(std::make_pair(next, (int)pending.size())).first;
+					pending.push_back(next);
+					mTransitions.resize(pending.size() * mClassCount, kDeadState);
+					mAccept.push_back(-1);
+				}
+				mTransitions[current * mClassCount + mClasses[i]] = (uint16_t)it->second;
+			}
 		}
+
+		// an empty match would never advance the colorizer
+		return mAccept[kStartState] < 0;
 	}
 
-	return at;
-}
+	uint8_t mClasses[256];
+	int mClassCount;
+	std::vector<uint16_t> mTransitions;
+	std::vector<int16_t> mAccept;      // pattern matched when reaching each state, or -1
+	std::vector<PaletteIndex> mColors;
+};
 
-int TextEditor::GetCharacterIndex(const Coordinates& aCoordinates) const
+static_assert((unsigned)TextEditor::PaletteIndex::Max <= TextEditor::Line::kColorMask + 1u, "palette index does not fit in the glyph info bits");
+
+// Keywords and identifiers of a language, looked up straight from the token characters without building a string.
+// Built once per language as a perfect hash table (hash and displace): the words are split into small buckets by hash,
+// and each bucket gets a displacement that moves all of its words into free slots, so any word is found with a single probe.
+// If no displacement fits some bucket, the table falls back to plain open addressing with linear probing.
+class TextEditor::WordTable
 {
-	if (aCoordinates.mLine >= mLines.size())
-		return -1;
-	auto& line = mLines[aCoordinates.mLine];
-	int c = 0;
-	int i = 0;
-	for (; i < line.size() && c < aCoordinates.mColumn;)
+public:
+	explicit WordTable(const LanguageDefinition& aLanguage)
+		: mFold(!aLanguage.mCaseSensitive)
 	{
-		if (line[i].mChar == '\t')
-			c = (c / mTabSize) * mTabSize + mTabSize;
-		else
-			++c;
-		i += UTF8CharLength(line[i].mChar);
+		// a word can be in several lists, keywords win over identifiers, which win over preprocessor identifiers
+		std::unordered_map<std::string, Slot> words;
+		for (auto& k : aLanguage.mKeywords)
+			words[k].mColor = PaletteIndex::Keyword;
+		for (auto& k : aLanguage.mIdentifiers)
+		{
+			Slot& slot(words[k.first]);
+			if (slot.mColor == PaletteIndex::Max)
+				slot.mColor = PaletteIndex::KnownIdentifier;
+		}
+		for (auto& k : aLanguage.mPreprocIdentifiers)
+		{
+			Slot& slot(words[k.first]);
+			if (slot.mColor == PaletteIndex::Max)
+				slot.mColor = PaletteIndex::PreprocIdentifier;
+			slot.mPreprocColor = PaletteIndex::PreprocIdentifier;
+		}
+
+		std::vector<Slot> slots;
+		slots.reserve(words.size());
+		for (auto& w : words)
+		{
+			// tokens are never empty, and words can only match tokens that are the same once case folded
+			if (w.first.empty())
+				continue;
+
+			Slot slot(w.second);
+			slot.mHash = Hash(w.first.data(), w.first.size(), false);
+			slot.mOffset = (uint32_t)mChars.size();
+			slot.mLength = (uint32_t)w.first.size();
+			mChars += w.first;
+			slots.push_back(slot);
+		}
+
+		if (!BuildPerfect(slots))
+			BuildProbing(slots);
 	}
-	return i;
-}
 
-int TextEditor::GetCharacterColumn(int aLine, int aIndex) const
-{
-	if (aLine >= mLines.size())
-		return 0;
-	auto& line = mLines[aLine];
-	int col = 0;
-	int i = 0;
-	while (i < aIndex && i < (int)line.size())
+	// Returns the color of a word, or PaletteIndex::Max if it is not in the table.
+	PaletteIndex Find(const char * aBegin, const char * aEnd, bool aPreprocessor) const
 	{
-		auto c = line[i].mChar;
-		i += UTF8CharLength(c);
-		if (c == '\t')
-			col = (col / mTabSize) * mTabSize + mTabSize;
-		else
-			col++;
+		if (mSlots.empty())
+			return PaletteIndex::Max;
+
+		const size_t length = aEnd - aBegin;
+		const uint64_t hash = Hash(aBegin, length, mFold);
+		const size_t mask = mSlots.size() - 1;
+
+		if (!mDisplacements.empty())
+		{
+			const Slot& slot(mSlots[Place(hash, mDisplacements[hash & (mDisplacements.size() - 1)]) & mask]);
+			return Matches(slot, hash, aBegin, length) ? (aPreprocessor ? slot.mPreprocColor : slot.mColor) : PaletteIndex::Max;
+		}
+
+		for (size_t i = Place(hash, 0) & mask;; i = (i + 1) & mask)
+		{
+			const Slot& slot(mSlots[i]);
+			if (slot.mLength == 0)
+				return PaletteIndex::Max;
+			if (Matches(slot, hash, aBegin, length))
+				return aPreprocessor ? slot.mPreprocColor : slot.mColor;
+		}
 	}
-	return col;
-}
 
-int TextEditor::GetLineCharacterCount(int aLine) const
-{
-	if (aLine >= mLines.size())
-		return 0;
-	auto& line = mLines[aLine];
-	int c = 0;
-	for (unsigned i = 0; i < line.size(); c++)
-		i += UTF8CharLength(line[i].mChar);
-	return c;
-}
+private:
+	struct Slot
+	{
+		uint64_t mHash = 0;
+		uint32_t mOffset = 0;
+		uint32_t mLength = 0;  // 0 for empty slots, as words are never empty
+		PaletteIndex mColor = PaletteIndex::Max;
+		PaletteIndex mPreprocColor = PaletteIndex::Max;
+	};
+
+	static char Fold(const char aChar)
+	{
+		return aChar >= 'a' && aChar <= 'z' ? aChar - 'a' + 'A' : aChar;
+	}
 
-int TextEditor::GetLineMaxColumn(int aLine) const
-{
-	if (aLine >= mLines.size())
-		return 0;
-	auto& line = mLines[aLine];
-	int col = 0;
-	for (unsigned i = 0; i < line.size(); )
+	static uint64_t Hash(const char * aText, const size_t aLength, const bool aFold)
 	{
-		auto c = line[i].mChar;
-		if (c == '\t')
-			col = (col / mTabSize) * mTabSize + mTabSize;
+		uint64_t hash = 14695981039346656037ull;
+		if (aFold)
+		{
+			for (size_t i = 0; i < aLength; ++i)
+				hash = (hash ^ (uint8_t)Fold(aText[i])) * 1099511628211ull;
+		}
 		else
-			col++;
-		i += UTF8CharLength(c);
+		{
+			for (size_t i = 0; i < aLength; ++i)
+				hash = (hash ^ (uint8_t)aText[i]) * 1099511628211ull;
+		}
+		return hash;
 	}
-	return col;
-}
-
-bool TextEditor::IsOnWordBoundary(const Coordinates & aAt) const
-{
-	if (aAt.mLine >= (int)mLines.size() || aAt.mColumn == 0)
-		return true;
 
-	auto& line = mLines[aAt.mLine];
-	auto cindex = GetCharacterIndex(aAt);
-	if (cindex >= (int)line.size())
-		return true;
+	static size_t Place(const uint64_t aHash, const uint32_t aDisplacement)
+	{
+		uint64_t x = aHash + (aDisplacement + 1) * 0x9e3779b97f4a7c15ull;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+		return (size_t)(x ^ (x >> 31));
+	}
 
-	if (mColorizerEnabled)
-		return line[cindex].mColorIndex != line[size_t(cindex - 1)].mColorIndex;
+	bool Matches(const Slot& aSlot, const uint64_t aHash, const char * aText, const size_t aLength) const
+	{
+		if (aSlot.mHash != aHash || aSlot.mLength != aLength)
+			return false;
 
-	return isspace(line[cindex].mChar) != isspace(line[cindex - 1].mChar);
-}
+		const char * word = mChars.data() + aSlot.mOffset;
+		if (!mFold)
+			return memcmp(aText, word, aLength) == 0;
 
-void TextEditor::RemoveLine(int aStart, int aEnd)
-{
-	assert(!mReadOnly);
-	assert(aEnd >= aStart);
-	assert(mLines.size() > (size_t)(aEnd - aStart));
+		for (size_t i = 0; i < aLength; ++i)
+			if (Fold(aText[i]) != word[i])
+				return false;
+		return true;
+	}
 
-	ErrorMarkers etmp;
-	for (auto& i : mErrorMarkers)
+	static size_t PowerOfTwo(const size_t aMinimum)
 	{
-		ErrorMarkers::value_type e(i.first >= aStart ? i.first - 1 : i.first, i.second);
-		if (e.first >= aStart && e.first <= aEnd)
-			continue;
-		etmp.insert(e);
+		size_t size = 1;
+		while (size < aMinimum)
+			size *= 2;
+		return size;
 	}
-	mErrorMarkers = std::move(etmp);
 
-	Breakpoints btmp;
-	for (auto i : mBreakpoints)
+	bool BuildPerfect(const std::vector<Slot>& aSlots)
 	{
-		if (i >= aStart && i <= aEnd)
-			continue;
-		btmp.insert(i >= aStart ? i - 1 : i);
+		static const uint32_t kMaxDisplacement = 0xffff;
+
+		mSlots.assign(PowerOfTwo(aSlots.size() + aSlots.size() / 4 + 1), Slot());
+		mDisplacements.assign(PowerOfTwo(aSlots.size() / 4 + 1), 0);
+
+		std::vector<std::vector<const Slot*>> buckets(mDisplacements.size());
+		for (auto& slot : aSlots)
+			buckets[slot.mHash & (buckets.size() - 1)].push_back(&slot);
+
+		// largest buckets first, while there are still many free slots to move them into
+		std::vector<size_t> order(buckets.size());
+		for (size_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&buckets](size_t a, size_t b) { return buckets[a].size() > buckets[b].size(); });
+
+		const size_t mask = mSlots.size() - 1;
+		std::vector<size_t> placed;
+
+		for (size_t b : order)
+		{
+			const std::vector<const Slot*>& bucket(buckets[b]);
+			if (bucket.empty())
+				break;
+
+			uint32_t displacement = 0;
+			for (; displacement <= kMaxDisplacement; ++displacement)
+			{
+				placed.clear();
+				for (auto slot : bucket)
+				{
+					const size_t index = Place(slot->mHash, displacement) & mask;
+					if (mSlots[index].mLength != 0 || std::find(placed.begin(), placed.end(), index) != placed.end())
+						break;
+					placed.push_back(index);
+				}
+				if (placed.size() == bucket.size())
+					break;
+			}
+
+			if (displacement > kMaxDisplacement)
+			{
+				mDisplacements.clear();
+				return false;
+			}
+
+			mDisplacements[b] = (uint16_t)displacement;
+			for (size_t i = 0; i < bucket.size(); ++i)
+				mSlots[placed[i]] = *bucket[i];
+		}
+
+		return true;
 	}
-	mBreakpoints = std::move(btmp);
 
-	mLines.erase(mLines.begin() + aStart, mLines.begin() + aEnd);
-	assert(!mLines.empty());
+	void BuildProbing(const std::vector<Slot>& aSlots)
+	{
+		mSlots.assign(PowerOfTwo(aSlots.size() * 2 + 1), Slot());
 
-	mTextChanged = mTextChangedSinceLastTime = true;
-}
+		const size_t mask = mSlots.size() - 1;
+		for (auto& slot : aSlots)
+		{
+			size_t i = Place(slot.mHash, 0) & mask;
+			while (mSlots[i].mLength != 0)
+				i = (i + 1) & mask;
+			mSlots[i] = slot;
+		}
+	}
 
-void TextEditor::RemoveLine(int aIndex)
+	bool mFold;                             // case insensitive languages match tokens in upper case
+	std::string mChars;                     // all words, one after another
+	std::vector<Slot> mSlots;
+	std::vector<uint16_t> mDisplacements;   // one per bucket, empty when using linear probing
+};
+
+// Language definitions together with their compiled token matchers.
+// The built-in definitions are added once and never modified or destroyed afterwards,
+// so editors find them by address and share them instead of copying and compiling their own.
+class TextEditor::LanguageCache
 {
-	assert(!mReadOnly);
-	assert(mLines.size() > 1);
+public:
+	struct Entry
+	{
+		std::shared_ptr<const LanguageDefinition> mDefinition;
+		std::shared_ptr<const TokenScanner> mTokenScanner;
+		std::shared_ptr<const RegexList> mRegexList;
+		std::shared_ptr<const WordTable> mWordTable;
+	};
 
-	ErrorMarkers etmp;
-	for (auto& i : mErrorMarkers)
+	static const LanguageDefinition& Add(LanguageDefinition&& aLanguageDef)
 	{
-		ErrorMarkers::value_type e(i.first > aIndex ? i.first - 1 : i.first, i.second);
-		if (e.first - 1 == aIndex)
-			continue;
-		etmp.insert(e);
+		const Entry entry(Compile(std::make_shared<const LanguageDefinition>(std::move(aLanguageDef))));
+
+		Entries& entries(GetEntries());
+#ifndef TEXTEDITOR_NO_THREADS
+		std::lock_guard<std::mutex> lock(entries.mMutex);
+#endif
+		entries.mMap[entry.mDefinition.get()] = entry;
+		return *entry.mDefinition;
 	}
-	mErrorMarkers = std::move(etmp);
 
-	Breakpoints btmp;
-	for (auto i : mBreakpoints)
+	static bool Find(const LanguageDefinition& aLanguageDef, Entry& aEntry)
 	{
-		if (i == aIndex)
-			continue;
-		btmp.insert(i >= aIndex ? i - 1 : i);
+		Entries& entries(GetEntries());
+#ifndef TEXTEDITOR_NO_THREADS
+		std::lock_guard<std::mutex> lock(entries.mMutex);
+#endif
+		auto it = entries.mMap.find(&aLanguageDef);
+		if (it == entries.mMap.end())
+			return false;
+
+		aEntry = it->second;
+		return true;
 	}
-	mBreakpoints = std::move(btmp);
 
-	mLines.erase(mLines.begin() + aIndex);
-	assert(!mLines.empty());
+	static Entry Compile(std::shared_ptr<const LanguageDefinition>&& aLanguageDef)
+	{
+		Entry entry;
+		entry.mTokenScanner = TokenScanner::Get(aLanguageDef->mTokenRegexStrings);
 
-	mTextChanged = mTextChangedSinceLastTime = true;
-}
+		std::shared_ptr<RegexList> regexList = std::make_shared<RegexList>();
 
-TextEditor::Line& TextEditor::InsertLine(int aIndex)
-{
-	assert(!mReadOnly);
+		if (entry.mTokenScanner == nullptr)
+		{
+			for (auto& r : aLanguageDef->mTokenRegexStrings)
+				regexList->push_back(std::make_pair(std::regex(r.first, std::regex_constants::optimize), r.second));
+		}
 
-	auto& result = *mLines.insert(mLines.begin() + aIndex, Line());
+		entry.mWordTable = std::make_shared<const WordTable>(*aLanguageDef);
+		entry.mDefinition = std::move(aLanguageDef);
+		entry.mRegexList = regexList;
+		return entry;
+	}
 
-	ErrorMarkers etmp;
-	for (auto& i : mErrorMarkers)
-		etmp.insert(ErrorMarkers::value_type(i.first >= aIndex ? i.first + 1 : i.first, i.second));
-	mErrorMarkers = std::move(etmp);
+private:
+	struct Entries
+	{
+#ifndef TEXTEDITOR_NO_THREADS
+		std::mutex mMutex;
+#endif
+		std::map<const LanguageDefinition*, Entry> mMap;
+	};
 
-	Breakpoints btmp;
-	for (auto i : mBreakpoints)
-		btmp.insert(i >= aIndex ? i + 1 : i);
-	mBreakpoints = std::move(btmp);
+	static Entries& GetEntries()
+	{
+		static Entries entries;
+		return entries;
+	}
+};
 
-	return result;
-}
+// Lines tokenized by the colorizer thread in between checks for a newer job.
+static const int kColorizeChunkLines = 256;
 
-std::string TextEditor::GetWordUnderCursor() const
+// Lines scanned for comments past a job whose last line ended in another state than before, doubled with each further job.
+static const int kColorizeFollowLines = 4096;
+
+// Copy of the text and colorizer state of a range of lines, so it can be colorized without touching the editor.
+struct TextEditor::ColorizeSnapshot
 {
-	auto c = GetCursorPosition();
-	return GetWordAt(c);
-}
+	int mFirstLine = 0;
+	std::string mChars;
+	std::vector<uint8_t> mInfo;       // packed palette index and flags of each character
+	std::vector<size_t> mLineStarts;  // offset of each line in mChars, plus one for the end of the last line
+	std::vector<uint8_t> mStates;     // comment scanner state at the start of each line, plus one for the end of the last line
+};
+
+// The lines to colorize in the background, tagged with the text version they were taken from.
+// The comments of all lines are scanned, starting from the state of the first line, only the lines from mColorFrom
+// to mColorTo are tokenized. Edits made meanwhile are tracked as in TextEditor::mChangeFirst to find where results go.
+struct TextEditor::ColorizeJob
+{
+	uint64_t mSerial = 0;
+	uint64_t mVersion = 0;
+	std::shared_ptr<const LanguageDefinition> mLanguage;
+	std::shared_ptr<const TokenScanner> mTokenScanner;
+	std::shared_ptr<const RegexList> mRegexList;
+	std::shared_ptr<const WordTable> mWordTable;
+	ColorizeSnapshot mSnapshot;
+	int mColorFrom = 0, mColorTo = 0;      // lines to tokenize, all others only get their comment flags updated
+	int mVisibleFrom = 0, mVisibleTo = 0;  // lines to tokenize first
+	int mChangeFirst = -1, mChangeOldEnd = 0, mChangeNewEnd = 0;  // lines edited since the snapshot was taken
+	std::vector<uint8_t> mReady;           // lines of the snapshot with a final result, 2 once applied, guarded by the worker mutex
+	int mScannedTo = 0;                    // end of the lines scanned for comments, guarded by the worker mutex
+	bool mDone = false;
+
+	// where a line of the snapshot is now, -1 if it was edited since
+	int FindLine(int aLine) const
+	{
+		if (mChangeFirst < 0 || aLine < mChangeFirst)
+			return aLine;
+		return aLine < mChangeOldEnd ? -1 : aLine + mChangeNewEnd - mChangeOldEnd;
+	}
+};
 
-std::string TextEditor::GetWordAt(const Coordinates & aCoords) const
+#ifndef TEXTEDITOR_NO_THREADS
+class TextEditor::ColorizeWorker
 {
-	auto start = FindWordStart(aCoords);
-	auto end = FindWordEnd(aCoords);
+public:
+	ColorizeWorker()
+		: mSerial(0)
+		, mQuit(false)
+		, mThread(&ColorizeWorker::Run, this)
+	{
+	}
 
-	std::string r;
+	~ColorizeWorker()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mQuit = true;
+			++mSerial;
+		}
+		mCondition.notify_one();
+		mThread.join();
+	}
 
-	auto istart = GetCharacterIndex(start);
-	auto iend = GetCharacterIndex(end);
+	// replaces any job still pending or running
+	void Submit(const std::shared_ptr<ColorizeJob>& aJob)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			aJob->mSerial = ++mSerial;
+			mPending = aJob;
+		}
+		mCondition.notify_one();
+	}
 
-	for (auto it = istart; it < iend; ++it)
-		r.push_back(mLines[aCoords.mLine][it].mChar);
+	// latest submitted job, only used by the editor, until its results are applied
+	std::shared_ptr<ColorizeJob> mActive;
 
-	return r;
-}
+	std::mutex mMutex;
 
-ImU32 TextEditor::GetGlyphColor(const Glyph & aGlyph) const
-{
-	if (!mColorizerEnabled)
-		return mPalette[(int)PaletteIndex::Default];
-	if (aGlyph.mComment)
-		return mPalette[(int)PaletteIndex::Comment];
-	if (aGlyph.mMultiLineComment)
-		return mPalette[(int)PaletteIndex::MultiLineComment];
-	auto const color = mPalette[(int)aGlyph.mColorIndex];
-	if (aGlyph.mPreprocessor)
+private:
+	void Run()
 	{
-		const auto ppcolor = mPalette[(int)PaletteIndex::Preprocessor];
-		const int c0 = ((ppcolor & 0xff) + (color & 0xff)) / 2;
-		const int c1 = (((ppcolor >> 8) & 0xff) + ((color >> 8) & 0xff)) / 2;
-		const int c2 = (((ppcolor >> 16) & 0xff) + ((color >> 16) & 0xff)) / 2;
-		const int c3 = (((ppcolor >> 24) & 0xff) + ((color >> 24) & 0xff)) / 2;
-		return ImU32(c0 | (c1 << 8) | (c2 << 16) | (c3 << 24));
+		for (;;)
+		{
+			std::shared_ptr<ColorizeJob> job;
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				mCondition.wait(lock, [this] { return mQuit || mPending != nullptr; });
+				if (mQuit)
+					return;
+				job.swap(mPending);
+			}
+			Process(*job);
+		}
 	}
-	return color;
-}
-
-void TextEditor::HandleKeyboardInputs()
-{
-	ImGuiIO& io = ImGui::GetIO();
-	auto shift = io.KeyShift;
-	auto ctrl = io.ConfigMacOSXBehaviors ? io.KeySuper : io.KeyCtrl;
-	auto alt = io.ConfigMacOSXBehaviors ? io.KeyCtrl : io.KeyAlt;
 
-	if (ImGui::IsWindowFocused())
+	void Process(ColorizeJob& aJob)
 	{
-		if (ImGui::IsWindowHovered())
-			ImGui::SetMouseCursor(ImGuiMouseCursor_TextInput);
-		//ImGui::CaptureKeyboardFromApp(true);
+		ColorizeSnapshot& snapshot(aJob.mSnapshot);
+		const int fromLine = snapshot.mFirstLine;
+		const int toLine = fromLine + (int)snapshot.mLineStarts.size() - 1;
+
+		// comments are scanned in order, as far as needed to tokenize the visible lines first, then the ones below and above them
+		const int visibleFrom = std::min(std::max(aJob.mVisibleFrom, fromLine), toLine);
+		const int visibleTo = std::max(std::min(aJob.mVisibleTo, toLine), visibleFrom);
+		const int ranges[3][2] = {
+			{ visibleFrom, visibleTo },
+			{ visibleTo, toLine },
+			{ fromLine, visibleFrom },
+		};
 
-		io.WantCaptureKeyboard = true;
-		io.WantTextInput = true;
+		std::vector<uint8_t> info;
+		int scannedTo = fromLine;
 
-		if (!IsReadOnly() && ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Z))
-			Undo();
-		else if (!IsReadOnly() && !ctrl && !shift && alt && ImGui::IsKeyPressed(ImGuiKey_Backspace))
-			Undo();
-		else if (!IsReadOnly() && ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Y))
-			Redo();
-		else if (!ctrl && !alt && ImGui::IsKeyPressed(ImGuiKey_UpArrow))
-			MoveUp(1, shift);
-		else if (!ctrl && !alt && ImGui::IsKeyPressed(ImGuiKey_DownArrow))
-			MoveDown(1, shift);
-		else if (!alt && ImGui::IsKeyPressed(ImGuiKey_LeftArrow))
-			MoveLeft(1, shift, ctrl);
-		else if (!alt && ImGui::IsKeyPressed(ImGuiKey_RightArrow))
-			MoveRight(1, shift, ctrl);
-		else if (!alt && ImGui::IsKeyPressed(ImGuiKey_PageUp))
-			MoveUp(GetPageSize() - 4, shift);
-		else if (!alt && ImGui::IsKeyPressed(ImGuiKey_PageDown))
-			MoveDown(GetPageSize() - 4, shift);
-		else if (!alt && ctrl && ImGui::IsKeyPressed(ImGuiKey_Home))
-			MoveTop(shift);
-		else if (ctrl && !alt && ImGui::IsKeyPressed(ImGuiKey_End))
-			MoveBottom(shift);
-		else if (!ctrl && !alt && ImGui::IsKeyPressed(ImGuiKey_Home))
-			MoveHome(shift);
-		else if (!ctrl && !alt && ImGui::IsKeyPressed(ImGuiKey_End))
-			MoveEnd(shift);
-		else if (!IsReadOnly() && !ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Delete))
-			Delete();
-		else if (!IsReadOnly() && !ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Backspace))
-			Backspace();
-		else if (!ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Insert))
-			mOverwrite ^= true;
-		else if (ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Insert))
-			Copy();
-		else if (ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_C))
-			Copy();
-		else if (!IsReadOnly() && !ctrl && shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Insert))
-			Paste();
-		else if (!IsReadOnly() && ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_V))
-			Paste();
-		else if (ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_X))
-			Cut();
-		else if (!ctrl && shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Delete))
-			Cut();
-		else if (ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_A))
-			SelectAll();
-		else if (!IsReadOnly() && !ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Enter))
-			EnterCharacter('\n', false);
-		else if (!IsReadOnly() && !ctrl && !alt && ImGui::IsKeyPressed(ImGuiKey_Tab))
-			EnterCharacter('\t', shift);
-
-		if (!IsReadOnly() && !io.InputQueueCharacters.empty())
+		for (auto& range : ranges)
 		{
-			for (int i = 0; i < io.InputQueueCharacters.Size; i++)
+			for (int from = range[0]; from < range[1]; from += kColorizeChunkLines)
 			{
-				auto c = io.InputQueueCharacters[i];
-				if (c != 0 && (c == '\n' || c >= 32))
-					EnterCharacter(c, shift);
-			}
-			io.InputQueueCharacters.resize(0);
-		}
-	}
-}
-
-void TextEditor::HandleMouseInputs()
-{
-	ImGuiIO& io = ImGui::GetIO();
-	auto shift = io.KeyShift;
-	auto ctrl = io.ConfigMacOSXBehaviors ? io.KeySuper : io.KeyCtrl;
-	auto alt = io.ConfigMacOSXBehaviors ? io.KeyCtrl : io.KeyAlt;
+				const int to = std::min(from + kColorizeChunkLines, range[1]);
 
-	if (ImGui::IsWindowHovered())
-	{
-		if (!shift && !alt)
-		{
-			auto click = ImGui::IsMouseClicked(0);
-			auto doubleClick = ImGui::IsMouseDoubleClicked(0);
-			auto t = ImGui::GetTime();
-			auto tripleClick = click && !doubleClick && (mLastClick != -1.0f && (t - mLastClick) < io.MouseDoubleClickTime);
+				while (scannedTo < to)
+				{
+					if (mSerial != aJob.mSerial)
+						return;
 
-			/*
-			Left mouse button triple click
-			*/
+					const int scanTo = std::min(scannedTo + kColorizeChunkLines, to);
+					const bool tokenized = scannedTo >= aJob.mColorFrom && scanTo <= aJob.mColorTo;
+					const size_t chunkStart = snapshot.mLineStarts[scannedTo - fromLine];
+					const size_t chunkEnd = snapshot.mLineStarts[scanTo - fromLine];
+					if (!tokenized)
+						info.assign(snapshot.mInfo.begin() + chunkStart, snapshot.mInfo.begin() + chunkEnd);
 
-			if (tripleClick)
-			{
-				if (!ctrl)
-				{
-					mState.mCursorPosition = mInteractiveStart = mInteractiveEnd = ScreenPosToCoordinates(ImGui::GetMousePos());
-					mSelectionMode = SelectionMode::Line;
-					SetSelection(mInteractiveStart, mInteractiveEnd, mSelectionMode);
-				}
+					TextEditor::ColorizeComments(*aJob.mLanguage, snapshot, scannedTo, scanTo);
 
-				mLastClick = -1.0f;
-			}
+					// a string or a '\' left open in the lines above can make characters part of a preprocessor line
+					// or no longer, which is seen by the tokenizer, so the lines only scanned are tokenized again for it
+					for (int i = scannedTo; i < scanTo && !tokenized; ++i)
+					{
+						if (i >= aJob.mColorFrom && i < aJob.mColorTo)
+							continue;
 
-			/*
-			Left mouse button double click
-			*/
+						const size_t lineStart = snapshot.mLineStarts[i - fromLine];
+						const size_t lineEnd = snapshot.mLineStarts[i - fromLine + 1];
+						for (size_t j = lineStart; j < lineEnd; ++j)
+						{
+							if (((info[j - chunkStart] ^ snapshot.mInfo[j]) & Line::kPreprocessor) != 0)
+							{
+								TextEditor::ColorizeTokens(*aJob.mLanguage, aJob.mTokenScanner.get(), *aJob.mRegexList, *aJob.mWordTable, snapshot, i, i + 1);
+								break;
+							}
+						}
+					}
 
-			else if (doubleClick)
-			{
-				if (!ctrl)
-				{
-					mState.mCursorPosition = mInteractiveStart = mInteractiveEnd = ScreenPosToCoordinates(ImGui::GetMousePos());
-					if (mSelectionMode == SelectionMode::Line)
-						mSelectionMode = SelectionMode::Normal;
-					else
-						mSelectionMode = SelectionMode::Word;
-					SetSelection(mInteractiveStart, mInteractiveEnd, mSelectionMode);
+					std::lock_guard<std::mutex> lock(mMutex);
+					SetReady(aJob, scannedTo, std::min(scanTo, aJob.mColorFrom));
+					SetReady(aJob, std::max(scannedTo, aJob.mColorTo), scanTo);
+					aJob.mScannedTo = scannedTo = scanTo;
 				}
 
-				mLastClick = (float)ImGui::GetTime();
-			}
+				const int colorFrom = std::max(from, aJob.mColorFrom);
+				const int colorTo = std::min(to, aJob.mColorTo);
+				if (colorFrom >= colorTo)
+					continue;
 
-			/*
-			Left mouse button click
-			*/
-			else if (click)
-			{
-				mState.mCursorPosition = mInteractiveStart = mInteractiveEnd = ScreenPosToCoordinates(ImGui::GetMousePos());
-				if (ctrl)
-					mSelectionMode = SelectionMode::Word;
-				else
-					mSelectionMode = SelectionMode::Normal;
-				SetSelection(mInteractiveStart, mInteractiveEnd, mSelectionMode);
+				if (mSerial != aJob.mSerial)
+					return;
 
-				mLastClick = (float)ImGui::GetTime();
-			}
-			// Mouse left button dragging (=> update selection)
-			else if (ImGui::IsMouseDragging(0) && ImGui::IsMouseDown(0))
-			{
-				io.WantCaptureMouse = true;
-				mState.mCursorPosition = mInteractiveEnd = ScreenPosToCoordinates(ImGui::GetMousePos());
-				SetSelection(mInteractiveStart, mInteractiveEnd, mSelectionMode);
+				TextEditor::ColorizeTokens(*aJob.mLanguage, aJob.mTokenScanner.get(), *aJob.mRegexList, *aJob.mWordTable, snapshot, colorFrom, colorTo);
+
+				std::lock_guard<std::mutex> lock(mMutex);
+				SetReady(aJob, colorFrom, colorTo);
 			}
 		}
-	}
-}
 
-void TextEditor::Render()
-{
-	/* Compute mCharAdvance regarding to scaled font size (Ctrl + mouse wheel)*/
-	const float fontSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, "#", nullptr, nullptr).x;
-	mCharAdvance = ImVec2(fontSize, ImGui::GetTextLineHeightWithSpacing() * mLineSpacing);
+		std::lock_guard<std::mutex> lock(mMutex);
+		aJob.mDone = true;
+	}
 
-	/* Update palette with the current alpha from style */
-	for (int i = 0; i < (int)PaletteIndex::Max; ++i)
+	// the mutex has to be locked
+	static void SetReady(ColorizeJob& aJob, int aFromLine, int aToLine)
 	{
-		auto color = ImGui::ColorConvertU32ToFloat4(mPaletteBase[i]);
-		color.w *= ImGui::GetStyle().Alpha;
-		mPalette[i] = ImGui::ColorConvertFloat4ToU32(color);
+		if (aFromLine >= aToLine)
+			return;
+
+		const int firstLine = aJob.mSnapshot.mFirstLine;
+		std::fill(aJob.mReady.begin() + (aFromLine - firstLine), aJob.mReady.begin() + (aToLine - firstLine), 1);
 	}
 
-	assert(mLineBuffer.empty());
+	std::atomic<uint64_t> mSerial;
+	bool mQuit;
+	std::shared_ptr<ColorizeJob> mPending;
+	std::condition_variable mCondition;
+	std::thread mThread;
+};
+#else
+class TextEditor::ColorizeWorker
+{
+};
+#endif
 
-	auto contentSize = ImGui::GetWindowContentRegionMax();
-	auto drawList = ImGui::GetWindowDrawList();
-	float longest(mTextStart);
+TextEditor::TextEditor()
+	: TextEditor(LanguageDefinition::HLSL())
+{
+}
 
-	if (mScrollToTop)
-	{
-		mScrollToTop = false;
-		ImGui::SetScrollY(0.f);
-	}
+TextEditor::TextEditor(const LanguageDefinition& aLanguageDef)
+	: mLineSpacing(1.0f)
+	, mUndoIndex(0)
+	, mUndoMemoryUsage(0)
+	, mUndoMemoryLimit(64 * 1024 * 1024)
+	, mUndoTextVersion(0)
+	, mTabSize(4)
+	, mOverwrite(false)
+	, mReadOnly(false)
+	, mWithinRender(false)
+	, mScrollToCursor(false)
+	, mScrollToTop(false)
+	, mTextChanged(false)
+	, mTextChangedSinceLastTime(false)
+	, mColorizerEnabled(true)
+#ifndef TEXTEDITOR_NO_THREADS
+	, mColorizerThreaded(true)
+#else
+	, mColorizerThreaded(false)
+#endif
+	, mTextVersion(1)
+	, mTextStart(20.0f)
+	, mLayoutGeneration(1)
+	, mLayoutFont(nullptr)
+	, mLayoutFontSize(0.0f)
+	, mLeftMargin(10)
+	, mCursorPositionChanged(false)
+	, mColorRangeMin(0)
+	, mColorRangeMax(0)
+	, mSelectionMode(SelectionMode::Normal)
+	, mHandleKeyboardInputs(true)
+	, mHandleMouseInputs(true)
+	, mIgnoreImGuiChild(false)
+	, mShowWhitespaces(true)
+	, mWordWrap(false)
+	, mWrapWidth(0.0f)
+	, mWrapGeneration(1)
+	, mWrapLayoutGeneration(0)
+	, mLastLayoutId(0)
+	, mCheckComments(true)
+	, mStartTime(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count())
+	, mLastClick(-1.0f)
+	, mSearchCaseSensitive(true)
+	, mSearchWholeWord(false)
+	, mTextChangeCallback(nullptr)
+	, mTextChangeUserData(nullptr)
+	, mChangeFirst(-1)
+	, mChangeOldEnd(0)
+	, mChangeNewEnd(0)
+{
+	SetPalette(GetDarkPalette());
+	SetLanguageDefinition(aLanguageDef);
+	mLines.push_back(Line());
+}
 
-	ImVec2 cursorScreenPos = ImGui::GetCursorScreenPos();
-	auto scrollX = ImGui::GetScrollX();
-	auto scrollY = ImGui::GetScrollY();
+TextEditor::~TextEditor()
+{
+}
 
-	auto lineNo = (int)floor(scrollY / mCharAdvance.y);
-	auto globalLineMax = (int)mLines.size();
-	auto lineMax = std::max(0, std::min((int)mLines.size() - 1, lineNo + (int)floor((scrollY + contentSize.y) / mCharAdvance.y)));
+void TextEditor::SetLanguageDefinition(const LanguageDefinition & aLanguageDef)
+{
+	// definitions not coming from the cache can be changed by their owner later on, so each editor takes a copy
+	LanguageCache::Entry entry;
+	if (!LanguageCache::Find(aLanguageDef, entry))
+		entry = LanguageCache::Compile(std::make_shared<const LanguageDefinition>(aLanguageDef));
 
-	// Deduce mTextStart by evaluating mLines size (global lineMax) plus two spaces as text width
-	char buf[16];
-	snprintf(buf, 16, " %d ", globalLineMax);
-	mTextStart = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x + mLeftMargin;
+	mLanguageDefinition = entry.mDefinition;
+	mTokenScanner = entry.mTokenScanner;
+	mRegexList = entry.mRegexList;
+	mWordTable = entry.mWordTable;
 
-	if (!mLines.empty())
-	{
-		float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
+	Colorize();
+}
 
-		while (lineNo <= lineMax)
-		{
-			ImVec2 lineStartScreenPos = ImVec2(cursorScreenPos.x, cursorScreenPos.y + lineNo * mCharAdvance.y);
-			ImVec2 textScreenPos = ImVec2(lineStartScreenPos.x + mTextStart, lineStartScreenPos.y);
+void TextEditor::SetPalette(const Palette & aValue)
+{
+	mPaletteBase = aValue;
+}
 
-			auto& line = mLines[lineNo];
-			longest = std::max(mTextStart + TextDistanceToLineStart(Coordinates(lineNo, GetLineMaxColumn(lineNo))), longest);
-			auto columnNo = 0;
-			Coordinates lineStartCoord(lineNo, 0);
-			Coordinates lineEndCoord(lineNo, GetLineMaxColumn(lineNo));
+std::string TextEditor::GetText(const Coordinates & aStart, const Coordinates & aEnd) const
+{
+	std::string result;
 
-			// Draw selection for the current line
-			float sstart = -1.0f;
-			float ssend = -1.0f;
+	auto lstart = aStart.mLine;
+	auto lend = aEnd.mLine;
+	auto istart = GetCharacterIndex(aStart);
+	auto iend = GetCharacterIndex(aEnd);
+	size_t s = 0;
 
-			assert(mState.mSelectionStart <= mState.mSelectionEnd);
-			if (mState.mSelectionStart <= lineEndCoord)
-				sstart = mState.mSelectionStart > lineStartCoord ? TextDistanceToLineStart(mState.mSelectionStart) : 0.0f;
-			if (mState.mSelectionEnd > lineStartCoord)
-				ssend = TextDistanceToLineStart(mState.mSelectionEnd < lineEndCoord ? mState.mSelectionEnd : lineEndCoord);
+	for (size_t i = lstart; i < lend; i++)
+		s += mLines[i].size();
 
-			if (mState.mSelectionEnd.mLine > lineNo)
-				ssend += mCharAdvance.x;
+	result.reserve(s + s / 8);
 
-			if (sstart != -1 && ssend != -1 && sstart < ssend)
-			{
-				ImVec2 vstart(lineStartScreenPos.x + mTextStart + sstart, lineStartScreenPos.y);
-				ImVec2 vend(lineStartScreenPos.x + mTextStart + ssend, lineStartScreenPos.y + mCharAdvance.y);
-				drawList->AddRectFilled(vstart, vend, mPalette[(int)PaletteIndex::Selection]);
-			}
+	while (istart < iend || lstart < lend)
+	{
+		if (lstart >= (int)mLines.size())
+			break;
 
-			// Draw breakpoints
-			auto start = ImVec2(lineStartScreenPos.x + scrollX, lineStartScreenPos.y);
+		auto& line = mLines[lstart];
+		if (istart < (int)line.size())
+		{
+			// append the rest of the line, or up to the end column on the last one
+			const int count = (lstart < lend ? (int)line.size() : std::min((int)line.size(), iend)) - istart;
+			result.append(line.GetChars() + istart, count);
+			istart += count;
+		}
+		else
+		{
+			istart = 0;
+			++lstart;
+			result += '\n';
+		}
+	}
 
-			if (mBreakpoints.count(lineNo + 1) != 0)
-			{
-				auto end = ImVec2(lineStartScreenPos.x + contentSize.x + 2.0f * scrollX, lineStartScreenPos.y + mCharAdvance.y);
-				drawList->AddRectFilled(start, end, mPalette[(int)PaletteIndex::Breakpoint]);
-			}
+	return result;
+}
 
-			// Draw error markers
-			auto errorIt = mErrorMarkers.find(lineNo + 1);
-			if (errorIt != mErrorMarkers.end())
-			{
-				auto end = ImVec2(lineStartScreenPos.x + contentSize.x + 2.0f * scrollX, lineStartScreenPos.y + mCharAdvance.y);
-				drawList->AddRectFilled(start, end, mPalette[(int)PaletteIndex::ErrorMarker]);
+TextEditor::Coordinates TextEditor::GetActualCursorCoordinates() const
+{
+	return SanitizeCoordinates(mState.mCursorPosition);
+}
 
-				if (ImGui::IsMouseHoveringRect(lineStartScreenPos, end))
-				{
-					ImGui::BeginTooltip();
-					ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.2f, 0.2f, 1.0f));
-					ImGui::Text("Error at line %d:", errorIt->first);
-					ImGui::PopStyleColor();
-					ImGui::Separator();
-					ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 1.0f, 0.2f, 1.0f));
-					ImGui::Text("%s", errorIt->second.c_str());
+TextEditor::Coordinates TextEditor::SanitizeCoordinates(const Coordinates & aValue) const
+{
+	auto line = aValue.mLine;
+	auto column = aValue.mColumn;
+	if (line >= (int)mLines.size())
+	{
+		if (mLines.empty())
+		{
+			line = 0;
+			column = 0;
+		}
+		else
+		{
+			line = (int)mLines.size() - 1;
+			column = GetLineMaxColumn(line);
+		}
+		return Coordinates(line, column);
+	}
+	else
+	{
+		column = mLines.empty() ? 0 : std::min(column, GetLineMaxColumn(line));
+		return Coordinates(line, column);
+	}
+}
+
+// https://en.wikipedia.org/wiki/UTF-8
+// We assume that the char is a standalone character (<128) or a leading byte of an UTF-8 code sequence (non-10xxxxxx code)
+static int UTF8CharLength(TextEditor::Char c)
+{
+	if ((c & 0xFE) == 0xFC)
+		return 6;
+	if ((c & 0xFC) == 0xF8)
+		return 5;
+	if ((c & 0xF8) == 0xF0)
+		return 4;
+	else if ((c & 0xF0) == 0xE0)
+		return 3;
+	else if ((c & 0xE0) == 0xC0)
+		return 2;
+	return 1;
+}
+
+static bool IsUTFSequence(char c)
+{
+	return (c & 0xC0) == 0x80;
+}
+
+// "Borrowed" from ImGui source
+static inline int ImTextCharToUtf8(char* buf, int buf_size, unsigned int c)
+{
+	if (c < 0x80)
+	{
+		buf[0] = (char)c;
+		return 1;
+	}
+	if (c < 0x800)
+	{
+		if (buf_size < 2) return 0;
+		buf[0] = (char)(0xc0 + (c >> 6));
+		buf[1] = (char)(0x80 + (c & 0x3f));
+		return 2;
+	}
+	if (c >= 0xdc00 && c < 0xe000)
+	{
+		return 0;
+	}
+	if (c >= 0xd800 && c < 0xdc00)
+	{
+		if (buf_size < 4) return 0;
+		buf[0] = (char)(0xf0 + (c >> 18));
+		buf[1] = (char)(0x80 + ((c >> 12) & 0x3f));
+		buf[2] = (char)(0x80 + ((c >> 6) & 0x3f));
+		buf[3] = (char)(0x80 + ((c) & 0x3f));
+		return 4;
+	}
+	//else if (c < 0x10000)
+	{
+		if (buf_size < 3) return 0;
+		buf[0] = (char)(0xe0 + (c >> 12));
+		buf[1] = (char)(0x80 + ((c >> 6) & 0x3f));
+		buf[2] = (char)(0x80 + ((c) & 0x3f));
+		return 3;
+	}
+}
+
+void TextEditor::Advance(Coordinates & aCoordinates) const
+{
+	if (aCoordinates.mLine < (int)mLines.size())
+	{
+		auto& line = mLines[aCoordinates.mLine];
+		auto cindex = GetCharacterIndex(aCoordinates);
+
+		if (cindex + 1 < (int)line.size())
+		{
+			auto delta = UTF8CharLength(line[cindex].mChar);
+			cindex = std::min(cindex + delta, (int)line.size() - 1);
+		}
+		else
+		{
+			++aCoordinates.mLine;
+			cindex = 0;
+		}
+		aCoordinates.mColumn = GetCharacterColumn(aCoordinates.mLine, cindex);
+	}
+}
+
+void TextEditor::DeleteRange(const Coordinates & aStart, const Coordinates & aEnd)
+{
+	assert(aEnd >= aStart);
+	assert(!mReadOnly);
+
+	//printf("D(%d.%d)-(%d.%d)\n", aStart.mLine, aStart.mColumn, aEnd.mLine, aEnd.mColumn);
+
+	if (aEnd == aStart)
+		return;
+
+	auto start = GetCharacterIndex(aStart);
+	auto end = GetCharacterIndex(aEnd);
+
+	AddLinesChange(aStart.mLine, 1, 1);
+
+	if (aStart.mLine == aEnd.mLine)
+	{
+		auto& line = mLines[aStart.mLine];
+		auto n = GetLineMaxColumn(aStart.mLine);
+		if (aEnd.mColumn >= n)
+			line.erase(start, line.size());
+		else
+			line.erase(start, end);
+	}
+	else
+	{
+		auto& firstLine = mLines[aStart.mLine];
+		auto& lastLine = mLines[aEnd.mLine];
+
+		firstLine.erase(start, firstLine.size());
+		lastLine.erase(0, end);
+
+		if (aStart.mLine < aEnd.mLine)
+			firstLine.insert(firstLine.size(), lastLine, 0, lastLine.size());
+
+		if (aStart.mLine < aEnd.mLine)
+			RemoveLine(aStart.mLine + 1, aEnd.mLine + 1);
+	}
+
+	mTextChanged = mTextChangedSinceLastTime = true;
+	++mTextVersion;
+
+}
+
+int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValue)
+{
+	assert(!mReadOnly);
+
+	int cindex = GetCharacterIndex(aWhere);
+	int totalLines = 0;
+
+	// the following edits only touch the lines inserted after this one
+	if (*aValue != '\0')
+		AddLinesChange(aWhere.mLine, 1, 1);
+
+	while (*aValue != '\0')
+	{
+		assert(!mLines.empty());
+
+		if (*aValue == '\r')
+		{
+			// skip
+			++aValue;
+		}
+		else if (*aValue == '\n')
+		{
+			if (cindex < (int)mLines[aWhere.mLine].size())
+			{
+				auto& newLine = InsertLine(aWhere.mLine + 1);
+				auto& line = mLines[aWhere.mLine];
+				newLine.insert(0, line, cindex, line.size());
+				line.erase(cindex, line.size());
+			}
+			else
+			{
+				InsertLine(aWhere.mLine + 1);
+			}
+			++aWhere.mLine;
+			aWhere.mColumn = 0;
+			cindex = 0;
+			++totalLines;
+			++aValue;
+		}
+		else
+		{
+			// gather the whole run of characters up to the next line break, then insert it at once
+			mInsertBuffer.clear();
+			do
+			{
+				auto d = UTF8CharLength(*aValue);
+				while (d-- > 0 && *aValue != '\0')
+					mInsertBuffer.push_back(Glyph(*aValue++, PaletteIndex::Default));
+				++aWhere.mColumn;
+			}
+			while (*aValue != '\0' && *aValue != '\r' && *aValue != '\n');
+
+			auto& line = mLines[aWhere.mLine];
+			line.insert(cindex, mInsertBuffer, 0, mInsertBuffer.size());
+			cindex += (int)mInsertBuffer.size();
+		}
+
+		mTextChanged = mTextChangedSinceLastTime = true;
+		++mTextVersion;
+
+	}
+
+	return totalLines;
+}
+
+void TextEditor::AddUndo(UndoRecord& aValue)
+{
+	assert(!mReadOnly);
+	//printf("AddUndo: (@%d.%d) +\'%s' [%d.%d .. %d.%d], -\'%s', [%d.%d .. %d.%d] (@%d.%d)\n",
+	//	aValue.mBefore.mCursorPosition.mLine, aValue.mBefore.mCursorPosition.mColumn,
+	//	aValue.mAdded.c_str(), aValue.mAddedStart.mLine, aValue.mAddedStart.mColumn, aValue.mAddedEnd.mLine, aValue.mAddedEnd.mColumn,
+	//	aValue.mRemoved.c_str(), aValue.mRemovedStart.mLine, aValue.mRemovedStart.mColumn, aValue.mRemovedEnd.mLine, aValue.mRemovedEnd.mColumn,
+	//	aValue.mAfter.mCursorPosition.mLine, aValue.mAfter.mCursorPosition.mColumn
+	//	);
+
+	// merge typing and deleting into the previous step, as long as nothing else happened in between
+	if (aValue.mTextVersion != 0 && aValue.mTextVersion == mUndoTextVersion && mUndoIndex > 0 && mUndoIndex == (int)mUndoBuffer.size())
+	{
+		auto& last = mUndoBuffer.back();
+		const size_t usage = last.GetMemoryUsage();
+
+		if (last.Merge(aValue))
+		{
+			mUndoMemoryUsage = mUndoMemoryUsage - usage + last.GetMemoryUsage();
+			mUndoTextVersion = mTextVersion;
+			return;
+		}
+	}
+
+	for (size_t i = (size_t)mUndoIndex; i < mUndoBuffer.size(); ++i)
+		mUndoMemoryUsage -= mUndoBuffer[i].GetMemoryUsage();
+
+	mUndoBuffer.resize((size_t)(mUndoIndex + 1));
+	mUndoBuffer.back() = std::move(aValue);
+	mUndoBuffer.back().Compact();
+	mUndoMemoryUsage += mUndoBuffer.back().GetMemoryUsage();
+	++mUndoIndex;
+	mUndoTextVersion = mTextVersion;
+
+	TrimUndo();
+}
+
+void TextEditor::TrimUndo()
+{
+	if (mUndoMemoryLimit == 0)
+		return;
+
+	// drop the oldest steps that can be undone, always keeping the latest one
+	size_t count = 0;
+	while (mUndoMemoryUsage > mUndoMemoryLimit && count < (size_t)mUndoIndex && count + 1 < mUndoBuffer.size())
+		mUndoMemoryUsage -= mUndoBuffer[count++].GetMemoryUsage();
+
+	if (count > 0)
+	{
+		mUndoBuffer.erase(mUndoBuffer.begin(), mUndoBuffer.begin() + count);
+		mUndoIndex -= (int)count;
+	}
+}
+
+TextEditor::Coordinates TextEditor::ScreenPosToCoordinates(const ImVec2& aPosition) const
+{
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	ImVec2 local(aPosition.x - origin.x, aPosition.y - origin.y);
+
+	return VisualRowToCoordinates(std::max(0, (int)floor(local.y / mCharAdvance.y)), local.x);
+}
+
+TextEditor::Coordinates TextEditor::FindWordStart(const Coordinates & aFrom) const
+{
+	Coordinates at = aFrom;
+	if (at.mLine >= (int)mLines.size())
+		return at;
+
+	auto& line = mLines[at.mLine];
+	auto cindex = GetCharacterIndex(at);
+
+	if (cindex >= (int)line.size())
+		return at;
+
+	while (cindex > 0 && isspace(line[cindex].mChar))
+		--cindex;
+
+	auto cstart = line.GetColorIndex(cindex);
+	while (cindex > 0)
+	{
+		auto c = line[cindex].mChar;
+		if ((c & 0xC0) != 0x80)	// not UTF code sequence 10xxxxxx
+		{
+			if (c <= 32 && isspace(c))
+			{
+				cindex++;
+				break;
+			}
+			if (cstart != line.GetColorIndex(cindex - 1))
+				break;
+		}
+		--cindex;
+	}
+	return Coordinates(at.mLine, GetCharacterColumn(at.mLine, cindex));
+}
+
+TextEditor::Coordinates TextEditor::FindWordEnd(const Coordinates & aFrom) const
+{
+	Coordinates at = aFrom;
+	if (at.mLine >= (int)mLines.size())
+		return at;
+
+	auto& line = mLines[at.mLine];
+	auto cindex = GetCharacterIndex(at);
+
+	if (cindex >= (int)line.size())
+		return at;
+
+	bool prevspace = (bool)isspace(line[cindex].mChar);
+	auto cstart = line.GetColorIndex(cindex);
+	while (cindex < (int)line.size())
+	{
+		auto c = line[cindex].mChar;
+		auto d = UTF8CharLength(c);
+		if (cstart != line.GetColorIndex(cindex))
+			break;
+
+		if (prevspace != !!isspace(c))
+		{
+			if (isspace(c))
+				while (cindex < (int)line.size() && isspace(line[cindex].mChar))
+					++cindex;
+			break;
+		}
+		cindex += d;
+	}
+	return Coordinates(aFrom.mLine, GetCharacterColumn(aFrom.mLine, cindex));
+}
+
+TextEditor::Coordinates TextEditor::FindNextWord(const Coordinates & aFrom) const
+{
+	Coordinates at = aFrom;
+	if (at.mLine >= (int)mLines.size())
+		return at;
+
+	// skip to the next non-word character
+	auto cindex = GetCharacterIndex(aFrom);
+	bool isword = false;
+	bool skip = false;
+	if (cindex < (int)mLines[at.mLine].size())
+	{
+		auto& line = mLines[at.mLine];
+		isword = isalnum(line[cindex].mChar);
+		skip = isword;
+	}
+
+	while (!isword || skip)
+	{
+		if (at.mLine >= mLines.size())
+		{
+			auto l = std::max(0, (int) mLines.size() - 1);
+			return Coordinates(l, GetLineMaxColumn(l));
+		}
+
+		auto& line = mLines[at.mLine];
+		if (cindex < (int)line.size())
+		{
+			isword = isalnum(line[cindex].mChar);
+
+			if (isword && !skip)
+				return Coordinates(at.mLine, GetCharacterColumn(at.mLine, cindex));
+
+			if (!isword)
+				skip = false;
+
+			cindex++;
+		}
+		else
+		{
+			cindex = 0;
+			++at.mLine;
+			skip = false;
+			isword = false;
+		}
+	}
+
+	return at;
+}
+
+int TextEditor::GetCharacterIndex(const Coordinates& aCoordinates) const
+{
+	if (aCoordinates.mLine >= mLines.size())
+		return -1;
+	auto& line = mLines[aCoordinates.mLine];
+	int c = 0;
+	int i = 0;
+	for (; i < line.size() && c < aCoordinates.mColumn;)
+	{
+		if (line[i].mChar == '\t')
+			c = (c / mTabSize) * mTabSize + mTabSize;
+		else
+			++c;
+		i += UTF8CharLength(line[i].mChar);
+	}
+	return i;
+}
+
+int TextEditor::GetCharacterColumn(int aLine, int aIndex) const
+{
+	if (aLine >= mLines.size())
+		return 0;
+	auto& line = mLines[aLine];
+	int col = 0;
+	int i = 0;
+	while (i < aIndex && i < (int)line.size())
+	{
+		auto c = line[i].mChar;
+		i += UTF8CharLength(c);
+		if (c == '\t')
+			col = (col / mTabSize) * mTabSize + mTabSize;
+		else
+			col++;
+	}
+	return col;
+}
+
+int TextEditor::GetLineCharacterCount(int aLine) const
+{
+	if (aLine >= mLines.size())
+		return 0;
+	auto& line = mLines[aLine];
+	int c = 0;
+	for (unsigned i = 0; i < line.size(); c++)
+		i += UTF8CharLength(line[i].mChar);
+	return c;
+}
+
+int TextEditor::GetLineMaxColumn(int aLine) const
+{
+	if (aLine >= mLines.size())
+		return 0;
+	auto& line = mLines[aLine];
+	int col = 0;
+	for (unsigned i = 0; i < line.size(); )
+	{
+		auto c = line[i].mChar;
+		if (c == '\t')
+			col = (col / mTabSize) * mTabSize + mTabSize;
+		else
+			col++;
+		i += UTF8CharLength(c);
+	}
+	return col;
+}
+
+bool TextEditor::IsOnWordBoundary(const Coordinates & aAt) const
+{
+	if (aAt.mLine >= (int)mLines.size() || aAt.mColumn == 0)
+		return true;
+
+	auto& line = mLines[aAt.mLine];
+	auto cindex = GetCharacterIndex(aAt);
+	if (cindex >= (int)line.size())
+		return true;
+
+	if (mColorizerEnabled)
+		return line.GetColorIndex(cindex) != line.GetColorIndex(cindex - 1);
+
+	return isspace(line[cindex].mChar) != isspace(line[cindex - 1].mChar);
+}
+
+void TextEditor::RemoveLine(int aStart, int aEnd)
+{
+	assert(!mReadOnly);
+	assert(aEnd >= aStart);
+	assert(mLines.size() > (size_t)(aEnd - aStart));
+
+	ErrorMarkers etmp;
+	for (auto& i : mErrorMarkers)
+	{
+		ErrorMarkers::value_type e(i.first >= aStart ? i.first - 1 : i.first, i.second);
+		if (e.first >= aStart && e.first <= aEnd)
+			continue;
+		etmp.insert(e);
+	}
+	mErrorMarkers = std::move(etmp);
+
+	Breakpoints btmp;
+	for (auto i : mBreakpoints)
+	{
+		if (i >= aStart && i <= aEnd)
+			continue;
+		btmp.insert(i >= aStart ? i - 1 : i);
+	}
+	mBreakpoints = std::move(btmp);
+
+	mLines.erase(aStart, aEnd);
+	assert(!mLines.empty());
+	AddLinesChange(aStart, aEnd - aStart, 0);
+
+	mTextChanged = mTextChangedSinceLastTime = true;
+	++mTextVersion;
+
+}
+
+void TextEditor::RemoveLine(int aIndex)
+{
+	assert(!mReadOnly);
+	assert(mLines.size() > 1);
+
+	ErrorMarkers etmp;
+	for (auto& i : mErrorMarkers)
+	{
+		ErrorMarkers::value_type e(i.first > aIndex ? i.first - 1 : i.first, i.second);
+		if (e.first - 1 == aIndex)
+			continue;
+		etmp.insert(e);
+	}
+	mErrorMarkers = std::move(etmp);
+
+	Breakpoints btmp;
+	for (auto i : mBreakpoints)
+	{
+		if (i == aIndex)
+			continue;
+		btmp.insert(i >= aIndex ? i - 1 : i);
+	}
+	mBreakpoints = std::move(btmp);
+
+	mLines.erase(aIndex);
+	assert(!mLines.empty());
+	AddLinesChange(aIndex, 1, 0);
+
+	mTextChanged = mTextChangedSinceLastTime = true;
+	++mTextVersion;
+
+}
+
+TextEditor::Line& TextEditor::InsertLine(int aIndex)
+{
+	assert(!mReadOnly);
+
+	auto& result = mLines.insert(aIndex, Line());
+	AddLinesChange(aIndex, 0, 1);
+
+	ErrorMarkers etmp;
+	for (auto& i : mErrorMarkers)
+		etmp.insert(ErrorMarkers::value_type(i.first >= aIndex ? i.first + 1 : i.first, i.second));
+	mErrorMarkers = std::move(etmp);
+
+	Breakpoints btmp;
+	for (auto i : mBreakpoints)
+		btmp.insert(i >= aIndex ? i + 1 : i);
+	mBreakpoints = std::move(btmp);
+
+	return result;
+}
+
+std::string TextEditor::GetWordUnderCursor() const
+{
+	auto c = GetCursorPosition();
+	return GetWordAt(c);
+}
+
+std::string TextEditor::GetWordAt(const Coordinates & aCoords) const
+{
+	auto start = FindWordStart(aCoords);
+	auto end = FindWordEnd(aCoords);
+
+	std::string r;
+
+	auto istart = GetCharacterIndex(start);
+	auto iend = GetCharacterIndex(end);
+
+	for (auto it = istart; it < iend; ++it)
+		r.push_back(mLines[aCoords.mLine][it].mChar);
+
+	return r;
+}
+
+ImU32 TextEditor::GetGlyphColor(uint8_t aInfo) const
+{
+	if (!mColorizerEnabled)
+		return mPalette[(int)PaletteIndex::Default];
+	if (aInfo & Line::kComment)
+		return mPalette[(int)PaletteIndex::Comment];
+	if (aInfo & Line::kMultiLineComment)
+		return mPalette[(int)PaletteIndex::MultiLineComment];
+	auto const color = mPalette[aInfo & Line::kColorMask];
+	if (aInfo & Line::kPreprocessor)
+	{
+		const auto ppcolor = mPalette[(int)PaletteIndex::Preprocessor];
+		const int c0 = ((ppcolor & 0xff) + (color & 0xff)) / 2;
+		const int c1 = (((ppcolor >> 8) & 0xff) + ((color >> 8) & 0xff)) / 2;
+		const int c2 = (((ppcolor >> 16) & 0xff) + ((color >> 16) & 0xff)) / 2;
+		const int c3 = (((ppcolor >> 24) & 0xff) + ((color >> 24) & 0xff)) / 2;
+		return ImU32(c0 | (c1 << 8) | (c2 << 16) | (c3 << 24));
+	}
+	return color;
+}
+
+void TextEditor::HandleKeyboardInputs()
+{
+	ImGuiIO& io = ImGui::GetIO();
+	auto shift = io.KeyShift;
+	auto ctrl = io.ConfigMacOSXBehaviors ? io.KeySuper : io.KeyCtrl;
+	auto alt = io.ConfigMacOSXBehaviors ? io.KeyCtrl : io.KeyAlt;
+
+	if (ImGui::IsWindowFocused())
+	{
+		if (ImGui::IsWindowHovered())
+			ImGui::SetMouseCursor(ImGuiMouseCursor_TextInput);
+		//ImGui::CaptureKeyboardFromApp(true);
+
+		io.WantCaptureKeyboard = true;
+		io.WantTextInput = true;
+
+		if (!IsReadOnly() && ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Z))
+			Undo();
+		else if (!IsReadOnly() && !ctrl && !shift && alt && ImGui::IsKeyPressed(ImGuiKey_Backspace))
+			Undo();
+		else if (!IsReadOnly() && ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Y))
+			Redo();
+		else if (!ctrl && !alt && ImGui::IsKeyPressed(ImGuiKey_UpArrow))
+			MoveUp(1, shift);
+		else if (!ctrl && !alt && ImGui::IsKeyPressed(ImGuiKey_DownArrow))
+			MoveDown(1, shift);
+		else if (!alt && ImGui::IsKeyPressed(ImGuiKey_LeftArrow))
+			MoveLeft(1, shift, ctrl);
+		else if (!alt && ImGui::IsKeyPressed(ImGuiKey_RightArrow))
+			MoveRight(1, shift, ctrl);
+		else if (!alt && ImGui::IsKeyPressed(ImGuiKey_PageUp))
+			MoveUp(GetPageSize() - 4, shift);
+		else if (!alt && ImGui::IsKeyPressed(ImGuiKey_PageDown))
+			MoveDown(GetPageSize() - 4, shift);
+		else if (!alt && ctrl && ImGui::IsKeyPressed(ImGuiKey_Home))
+			MoveTop(shift);
+		else if (ctrl && !alt && ImGui::IsKeyPressed(ImGuiKey_End))
+			MoveBottom(shift);
+		else if (!ctrl && !alt && ImGui::IsKeyPressed(ImGuiKey_Home))
+			MoveHome(shift);
+		else if (!ctrl && !alt && ImGui::IsKeyPressed(ImGuiKey_End))
+			MoveEnd(shift);
+		else if (!IsReadOnly() && !ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Delete))
+			Delete();
+		else if (!IsReadOnly() && !ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Backspace))
+			Backspace();
+		else if (!ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Insert))
+			mOverwrite ^= true;
+		else if (ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Insert))
+			Copy();
+		else if (ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_C))
+			Copy();
+		else if (!IsReadOnly() && !ctrl && shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Insert))
+			Paste();
+		else if (!IsReadOnly() && ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_V))
+			Paste();
+		else if (ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_X))
+			Cut();
+		else if (!ctrl && shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Delete))
+			Cut();
+		else if (ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_A))
+			SelectAll();
+		else if (!IsReadOnly() && !ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Enter))
+			EnterCharacter('\n', false);
+		else if (!IsReadOnly() && !ctrl && !alt && ImGui::IsKeyPressed(ImGuiKey_Tab))
+			EnterCharacter('\t', shift);
+
+		if (!IsReadOnly() && !io.InputQueueCharacters.empty())
+		{
+			for (int i = 0; i < io.InputQueueCharacters.Size; i++)
+			{
+				auto c = io.InputQueueCharacters[i];
+				if (c != 0 && (c == '\n' || c >= 32))
+					EnterCharacter(c, shift);
+			}
+			io.InputQueueCharacters.resize(0);
+		}
+	}
+}
+
+void TextEditor::HandleMouseInputs()
+{
+	ImGuiIO& io = ImGui::GetIO();
+	auto shift = io.KeyShift;
+	auto ctrl = io.ConfigMacOSXBehaviors ? io.KeySuper : io.KeyCtrl;
+	auto alt = io.ConfigMacOSXBehaviors ? io.KeyCtrl : io.KeyAlt;
+
+	if (ImGui::IsWindowHovered())
+	{
+		if (!shift && !alt)
+		{
+			auto click = ImGui::IsMouseClicked(0);
+			auto doubleClick = ImGui::IsMouseDoubleClicked(0);
+			auto t = ImGui::GetTime();
+			auto tripleClick = click && !doubleClick && (mLastClick != -1.0f && (t - mLastClick) < io.MouseDoubleClickTime);
+
+			/*
+			Left mouse button triple click
+			*/
+
+			if (tripleClick)
+			{
+				if (!ctrl)
+				{
+					mState.mCursorPosition = mInteractiveStart = mInteractiveEnd = ScreenPosToCoordinates(ImGui::GetMousePos());
+					mSelectionMode = SelectionMode::Line;
+					SetSelection(mInteractiveStart, mInteractiveEnd, mSelectionMode);
+				}
+
+				mLastClick = -1.0f;
+			}
+
+			/*
+			Left mouse button double click
+			*/
+
+			else if (doubleClick)
+			{
+				if (!ctrl)
+				{
+					mState.mCursorPosition = mInteractiveStart = mInteractiveEnd = ScreenPosToCoordinates(ImGui::GetMousePos());
+					if (mSelectionMode == SelectionMode::Line)
+						mSelectionMode = SelectionMode::Normal;
+					else
+						mSelectionMode = SelectionMode::Word;
+					SetSelection(mInteractiveStart, mInteractiveEnd, mSelectionMode);
+				}
+
+				mLastClick = (float)ImGui::GetTime();
+			}
+
+			/*
+			Left mouse button click
+			*/
+			else if (click)
+			{
+				mState.mCursorPosition = mInteractiveStart = mInteractiveEnd = ScreenPosToCoordinates(ImGui::GetMousePos());
+				if (ctrl)
+					mSelectionMode = SelectionMode::Word;
+				else
+					mSelectionMode = SelectionMode::Normal;
+				SetSelection(mInteractiveStart, mInteractiveEnd, mSelectionMode);
+
+				mLastClick = (float)ImGui::GetTime();
+			}
+			// Mouse left button dragging (=> update selection)
+			else if (ImGui::IsMouseDragging(0) && ImGui::IsMouseDown(0))
+			{
+				io.WantCaptureMouse = true;
+				mState.mCursorPosition = mInteractiveEnd = ScreenPosToCoordinates(ImGui::GetMousePos());
+				SetSelection(mInteractiveStart, mInteractiveEnd, mSelectionMode);
+			}
+		}
+	}
+}
+
+void TextEditor::Render()
+{
+	/* Compute mCharAdvance regarding to scaled font size (Ctrl + mouse wheel)*/
+	const float fontSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, "#", nullptr, nullptr).x;
+	mCharAdvance = ImVec2(fontSize, ImGui::GetTextLineHeightWithSpacing() * mLineSpacing);
+
+	/* Update palette with the current alpha from style */
+	for (int i = 0; i < (int)PaletteIndex::Max; ++i)
+	{
+		auto color = ImGui::ColorConvertU32ToFloat4(mPaletteBase[i]);
+		color.w *= ImGui::GetStyle().Alpha;
+		mPalette[i] = ImGui::ColorConvertFloat4ToU32(color);
+	}
+
+	auto contentSize = ImGui::GetWindowContentRegionMax();
+	auto drawList = ImGui::GetWindowDrawList();
+	float longest(mTextStart);
+
+	if (mScrollToTop)
+	{
+		mScrollToTop = false;
+		ImGui::SetScrollY(0.f);
+	}
+
+	ImVec2 cursorScreenPos = ImGui::GetCursorScreenPos();
+	auto scrollX = ImGui::GetScrollX();
+	auto scrollY = ImGui::GetScrollY();
+
+	// Deduce mTextStart by evaluating mLines size plus two spaces as text width
+	char buf[16];
+	snprintf(buf, 16, " %d ", (int)mLines.size());
+	mTextStart = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x + mLeftMargin;
+
+	// Without word wrap each line is a single row. With it, the lines showing the visible rows are wrapped first,
+	// so that the rows below them are where they will be drawn.
+	UpdateWraps();
+
+	auto rowNo = (int)floor(scrollY / mCharAdvance.y);
+	auto rowCount = (int)floor((scrollY + contentSize.y) / mCharAdvance.y);
+	int lineNo = rowNo;
+	int rowInLine = 0;
+
+	if (mWordWrap)
+	{
+		lineNo = mWrapIndex.FindLine(rowNo, rowInLine);
+		for (int line = lineNo, rows = -rowInLine; line < (int)mLines.size() && rows <= rowCount; ++line)
+			rows += (int)GetLineWraps(line).size() + 1;
+		lineNo = mWrapIndex.FindLine(rowNo, rowInLine);
+	}
+
+	const int totalRows = mWordWrap ? mWrapIndex.GetTotalRows() : (int)mLines.size();
+	auto rowMax = std::max(0, std::min(totalRows - 1, rowNo + rowCount));
+
+	if (!mLines.empty())
+	{
+		float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
+
+		for (; rowNo <= rowMax && lineNo < (int)mLines.size(); ++rowNo)
+		{
+			auto& line = mLines[lineNo];
+			const char* chars = line.GetChars();
+			const int lineSize = (int)line.size();
+			const float* offsets = GetGlyphOffsets(line);
+
+			// bytes [rowStart, rowEnd) of the line are drawn on this row, shifted left by the width of the previous rows
+			int rowStart = 0;
+			int rowEnd = lineSize;
+			if (mWordWrap)
+			{
+				const auto& wraps = GetLineWraps(lineNo);
+				rowInLine = std::min(rowInLine, (int)wraps.size());
+				rowStart = rowInLine > 0 ? wraps[rowInLine - 1] : 0;
+				rowEnd = rowInLine < (int)wraps.size() ? wraps[rowInLine] : lineSize;
+			}
+			const float rowX = offsets[rowStart];
+
+			ImVec2 lineStartScreenPos = ImVec2(cursorScreenPos.x, cursorScreenPos.y + rowNo * mCharAdvance.y);
+			ImVec2 textScreenPos = ImVec2(lineStartScreenPos.x + mTextStart - rowX, lineStartScreenPos.y);
+			// spaces overflowing the end of a wrapped row do not need scrolling to
+			const float rowWidth = offsets[rowEnd] - rowX;
+			longest = std::max(mTextStart + (mWordWrap ? std::min(rowWidth, mWrapWidth) : rowWidth), longest);
+
+			// Only the characters within the clip rectangle are walked and drawn, so very long lines cost the same as short ones.
+			// The first visible character is the first one ending past the left edge, the last one starts before the right edge.
+			int visibleStart = (int)(std::upper_bound(offsets + rowStart + 1, offsets + rowEnd + 1, drawList->GetClipRectMin().x - textScreenPos.x) - (offsets + 1));
+			int visibleEnd = (int)(std::lower_bound(offsets + visibleStart, offsets + rowEnd, drawList->GetClipRectMax().x - textScreenPos.x) - offsets);
+			while (visibleStart > rowStart && visibleStart < rowEnd && IsUTFSequence(chars[visibleStart]))
+				--visibleStart;
+			while (visibleEnd < rowEnd && IsUTFSequence(chars[visibleEnd]))
+				++visibleEnd;
+
+			Coordinates lineStartCoord(lineNo, 0);
+
+			// Draw selection for the current line, its length in columns is only needed when the selection starts or ends on it
+			float sstart = -1.0f;
+			float ssend = -1.0f;
+
+			assert(mState.mSelectionStart <= mState.mSelectionEnd);
+			if (mState.mSelectionStart.mLine < lineNo && mState.mSelectionEnd.mLine > lineNo)
+			{
+				sstart = 0.0f;
+				ssend = offsets[lineSize];
+			}
+			else if (mState.mSelectionStart.mLine <= lineNo && mState.mSelectionEnd.mLine >= lineNo && HasSelection())
+			{
+				Coordinates lineEndCoord(lineNo, GetLineMaxColumn(lineNo));
+
+				if (mState.mSelectionStart <= lineEndCoord)
+					sstart = mState.mSelectionStart > lineStartCoord ? TextDistanceToLineStart(mState.mSelectionStart) : 0.0f;
+				if (mState.mSelectionEnd > lineStartCoord)
+					ssend = TextDistanceToLineStart(mState.mSelectionEnd < lineEndCoord ? mState.mSelectionEnd : lineEndCoord);
+			}
+
+			if (mState.mSelectionEnd.mLine > lineNo && rowEnd == lineSize)
+				ssend += mCharAdvance.x;
+
+			// clip the selection to the part of the line on this row
+			if (rowStart > 0 && sstart != -1)
+				sstart = std::max(sstart, rowX);
+			if (rowEnd < lineSize)
+				ssend = std::min(ssend, offsets[rowEnd]);
+
+			if (sstart != -1 && ssend != -1 && sstart < ssend)
+			{
+				ImVec2 vstart(textScreenPos.x + sstart, lineStartScreenPos.y);
+				ImVec2 vend(textScreenPos.x + ssend, lineStartScreenPos.y + mCharAdvance.y);
+				drawList->AddRectFilled(vstart, vend, mPalette[(int)PaletteIndex::Selection]);
+			}
+
+			// Draw search matches
+			if (!mSearchNeedle.empty())
+			{
+				const size_t needleSize = mSearchNeedle.size();
+				const size_t searchStart = (size_t)std::max(0, visibleStart - (int)needleSize + 1);
+				for (size_t index = FindInLine(line, searchStart); index < (size_t)visibleEnd; index = FindInLine(line, index + needleSize))
+				{
+					ImVec2 vstart(textScreenPos.x + std::max(offsets[index], rowX), lineStartScreenPos.y);
+					ImVec2 vend(textScreenPos.x + std::min(offsets[index + needleSize], offsets[rowEnd]), lineStartScreenPos.y + mCharAdvance.y);
+					drawList->AddRectFilled(vstart, vend, mPalette[(int)PaletteIndex::SearchMatch]);
+				}
+			}
+
+			// Draw breakpoints
+			auto start = ImVec2(lineStartScreenPos.x + scrollX, lineStartScreenPos.y);
+
+			if (mBreakpoints.count(lineNo + 1) != 0)
+			{
+				auto end = ImVec2(lineStartScreenPos.x + contentSize.x + 2.0f * scrollX, lineStartScreenPos.y + mCharAdvance.y);
+				drawList->AddRectFilled(start, end, mPalette[(int)PaletteIndex::Breakpoint]);
+			}
+
+			// Draw error markers
+			auto errorIt = mErrorMarkers.find(lineNo + 1);
+			if (errorIt != mErrorMarkers.end())
+			{
+				auto end = ImVec2(lineStartScreenPos.x + contentSize.x + 2.0f * scrollX, lineStartScreenPos.y + mCharAdvance.y);
+				drawList->AddRectFilled(start, end, mPalette[(int)PaletteIndex::ErrorMarker]);
+
+				if (ImGui::IsMouseHoveringRect(lineStartScreenPos, end))
+				{
+					ImGui::BeginTooltip();
+					ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.2f, 0.2f, 1.0f));
+					ImGui::Text("Error at line %d:", errorIt->first);
+					ImGui::PopStyleColor();
+					ImGui::Separator();
+					ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 1.0f, 0.2f, 1.0f));
+					ImGui::Text("%s", errorIt->second.c_str());
 					ImGui::PopStyleColor();
 					ImGui::EndTooltip();
 				}
 			}
 
-			// Draw line number (right aligned)
-			snprintf(buf, 16, "%d  ", lineNo + 1);
+			// Draw line number (right aligned), on the first row of the line only
+			if (rowStart == 0)
+			{
+				snprintf(buf, 16, "%d  ", lineNo + 1);
+
+				auto lineNoWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x;
+				drawList->AddText(ImVec2(lineStartScreenPos.x + mTextStart - lineNoWidth, lineStartScreenPos.y), mPalette[(int)PaletteIndex::LineNumber], buf);
+			}
+
+			if (mState.mCursorPosition.mLine == lineNo)
+			{
+				auto focused = ImGui::IsWindowFocused();
+
+				// Highlight the current line (where the cursor is)
+				if (!HasSelection())
+				{
+					auto end = ImVec2(start.x + contentSize.x + scrollX, start.y + mCharAdvance.y);
+					drawList->AddRectFilled(start, end, mPalette[(int)(focused ? PaletteIndex::CurrentLineFill : PaletteIndex::CurrentLineFillInactive)]);
+					drawList->AddRect(start, end, mPalette[(int)PaletteIndex::CurrentLineEdge], 1.0f);
+				}
+
+				// Render the cursor, on the row starting with it when it is right at a wrap
+				auto cindex = GetCharacterIndex(mState.mCursorPosition);
+				if (focused && cindex >= rowStart && (cindex < rowEnd || rowEnd == lineSize))
+				{
+					auto timeEnd = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+					auto elapsed = timeEnd - mStartTime;
+					if (elapsed > 400)
+					{
+						float width = 1.0f;
+						float cx = TextDistanceToLineStart(mState.mCursorPosition);
+
+						if (mOverwrite && cindex < (int)line.size())
+						{
+							auto c = line[cindex].mChar;
+							if (c == '\t')
+							{
+								auto x = (1.0f + std::floor((1.0f + cx) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
+								width = x - cx;
+							}
+							else
+							{
+								char buf2[2];
+								buf2[0] = line[cindex].mChar;
+								buf2[1] = '\0';
+								width = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf2).x;
+							}
+						}
+						ImVec2 cstart(textScreenPos.x + cx, lineStartScreenPos.y);
+						ImVec2 cend(textScreenPos.x + cx + width, lineStartScreenPos.y + mCharAdvance.y);
+						drawList->AddRectFilled(cstart, cend, mPalette[(int)PaletteIndex::Cursor]);
+						if (elapsed > 800)
+							mStartTime = timeEnd;
+					}
+				}
+			}
+
+			// Render colorized text, drawing each run of same colored characters straight from the line storage
+			const uint8_t* info = line.GetInfo();
+			auto prevColor = visibleStart < visibleEnd ? GetGlyphColor(info[visibleStart]) : mPalette[(int)PaletteIndex::Default];
+			int runStart = visibleStart;
+
+			for (int i = visibleStart; i < visibleEnd;)
+			{
+				const char c = chars[i];
+				auto color = GetGlyphColor(info[i]);
+
+				if ((color != prevColor || c == '\t' || c == ' ') && runStart < i)
+				{
+					const ImVec2 newOffset(textScreenPos.x + offsets[runStart], textScreenPos.y);
+					drawList->AddText(newOffset, prevColor, chars + runStart, chars + i);
+					runStart = i;
+				}
+				prevColor = color;
+
+				if (c == '\t')
+				{
+					if (mShowWhitespaces)
+					{
+						const auto s = ImGui::GetFontSize();
+						const auto x1 = textScreenPos.x + offsets[i] + 1.0f;
+						const auto x2 = textScreenPos.x + offsets[i + 1] - 1.0f;
+						const auto y = textScreenPos.y + s * 0.5f;
+						const ImVec2 p1(x1, y);
+						const ImVec2 p2(x2, y);
+						const ImVec2 p3(x2 - s * 0.2f, y - s * 0.2f);
+						const ImVec2 p4(x2 - s * 0.2f, y + s * 0.2f);
+						drawList->AddLine(p1, p2, 0x90909090);
+						drawList->AddLine(p2, p3, 0x90909090);
+						drawList->AddLine(p2, p4, 0x90909090);
+					}
+					++i;
+				}
+				else if (c == ' ')
+				{
+					if (mShowWhitespaces)
+					{
+						const auto s = ImGui::GetFontSize();
+						const auto x = textScreenPos.x + offsets[i] + spaceSize * 0.5f;
+						const auto y = textScreenPos.y + s * 0.5f;
+						drawList->AddCircleFilled(ImVec2(x, y), 1.5f, 0x80808080, 4);
+					}
+					i++;
+				}
+				else
+				{
+					i = std::min(i + UTF8CharLength(c), visibleEnd);
+					continue;
+				}
+				runStart = i;
+			}
+
+			if (runStart < visibleEnd)
+			{
+				const ImVec2 newOffset(textScreenPos.x + offsets[runStart], textScreenPos.y);
+				drawList->AddText(newOffset, prevColor, chars + runStart, chars + visibleEnd);
+			}
+
+			if (rowEnd == lineSize)
+			{
+				++lineNo;
+				rowInLine = 0;
+			}
+			else
+				++rowInLine;
+		}
+
+		// Draw a tooltip on known identifiers/preprocessor symbols
+		if (ImGui::IsMousePosValid())
+		{
+			auto id = GetWordAt(ScreenPosToCoordinates(ImGui::GetMousePos()));
+			if (!id.empty())
+			{
+				auto it = mLanguageDefinition->mIdentifiers.find(id);
+				if (it != mLanguageDefinition->mIdentifiers.end())
+				{
+					ImGui::BeginTooltip();
+					ImGui::TextUnformatted(it->second.mDeclaration.c_str());
+					ImGui::EndTooltip();
+				}
+				else
+				{
+					auto pi = mLanguageDefinition->mPreprocIdentifiers.find(id);
+					if (pi != mLanguageDefinition->mPreprocIdentifiers.end())
+					{
+						ImGui::BeginTooltip();
+						ImGui::TextUnformatted(pi->second.mDeclaration.c_str());
+						ImGui::EndTooltip();
+					}
+				}
+			}
+		}
+	}
+
+
+	ImGui::Dummy(ImVec2((longest + 2), totalRows * mCharAdvance.y));
+
+	if (mScrollToCursor)
+	{
+		EnsureCursorVisible();
+		ImGui::SetWindowFocus();
+		mScrollToCursor = false;
+	}
+}
+
+void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
+{
+	mWithinRender = true;
+	mTextChanged = false;
+	mCursorPositionChanged = false;
+
+	ImGui::PushStyleColor(ImGuiCol_ChildBg, ImGui::ColorConvertU32ToFloat4(mPalette[(int)PaletteIndex::Background]));
+	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 0.0f));
+	if (!mIgnoreImGuiChild)
+		ImGui::BeginChild(aTitle, aSize, aBorder,
+		                  ImGuiWindowFlags_HorizontalScrollbar |
+		                  ImGuiWindowFlags_AlwaysHorizontalScrollbar |
+		                  ImGuiWindowFlags_NoMove |
+		                  ImGuiWindowFlags_NoNavInputs);
+
+	UpdateLayoutGeneration();
+
+	if (mHandleKeyboardInputs)
+	{
+		HandleKeyboardInputs();
+		ImGui::PushTabStop(true);
+	}
+
+	if (mHandleMouseInputs)
+		HandleMouseInputs();
+
+	ColorizeInternal();
+	Render();
+
+	if (mHandleKeyboardInputs)
+		ImGui::PopTabStop();
+
+	if (!mIgnoreImGuiChild)
+		ImGui::EndChild();
+
+	ImGui::PopStyleVar();
+	ImGui::PopStyleColor();
+
+	mWithinRender = false;
+	FlushTextChange();
+}
+
+void TextEditor::SetText(const std::string & aText)
+{
+	const int oldLines = (int)mLines.size();
+	mLines.clear();
+	mLines.emplace_back(Line());
+	ParseText(aText.data(), aText.size());
+	AddLinesChange(0, oldLines, (int)mLines.size());
+
+	mTextChanged = mTextChangedSinceLastTime = true;
+	++mTextVersion;
+
+	mScrollToTop = true;
+
+	mUndoBuffer.clear();
+	mUndoIndex = 0;
+	mUndoMemoryUsage = 0;
+
+	Colorize();
+	FlushTextChange();
+}
+
+void TextEditor::AppendText(const char * aText, size_t aSize)
+{
+	if (mLines.empty())
+		mLines.emplace_back(Line());
+
+	const int firstLine = (int)mLines.size() - 1;
+	ParseText(aText, aSize);
+	AddLinesChange(firstLine, 1, (int)mLines.size() - firstLine);
+
+	mTextChanged = mTextChangedSinceLastTime = true;
+	++mTextVersion;
+
+	Colorize(firstLine, (int)mLines.size() - firstLine);
+	FlushTextChange();
+}
+
+#if defined(TEXTEDITOR_SEARCH_AVX2) || defined(TEXTEDITOR_SEARCH_SSE2)
+static inline int CountTrailingZeros(uint32_t aValue)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, aValue);
+	return (int)index;
+#else
+	return __builtin_ctz(aValue);
+#endif
+}
+#endif
+
+// Counts the line feeds in [aFirst, aLast) of aText, setting aCarriageReturns if any carriage return was seen.
+static size_t CountLineBreaks(const char* aText, size_t aFirst, size_t aLast, bool& aCarriageReturns)
+{
+	size_t i = aFirst;
+	size_t count = 0;
+	bool carriageReturns = false;
+
+#if defined(TEXTEDITOR_SEARCH_AVX2)
+	const __m256i lineFeed = _mm256_set1_epi8('\n');
+	const __m256i carriageReturn = _mm256_set1_epi8('\r');
+	for (; i + 32 <= aLast; i += 32)
+	{
+		const __m256i bytes = _mm256_loadu_si256((const __m256i*)(aText + i));
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, lineFeed));
+		carriageReturns |= _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, carriageReturn)) != 0;
+		for (; mask != 0; mask &= mask - 1)
+			++count;
+	}
+#elif defined(TEXTEDITOR_SEARCH_SSE2)
+	const __m128i lineFeed = _mm_set1_epi8('\n');
+	const __m128i carriageReturn = _mm_set1_epi8('\r');
+	for (; i + 16 <= aLast; i += 16)
+	{
+		const __m128i bytes = _mm_loadu_si128((const __m128i*)(aText + i));
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, lineFeed));
+		carriageReturns |= _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, carriageReturn)) != 0;
+		for (; mask != 0; mask &= mask - 1)
+			++count;
+	}
+#endif
+
+	for (; i < aLast; ++i)
+	{
+		if (aText[i] == '\n')
+			++count;
+		else if (aText[i] == '\r')
+			carriageReturns = true;
+	}
+
+	aCarriageReturns = carriageReturns;
+	return count;
+}
+
+// Appends aSize bytes of text to aLine, leaving out carriage returns if there may be any.
+static void AppendLineText(TextEditor::Line& aLine, const char* aText, size_t aSize, bool aCarriageReturns)
+{
+	const char* const end = aText + aSize;
+	const char* run = aCarriageReturns ? (const char*)memchr(aText, '\r', aSize) : nullptr;
+	if (run == nullptr)
+	{
+		aLine.append(aText, aSize);
+		return;
+	}
+
+	aLine.reserve(aLine.size() + aSize);
+	for (const char* text = aText; text < end; text = run + 1)
+	{
+		run = (const char*)memchr(text, '\r', end - text);
+		if (run == nullptr)
+			run = end;
+		aLine.append(text, run - text);
+	}
+}
+
+// Lines made from a whole text are packed into blocks of this size, rather than each getting its own allocation.
+// Blocks are aligned on their size, so that a line finds the block holding it from its data pointer.
+static const size_t kLineBlockSize = 1 << 16;
+
+// Longer lines get their own allocation, which also bounds the space left unused at the end of a block.
+static const size_t kLineBlockMaxLine = kLineBlockSize / 32;
+
+// Header of a block, followed by the chars and info bytes of its lines.
+struct LineBlock
+{
+	size_t mLines; // lines still using the block, which is freed along with the last one
+};
+
+static LineBlock* AllocateLineBlock()
+{
+	void* block = nullptr;
+#ifdef _WIN32
+	block = _aligned_malloc(kLineBlockSize, kLineBlockSize);
+#else
+	if (posix_memalign(&block, kLineBlockSize, kLineBlockSize) != 0)
+		block = nullptr;
+#endif
+	if (block == nullptr)
+		throw std::bad_alloc();
+
+	static_cast<LineBlock*>(block)->mLines = 0;
+	return static_cast<LineBlock*>(block);
+}
+
+void TextEditor::Line::ReleaseShared(char* aData)
+{
+	LineBlock* block = reinterpret_cast<LineBlock*>(reinterpret_cast<uintptr_t>(aData) & ~(uintptr_t)(kLineBlockSize - 1));
+	if (--block->mLines != 0)
+		return;
+#ifdef _WIN32
+	_aligned_free(block);
+#else
+	free(block);
+#endif
+}
+
+// Copies aSize bytes of text to aDest, leaving out carriage returns if there may be any. Returns how many were copied.
+static size_t CopyLineText(char* aDest, const char* aText, size_t aSize, bool aCarriageReturns)
+{
+	if (!aCarriageReturns)
+	{
+		memcpy(aDest, aText, aSize);
+		return aSize;
+	}
+
+	char* dest = aDest;
+	const char* const end = aText + aSize;
+	for (const char* text = aText; text < end; )
+	{
+		const char* run = (const char*)memchr(text, '\r', end - text);
+		if (run == nullptr)
+			run = end;
+		memcpy(dest, text, run - text);
+		dest += run - text;
+		text = run + 1;
+	}
+	return dest - aDest;
+}
+
+// Runs aFunction(aTask) for aTask in [0, aTasks), on separate threads when there is more than one task.
+template<class F>
+static void RunTasks(size_t aTasks, const F& aFunction)
+{
+#ifndef TEXTEDITOR_NO_THREADS
+	std::vector<std::thread> threads;
+	threads.reserve(aTasks);
+	for (size_t task = 1; task < aTasks; ++task)
+		threads.emplace_back(aFunction, task);
+	aFunction(0);
+	for (auto& thread : threads)
+		thread.join();
+#else
+	for (size_t task = 0; task < aTasks; ++task)
+		aFunction(task);
+#endif
+}
+
+void TextEditor::ParseText(const char * aText, size_t aSize)
+{
+	// large texts are split into chunks of at least this many bytes, scanned and turned into lines in parallel
+	static const size_t kChunkSize = 1 << 20;
+
+	size_t chunks = 1;
+#ifndef TEXTEDITOR_NO_THREADS
+	chunks = std::max(std::min((size_t)std::thread::hardware_concurrency(), aSize / kChunkSize), (size_t)1);
+#endif
+
+	// count the line feeds first, so that all lines can be added at once and filled independently
+	std::vector<size_t> firstLines(chunks + 1, 0);
+	std::vector<char> carriageReturns(chunks);
+	RunTasks(chunks, [&](size_t aChunk) {
+		bool chunkCarriageReturns;
+		firstLines[aChunk + 1] = CountLineBreaks(aText, aSize * aChunk / chunks, aSize * (aChunk + 1) / chunks, chunkCarriageReturns);
+		carriageReturns[aChunk] = chunkCarriageReturns;
+	});
+
+	const bool anyCarriageReturns = std::find(carriageReturns.begin(), carriageReturns.end(), (char)true) != carriageReturns.end();
+
+	for (size_t chunk = 0; chunk < chunks; ++chunk)
+		firstLines[chunk + 1] += firstLines[chunk];
+
+	// the text up to the first line feed continues the current last line
+	const char* const textEnd = aText + aSize;
+	const char* firstBreak = (const char*)memchr(aText, '\n', aSize);
+	AppendLineText(mLines.back(), aText, (firstBreak != nullptr ? firstBreak : textEnd) - aText, anyCarriageReturns);
+
+	const size_t count = firstLines.back();
+	if (count == 0)
+		return;
+
+	// each line feed starts a new line, which runs until the next one or the end of the text
+	// the lines are added empty, then filled in place a leaf of the tree at a time
+	const size_t firstNewLine = mLines.size();
+	mLines.append(count);
+
+	RunTasks(chunks, [&](size_t aChunk) {
+		const char* const chunkStart = aText + aSize * aChunk / chunks;
+		const char* const chunkEnd = aText + aSize * (aChunk + 1) / chunks;
+		const char* lineBreak = (const char*)memchr(chunkStart, '\n', chunkEnd - chunkStart);
+
+		Line* line = nullptr;
+		size_t contiguous = 0;
+		LineBlock* block = nullptr;
+		size_t blockUsed = kLineBlockSize;
+
+		for (size_t i = firstNewLine + firstLines[aChunk]; lineBreak != nullptr && lineBreak < chunkEnd; ++i, ++line, --contiguous)
+		{
+			if (contiguous == 0)
+				line = mLines.GetContiguous(i, contiguous);
+
+			const char* const start = lineBreak + 1;
+			lineBreak = (const char*)memchr(start, '\n', textEnd - start);
+			const size_t size = (lineBreak != nullptr ? lineBreak : textEnd) - start;
+
+			if (size == 0 || size > kLineBlockMaxLine)
+			{
+				AppendLineText(*line, start, size, anyCarriageReturns);
+				continue;
+			}
+
+			// room is made for the whole line, carriage returns included, as the block has to be picked first
+			if (blockUsed + size * 2 > kLineBlockSize)
+			{
+				block = AllocateLineBlock();
+				blockUsed = sizeof(LineBlock);
+			}
+
+			char* data = reinterpret_cast<char*>(block) + blockUsed;
+			const size_t copied = CopyLineText(data, start, size, anyCarriageReturns);
+			std::memset(data + size, (uint8_t)PaletteIndex::Default, copied);
+			line->SetShared(data, copied, size);
+			++block->mLines;
+			blockUsed += size * 2;
+		}
+	});
+}
+
+void TextEditor::SetTextLines(const std::vector<std::string> & aLines)
+{
+	const int oldLines = (int)mLines.size();
+	mLines.clear();
+
+	if (aLines.empty())
+	{
+		mLines.emplace_back(Line());
+	}
+	else
+	{
+		for (size_t i = 0; i < aLines.size(); ++i)
+		{
+			const std::string & aLine = aLines[i];
+
+			mLines.emplace_back(Line()).append(aLine.data(), aLine.size());
+		}
+	}
+
+	AddLinesChange(0, oldLines, (int)mLines.size());
+
+	mTextChanged = mTextChangedSinceLastTime = true;
+	++mTextVersion;
+
+	mScrollToTop = true;
+
+	mUndoBuffer.clear();
+	mUndoIndex = 0;
+	mUndoMemoryUsage = 0;
+
+	Colorize();
+	FlushTextChange();
+}
+
+void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
+{
+	assert(!mReadOnly);
+
+	UndoRecord u;
+
+	u.mBefore = mState;
+	if (!HasSelection())
+		u.mTextVersion = mTextVersion;
+
+	if (HasSelection())
+	{
+		if (aChar == '\t' && mState.mSelectionStart.mLine != mState.mSelectionEnd.mLine)
+		{
+
+			auto start = mState.mSelectionStart;
+			auto end = mState.mSelectionEnd;
+			auto originalEnd = end;
+
+			if (start > end)
+				std::swap(start, end);
+			start.mColumn = 0;
+			//			end.mColumn = end.mLine < mLines.size() ? mLines[end.mLine].size() : 0;
+			if (end.mColumn == 0 && end.mLine > 0)
+				--end.mLine;
+			if (end.mLine >= (int)mLines.size())
+				end.mLine = mLines.empty() ? 0 : (int)mLines.size() - 1;
+			end.mColumn = GetLineMaxColumn(end.mLine);
+
+			//if (end.mColumn >= GetLineMaxColumn(end.mLine))
+			//	end.mColumn = GetLineMaxColumn(end.mLine) - 1;
+
+			u.mRemovedStart = start;
+			u.mRemovedEnd = end;
+			u.mRemoved = GetText(start, end);
+
+			bool modified = false;
+
+			for (int i = start.mLine; i <= end.mLine; i++)
+			{
+				auto& line = mLines[i];
+				if (aShift)
+				{
+					if (!line.empty())
+					{
+						if (line.front().mChar == '\t')
+						{
+							line.erase(0);
+							modified = true;
+						}
+						else
+						{
+							for (int j = 0; j < mTabSize && !line.empty() && line.front().mChar == ' '; j++)
+							{
+								line.erase(0);
+								modified = true;
+							}
+						}
+					}
+				}
+				else
+				{
+					line.insert(0, Glyph('\t', TextEditor::PaletteIndex::Background));
+					modified = true;
+				}
+			}
+
+			if (modified)
+			{
+				AddLinesChange(start.mLine, end.mLine - start.mLine + 1, end.mLine - start.mLine + 1);
+
+				start = Coordinates(start.mLine, GetCharacterColumn(start.mLine, 0));
+				Coordinates rangeEnd;
+				if (originalEnd.mColumn != 0)
+				{
+					end = Coordinates(end.mLine, GetLineMaxColumn(end.mLine));
+					rangeEnd = end;
+					u.mAdded = GetText(start, end);
+				}
+				else
+				{
+					end = Coordinates(originalEnd.mLine, 0);
+					rangeEnd = Coordinates(end.mLine - 1, GetLineMaxColumn(end.mLine - 1));
+					u.mAdded = GetText(start, rangeEnd);
+				}
+
+				u.mAddedStart = start;
+				u.mAddedEnd = rangeEnd;
+				u.mAfter = mState;
+
+				mState.mSelectionStart = start;
+				mState.mSelectionEnd = end;
+				AddUndo(u);
+
+				mTextChanged = mTextChangedSinceLastTime = true;
+				++mTextVersion;
+
+
+				EnsureCursorVisible();
+			}
+
+			return;
+		} // c == '\t'
+		else
+		{
+			u.mRemoved = GetSelectedText();
+			u.mRemovedStart = mState.mSelectionStart;
+			u.mRemovedEnd = mState.mSelectionEnd;
+			DeleteSelection();
+		}
+	} // HasSelection
+
+	auto coord = GetActualCursorCoordinates();
+	u.mAddedStart = coord;
+
+	assert(!mLines.empty());
 
-			auto lineNoWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x;
-			drawList->AddText(ImVec2(lineStartScreenPos.x + mTextStart - lineNoWidth, lineStartScreenPos.y), mPalette[(int)PaletteIndex::LineNumber], buf);
+	if (aChar == '\n')
+	{
+		InsertLine(coord.mLine + 1);
+		AddLinesChange(coord.mLine, 1, 1);
+		auto& line = mLines[coord.mLine];
+		auto& newLine = mLines[coord.mLine + 1];
 
-			if (mState.mCursorPosition.mLine == lineNo)
+		if (mLanguageDefinition->mAutoIndentation)
+			for (size_t it = 0; it < line.size() && isascii(line[it].mChar) && isblank(line[it].mChar); ++it)
+				newLine.push_back(line[it]);
+
+		const size_t whitespaceSize = newLine.size();
+		auto cindex = GetCharacterIndex(coord);
+		newLine.insert(newLine.size(), line, cindex, line.size());
+		line.erase(cindex, line.size());
+		SetCursorPosition(Coordinates(coord.mLine + 1, GetCharacterColumn(coord.mLine + 1, (int)whitespaceSize)));
+		u.mAdded = (char)aChar;
+	}
+	else
+	{
+		char buf[7];
+		int e = ImTextCharToUtf8(buf, 7, aChar);
+		if (e > 0)
+		{
+			buf[e] = '\0';
+			auto& line = mLines[coord.mLine];
+			auto cindex = GetCharacterIndex(coord);
+			AddLinesChange(coord.mLine, 1, 1);
+
+			if (mOverwrite && cindex < (int)line.size())
 			{
-				auto focused = ImGui::IsWindowFocused();
+				auto d = UTF8CharLength(line[cindex].mChar);
+
+				u.mRemovedStart = mState.mCursorPosition;
+				u.mRemovedEnd = Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex + d));
+
+				while (d-- > 0 && cindex < (int)line.size())
+				{
+					u.mRemoved += line[cindex].mChar;
+					line.erase(cindex);
+				}
+			}
+
+			for (auto p = buf; *p != '\0'; p++, ++cindex)
+				line.insert(cindex, Glyph(*p, PaletteIndex::Default));
+			u.mAdded = buf;
+
+			SetCursorPosition(Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex)));
+		}
+		else
+			return;
+	}
+
+	mTextChanged = mTextChangedSinceLastTime = true;
+	++mTextVersion;
+
+
+	u.mAddedEnd = GetActualCursorCoordinates();
+	u.mAfter = mState;
+
+	AddUndo(u);
+
+	Colorize(coord.mLine - 1, 3);
+	EnsureCursorVisible();
+}
+
+void TextEditor::SetReadOnly(bool aValue)
+{
+	mReadOnly = aValue;
+}
+
+bool TextEditor::IsTextChangedSinceLastTime()
+{
+	bool changed = mTextChangedSinceLastTime;
+	mTextChangedSinceLastTime = false;
+	return changed;
+}
+
+void TextEditor::SetTextChangeCallback(TextChangeCallback aCallback, void* aUserData)
+{
+	mTextChangeCallback = aCallback;
+	mTextChangeUserData = aUserData;
+	mChangeFirst = -1;
+}
+
+// Merges the change of aRemoved lines at aFirst into aAdded ones with a pending change, which turned the lines
+// from aChangeFirst to aChangeOldEnd into the ones up to aChangeNewEnd, aChangeFirst being -1 when there is none.
+static void MergeLinesChange(int& aChangeFirst, int& aChangeOldEnd, int& aChangeNewEnd, int aFirst, int aRemoved, int aAdded)
+{
+	if (aChangeFirst < 0)
+	{
+		aChangeFirst = aFirst;
+		aChangeOldEnd = aFirst + aRemoved;
+		aChangeNewEnd = aFirst + aAdded;
+		return;
+	}
+
+	// lines before the pending change are untouched and lines after it are only shifted
+	const int end = aFirst + aRemoved;
+	if (aFirst < aChangeFirst)
+		aChangeFirst = aFirst;
+	if (end > aChangeNewEnd)
+	{
+		aChangeOldEnd += end - aChangeNewEnd;
+		aChangeNewEnd = end;
+	}
+	aChangeNewEnd += aAdded - aRemoved;
+}
+
+// Moves the range of lines [aFrom, aTo) along with the change of aRemoved lines at aFirst into aAdded ones,
+// growing it to all of the changed lines when it ends or starts within the removed ones.
+static void ShiftLineRange(int& aFrom, int& aTo, int aFirst, int aRemoved, int aAdded)
+{
+	if (aFrom >= aTo)
+		return;
+
+	const int end = aFirst + aRemoved;
+	if (aTo >= end)
+		aTo += aAdded - aRemoved;
+	else if (aTo > aFirst)
+		aTo = aFirst + aAdded;
+
+	if (aFrom >= end)
+		aFrom += aAdded - aRemoved;
+	else if (aFrom > aFirst)
+		aFrom = aFirst;
+}
+
+// Merges an edit of the lines into the pending change: aRemoved lines starting at aFirst, in the current text,
+// are replaced by aAdded lines. The pending change covers lines [mChangeFirst, mChangeOldEnd) of the text as it
+// was at the last callback, which are now lines [mChangeFirst, mChangeNewEnd).
+void TextEditor::AddLinesChange(int aFirst, int aRemoved, int aAdded)
+{
+	if (mWordWrap)
+		mWrapIndex.Splice(aFirst, aRemoved, aAdded);
+
+	// lines still to colorize move along, and the colorizer thread needs to know where its results go
+	ShiftLineRange(mColorRangeMin, mColorRangeMax, aFirst, aRemoved, aAdded);
+	if (mColorRangeMin == mColorRangeMax)
+	{
+		mColorRangeMin = std::numeric_limits<int>::max();
+		mColorRangeMax = 0;
+	}
+#ifndef TEXTEDITOR_NO_THREADS
+	if (mColorizeWorker != nullptr && mColorizeWorker->mActive != nullptr)
+	{
+		ColorizeJob& job(*mColorizeWorker->mActive);
+		MergeLinesChange(job.mChangeFirst, job.mChangeOldEnd, job.mChangeNewEnd, aFirst, aRemoved, aAdded);
+	}
+#endif
+
+	MergeLinesChange(mChangeFirst, mChangeOldEnd, mChangeNewEnd, aFirst, aRemoved, aAdded);
+}
+
+// Reports the pending change, if any, unless an operation is still going on in Render().
+void TextEditor::FlushTextChange()
+{
+	if (mWithinRender || mChangeFirst < 0)
+		return;
+
+	TextChange change;
+	change.mFirstLine = mChangeFirst;
+	change.mRemovedLines = mChangeOldEnd - mChangeFirst;
+	change.mAddedLines = mChangeNewEnd - mChangeFirst;
+	mChangeFirst = -1;
+
+	if (mTextChangeCallback == nullptr)
+		return;
+
+	for (int i = 0; i < change.mAddedLines; ++i)
+	{
+		const Line& line = mLines[change.mFirstLine + i];
+		if (i > 0)
+			change.mText += '\n';
+		change.mText.append(line.GetChars(), line.size());
+	}
+
+	mTextChangeCallback(change, mTextVersion, mTextChangeUserData);
+}
+
+void TextEditor::SetColorizerEnable(bool aValue)
+{
+	mColorizerEnabled = aValue;
+}
+
+void TextEditor::SetColorizerThreaded(bool aValue)
+{
+#ifndef TEXTEDITOR_NO_THREADS
+	if (!aValue && mColorizeWorker != nullptr)
+	{
+		// the lines the job had to tokenize are queued again where they are now, the comments of all lines get scanned anyway
+		if (mColorizeWorker->mActive != nullptr)
+		{
+			const ColorizeJob& job(*mColorizeWorker->mActive);
+			int from = job.mColorFrom, to = job.mColorTo;
+			if (job.mChangeFirst >= 0)
+				ShiftLineRange(from, to, job.mChangeFirst, job.mChangeOldEnd - job.mChangeFirst, job.mChangeNewEnd - job.mChangeFirst);
+			if (from < to)
+				Colorize(from, to - from);
+			mCheckComments = true;
+		}
+		mColorizeWorker.reset();
+	}
+	mColorizerThreaded = aValue;
+#else
+	(void)aValue;
+#endif
+}
+
+bool TextEditor::IsColorizing() const
+{
+	if (!mColorizerEnabled)
+		return false;
+	if (mCheckComments || mColorRangeMin < mColorRangeMax)
+		return true;
+#ifndef TEXTEDITOR_NO_THREADS
+	if (mColorizeWorker != nullptr && mColorizeWorker->mActive != nullptr)
+		return true;
+#endif
+	return false;
+}
+
+void TextEditor::SetCursorPosition(const Coordinates & aPosition)
+{
+	if (mState.mCursorPosition != aPosition)
+	{
+		mState.mCursorPosition = aPosition;
+		mCursorPositionChanged = true;
+		EnsureCursorVisible();
+	}
+}
+
+void TextEditor::SetSelectionStart(const Coordinates & aPosition)
+{
+	mState.mSelectionStart = SanitizeCoordinates(aPosition);
+	if (mState.mSelectionStart > mState.mSelectionEnd)
+		std::swap(mState.mSelectionStart, mState.mSelectionEnd);
+}
+
+void TextEditor::SetSelectionEnd(const Coordinates & aPosition)
+{
+	mState.mSelectionEnd = SanitizeCoordinates(aPosition);
+	if (mState.mSelectionStart > mState.mSelectionEnd)
+		std::swap(mState.mSelectionStart, mState.mSelectionEnd);
+}
+
+void TextEditor::SetSelection(const Coordinates & aStart, const Coordinates & aEnd, SelectionMode aMode)
+{
+	auto oldSelStart = mState.mSelectionStart;
+	auto oldSelEnd = mState.mSelectionEnd;
+
+	mState.mSelectionStart = SanitizeCoordinates(aStart);
+	mState.mSelectionEnd = SanitizeCoordinates(aEnd);
+	if (mState.mSelectionStart > mState.mSelectionEnd)
+		std::swap(mState.mSelectionStart, mState.mSelectionEnd);
+
+	switch (aMode)
+	{
+	case TextEditor::SelectionMode::Normal:
+		break;
+	case TextEditor::SelectionMode::Word:
+	{
+		mState.mSelectionStart = FindWordStart(mState.mSelectionStart);
+		if (!IsOnWordBoundary(mState.mSelectionEnd))
+			mState.mSelectionEnd = FindWordEnd(FindWordStart(mState.mSelectionEnd));
+		break;
+	}
+	case TextEditor::SelectionMode::Line:
+	{
+		const auto lineNo = mState.mSelectionEnd.mLine;
+		// const auto lineSize = (size_t)lineNo < mLines.size() ? mLines[lineNo].size() : 0;
+		mState.mSelectionStart = Coordinates(mState.mSelectionStart.mLine, 0);
+		mState.mSelectionEnd = Coordinates(lineNo, GetLineMaxColumn(lineNo));
+		break;
+	}
+	default:
+		break;
+	}
+
+	if (mState.mSelectionStart != oldSelStart ||
+		mState.mSelectionEnd != oldSelEnd)
+		mCursorPositionChanged = true;
+}
+
+void TextEditor::SetTabSize(int aValue)
+{
+	const int tabSize = std::max(0, std::min(32, aValue));
+	if (tabSize != mTabSize)
+	{
+		mTabSize = tabSize;
+		++mLayoutGeneration;
+	}
+}
+
+void TextEditor::SetWordWrap(bool aValue)
+{
+	if (aValue == mWordWrap)
+		return;
+
+	// the row index is only kept while wrapping, the next frame wraps the lines at the current width
+	mWordWrap = aValue;
+	mWrapWidth = 0.0f;
+	mWrapIndex.Reset(aValue ? (int)mLines.size() : 0);
+	EnsureCursorVisible();
+}
+
+void TextEditor::InsertText(const std::string & aValue)
+{
+	InsertText(aValue.c_str());
+}
+
+void TextEditor::InsertText(const char * aValue)
+{
+	if (aValue == nullptr)
+		return;
+
+	auto pos = GetActualCursorCoordinates();
+	auto start = std::min(pos, mState.mSelectionStart);
+	int totalLines = pos.mLine - start.mLine;
+
+	totalLines += InsertTextAt(pos, aValue);
+
+	SetSelection(pos, pos);
+	SetCursorPosition(pos);
+	Colorize(start.mLine - 1, totalLines + 2);
+	FlushTextChange();
+}
+
+void TextEditor::DeleteSelection()
+{
+	assert(mState.mSelectionEnd >= mState.mSelectionStart);
+
+	if (mState.mSelectionEnd == mState.mSelectionStart)
+		return;
 
-				// Highlight the current line (where the cursor is)
-				if (!HasSelection())
-				{
-					auto end = ImVec2(start.x + contentSize.x + scrollX, start.y + mCharAdvance.y);
-					drawList->AddRectFilled(start, end, mPalette[(int)(focused ? PaletteIndex::CurrentLineFill : PaletteIndex::CurrentLineFillInactive)]);
-					drawList->AddRect(start, end, mPalette[(int)PaletteIndex::CurrentLineEdge], 1.0f);
-				}
+	DeleteRange(mState.mSelectionStart, mState.mSelectionEnd);
 
-				// Render the cursor
-				if (focused)
-				{
-					auto timeEnd = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-					auto elapsed = timeEnd - mStartTime;
-					if (elapsed > 400)
-					{
-						float width = 1.0f;
-						auto cindex = GetCharacterIndex(mState.mCursorPosition);
-						float cx = TextDistanceToLineStart(mState.mCursorPosition);
+	SetSelection(mState.mSelectionStart, mState.mSelectionStart);
+	SetCursorPosition(mState.mSelectionStart);
+	Colorize(mState.mSelectionStart.mLine, 1);
+}
 
-						if (mOverwrite && cindex < (int)line.size())
-						{
-							auto c = line[cindex].mChar;
-							if (c == '\t')
-							{
-								auto x = (1.0f + std::floor((1.0f + cx) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-								width = x - cx;
-							}
-							else
-							{
-								char buf2[2];
-								buf2[0] = line[cindex].mChar;
-								buf2[1] = '\0';
-								width = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf2).x;
-							}
-						}
-						ImVec2 cstart(textScreenPos.x + cx, lineStartScreenPos.y);
-						ImVec2 cend(textScreenPos.x + cx + width, lineStartScreenPos.y + mCharAdvance.y);
-						drawList->AddRectFilled(cstart, cend, mPalette[(int)PaletteIndex::Cursor]);
-						if (elapsed > 800)
-							mStartTime = timeEnd;
-					}
-				}
+void TextEditor::MoveUp(int aAmount, bool aSelect)
+{
+	auto oldPos = mState.mCursorPosition;
+	if (mWordWrap && mWrapWidth > 0.0f)
+	{
+		float x;
+		const int row = GetVisualRow(GetActualCursorCoordinates(), x);
+		mState.mCursorPosition = VisualRowToCoordinates(std::max(0, row - aAmount), mTextStart + x);
+	}
+	else
+		mState.mCursorPosition.mLine = std::max(0, mState.mCursorPosition.mLine - aAmount);
+	if (oldPos != mState.mCursorPosition)
+	{
+		if (aSelect)
+		{
+			if (oldPos == mInteractiveStart)
+				mInteractiveStart = mState.mCursorPosition;
+			else if (oldPos == mInteractiveEnd)
+				mInteractiveEnd = mState.mCursorPosition;
+			else
+			{
+				mInteractiveStart = mState.mCursorPosition;
+				mInteractiveEnd = oldPos;
 			}
+		}
+		else
+			mInteractiveStart = mInteractiveEnd = mState.mCursorPosition;
+		SetSelection(mInteractiveStart, mInteractiveEnd);
 
-			// Render colorized text
-			auto prevColor = line.empty() ? mPalette[(int)PaletteIndex::Default] : GetGlyphColor(line[0]);
-			ImVec2 bufferOffset;
+		EnsureCursorVisible();
+	}
+}
+
+void TextEditor::MoveDown(int aAmount, bool aSelect)
+{
+	assert(mState.mCursorPosition.mColumn >= 0);
+	auto oldPos = mState.mCursorPosition;
+	if (mWordWrap && mWrapWidth > 0.0f)
+	{
+		float x;
+		const int row = GetVisualRow(GetActualCursorCoordinates(), x);
+		mState.mCursorPosition = VisualRowToCoordinates(std::max(0, std::min(mWrapIndex.GetTotalRows() - 1, row + aAmount)), mTextStart + x);
+	}
+	else
+		mState.mCursorPosition.mLine = std::max(0, std::min((int)mLines.size() - 1, mState.mCursorPosition.mLine + aAmount));
 
-			for (int i = 0; i < line.size();)
+	if (mState.mCursorPosition != oldPos)
+	{
+		if (aSelect)
+		{
+			if (oldPos == mInteractiveEnd)
+				mInteractiveEnd = mState.mCursorPosition;
+			else if (oldPos == mInteractiveStart)
+				mInteractiveStart = mState.mCursorPosition;
+			else
 			{
-				auto& glyph = line[i];
-				auto color = GetGlyphColor(glyph);
+				mInteractiveStart = oldPos;
+				mInteractiveEnd = mState.mCursorPosition;
+			}
+		}
+		else
+			mInteractiveStart = mInteractiveEnd = mState.mCursorPosition;
+		SetSelection(mInteractiveStart, mInteractiveEnd);
 
-				if ((color != prevColor || glyph.mChar == '\t' || glyph.mChar == ' ') && !mLineBuffer.empty())
-				{
-					const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-					drawList->AddText(newOffset, prevColor, mLineBuffer.c_str());
-					auto textSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, mLineBuffer.c_str(), nullptr, nullptr);
-					bufferOffset.x += textSize.x;
-					mLineBuffer.clear();
-				}
-				prevColor = color;
+		EnsureCursorVisible();
+	}
+}
 
-				if (glyph.mChar == '\t')
-				{
-					auto oldX = bufferOffset.x;
-					bufferOffset.x = (1.0f + std::floor((1.0f + bufferOffset.x) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-					++i;
+void TextEditor::MoveLeft(int aAmount, bool aSelect, bool aWordMode)
+{
+	if (mLines.empty())
+		return;
 
-					if (mShowWhitespaces)
-					{
-						const auto s = ImGui::GetFontSize();
-						const auto x1 = textScreenPos.x + oldX + 1.0f;
-						const auto x2 = textScreenPos.x + bufferOffset.x - 1.0f;
-						const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
-						const ImVec2 p1(x1, y);
-						const ImVec2 p2(x2, y);
-						const ImVec2 p3(x2 - s * 0.2f, y - s * 0.2f);
-						const ImVec2 p4(x2 - s * 0.2f, y + s * 0.2f);
-						drawList->AddLine(p1, p2, 0x90909090);
-						drawList->AddLine(p2, p3, 0x90909090);
-						drawList->AddLine(p2, p4, 0x90909090);
-					}
-				}
-				else if (glyph.mChar == ' ')
-				{
-					if (mShowWhitespaces)
-					{
-						const auto s = ImGui::GetFontSize();
-						const auto x = textScreenPos.x + bufferOffset.x + spaceSize * 0.5f;
-						const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
-						drawList->AddCircleFilled(ImVec2(x, y), 1.5f, 0x80808080, 4);
-					}
-					bufferOffset.x += spaceSize;
-					i++;
-				}
+	auto oldPos = mState.mCursorPosition;
+	mState.mCursorPosition = GetActualCursorCoordinates();
+	auto line = mState.mCursorPosition.mLine;
+	auto cindex = GetCharacterIndex(mState.mCursorPosition);
+
+	while (aAmount-- > 0)
+	{
+		if (cindex == 0)
+		{
+			if (line > 0)
+			{
+				--line;
+				if ((int)mLines.size() > line)
+					cindex = (int)mLines[line].size();
 				else
+					cindex = 0;
+			}
+		}
+		else
+		{
+			--cindex;
+			if (cindex > 0)
+			{
+				if ((int)mLines.size() > line)
 				{
-					auto l = UTF8CharLength(glyph.mChar);
-					while (l-- > 0)
-						mLineBuffer.push_back(line[i++].mChar);
+					while (cindex > 0 && IsUTFSequence(mLines[line][cindex].mChar))
+						--cindex;
 				}
-				++columnNo;
 			}
+		}
 
-			if (!mLineBuffer.empty())
-			{
-				const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-				drawList->AddText(newOffset, prevColor, mLineBuffer.c_str());
-				mLineBuffer.clear();
-			}
+		mState.mCursorPosition = Coordinates(line, GetCharacterColumn(line, cindex));
+		if (aWordMode)
+		{
+			mState.mCursorPosition = FindWordStart(mState.mCursorPosition);
+			cindex = GetCharacterIndex(mState.mCursorPosition);
+		}
+	}
+
+	mState.mCursorPosition = Coordinates(line, GetCharacterColumn(line, cindex));
 
-			++lineNo;
+	assert(mState.mCursorPosition.mColumn >= 0);
+	if (aSelect)
+	{
+		if (oldPos == mInteractiveStart)
+			mInteractiveStart = mState.mCursorPosition;
+		else if (oldPos == mInteractiveEnd)
+			mInteractiveEnd = mState.mCursorPosition;
+		else
+		{
+			mInteractiveStart = mState.mCursorPosition;
+			mInteractiveEnd = oldPos;
 		}
+	}
+	else
+		mInteractiveStart = mInteractiveEnd = mState.mCursorPosition;
+	SetSelection(mInteractiveStart, mInteractiveEnd, aSelect && aWordMode ? SelectionMode::Word : SelectionMode::Normal);
 
-		// Draw a tooltip on known identifiers/preprocessor symbols
-		if (ImGui::IsMousePosValid())
+	EnsureCursorVisible();
+}
+
+void TextEditor::MoveRight(int aAmount, bool aSelect, bool aWordMode)
+{
+	auto oldPos = mState.mCursorPosition;
+
+	if (mLines.empty() || oldPos.mLine >= mLines.size())
+		return;
+
+	auto cindex = GetCharacterIndex(mState.mCursorPosition);
+	while (aAmount-- > 0)
+	{
+		auto lindex = mState.mCursorPosition.mLine;
+		auto& line = mLines[lindex];
+
+		if (cindex >= line.size())
 		{
-			auto id = GetWordAt(ScreenPosToCoordinates(ImGui::GetMousePos()));
-			if (!id.empty())
+			if (mState.mCursorPosition.mLine < mLines.size() - 1)
 			{
-				auto it = mLanguageDefinition.mIdentifiers.find(id);
-				if (it != mLanguageDefinition.mIdentifiers.end())
-				{
-					ImGui::BeginTooltip();
-					ImGui::TextUnformatted(it->second.mDeclaration.c_str());
-					ImGui::EndTooltip();
-				}
-				else
-				{
-					auto pi = mLanguageDefinition.mPreprocIdentifiers.find(id);
-					if (pi != mLanguageDefinition.mPreprocIdentifiers.end())
-					{
-						ImGui::BeginTooltip();
-						ImGui::TextUnformatted(pi->second.mDeclaration.c_str());
-						ImGui::EndTooltip();
-					}
-				}
+				mState.mCursorPosition.mLine = std::max(0, std::min((int)mLines.size() - 1, mState.mCursorPosition.mLine + 1));
+				mState.mCursorPosition.mColumn = 0;
 			}
+			else
+				return;
+		}
+		else
+		{
+			cindex += UTF8CharLength(line[cindex].mChar);
+			mState.mCursorPosition = Coordinates(lindex, GetCharacterColumn(lindex, cindex));
+			if (aWordMode)
+				mState.mCursorPosition = FindNextWord(mState.mCursorPosition);
+		}
+	}
+
+	if (aSelect)
+	{
+		if (oldPos == mInteractiveEnd)
+			mInteractiveEnd = SanitizeCoordinates(mState.mCursorPosition);
+		else if (oldPos == mInteractiveStart)
+			mInteractiveStart = mState.mCursorPosition;
+		else
+		{
+			mInteractiveStart = oldPos;
+			mInteractiveEnd = mState.mCursorPosition;
 		}
 	}
+	else
+		mInteractiveStart = mInteractiveEnd = mState.mCursorPosition;
+	SetSelection(mInteractiveStart, mInteractiveEnd, aSelect && aWordMode ? SelectionMode::Word : SelectionMode::Normal);
+
+	EnsureCursorVisible();
+}
 
+void TextEditor::MoveTop(bool aSelect)
+{
+	auto oldPos = mState.mCursorPosition;
+	SetCursorPosition(Coordinates(0, 0));
 
-	ImGui::Dummy(ImVec2((longest + 2), mLines.size() * mCharAdvance.y));
+	if (mState.mCursorPosition != oldPos)
+	{
+		if (aSelect)
+		{
+			mInteractiveEnd = oldPos;
+			mInteractiveStart = mState.mCursorPosition;
+		}
+		else
+			mInteractiveStart = mInteractiveEnd = mState.mCursorPosition;
+		SetSelection(mInteractiveStart, mInteractiveEnd);
+	}
+}
 
-	if (mScrollToCursor)
+void TextEditor::TextEditor::MoveBottom(bool aSelect)
+{
+	auto oldPos = GetCursorPosition();
+	auto newPos = Coordinates((int)mLines.size() - 1, 0);
+	SetCursorPosition(newPos);
+	if (aSelect)
 	{
-		EnsureCursorVisible();
-		ImGui::SetWindowFocus();
-		mScrollToCursor = false;
+		mInteractiveStart = oldPos;
+		mInteractiveEnd = newPos;
 	}
+	else
+		mInteractiveStart = mInteractiveEnd = newPos;
+	SetSelection(mInteractiveStart, mInteractiveEnd);
 }
 
-void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
+void TextEditor::MoveHome(bool aSelect)
 {
-	mWithinRender = true;
-	mTextChanged = false;
-	mCursorPositionChanged = false;
-
-	ImGui::PushStyleColor(ImGuiCol_ChildBg, ImGui::ColorConvertU32ToFloat4(mPalette[(int)PaletteIndex::Background]));
-	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 0.0f));
-	if (!mIgnoreImGuiChild)
-		ImGui::BeginChild(aTitle, aSize, aBorder,
-		                  ImGuiWindowFlags_HorizontalScrollbar |
-		                  ImGuiWindowFlags_AlwaysHorizontalScrollbar |
-		                  ImGuiWindowFlags_NoMove |
-		                  ImGuiWindowFlags_NoNavInputs);
+	auto oldPos = mState.mCursorPosition;
+	SetCursorPosition(Coordinates(mState.mCursorPosition.mLine, 0));
 
-	if (mHandleKeyboardInputs)
+	if (mState.mCursorPosition != oldPos)
 	{
-		HandleKeyboardInputs();
-		ImGui::PushTabStop(true);
+		if (aSelect)
+		{
+			if (oldPos == mInteractiveStart)
+				mInteractiveStart = mState.mCursorPosition;
+			else if (oldPos == mInteractiveEnd)
+				mInteractiveEnd = mState.mCursorPosition;
+			else
+			{
+				mInteractiveStart = mState.mCursorPosition;
+				mInteractiveEnd = oldPos;
+			}
+		}
+		else
+			mInteractiveStart = mInteractiveEnd = mState.mCursorPosition;
+		SetSelection(mInteractiveStart, mInteractiveEnd);
 	}
-
-	if (mHandleMouseInputs)
-		HandleMouseInputs();
-
-	ColorizeInternal();
-	Render();
-
-	if (mHandleKeyboardInputs)
-		ImGui::PopTabStop();
-
-	if (!mIgnoreImGuiChild)
-		ImGui::EndChild();
-
-	ImGui::PopStyleVar();
-	ImGui::PopStyleColor();
-
-	mWithinRender = false;
 }
 
-void TextEditor::SetText(const std::string & aText)
+void TextEditor::MoveEnd(bool aSelect)
 {
-	mLines.clear();
-	mLines.emplace_back(Line());
-	for (auto chr : aText)
+	auto oldPos = mState.mCursorPosition;
+	SetCursorPosition(Coordinates(mState.mCursorPosition.mLine, GetLineMaxColumn(oldPos.mLine)));
+
+	if (mState.mCursorPosition != oldPos)
 	{
-		if (chr == '\r')
+		if (aSelect)
 		{
-			// ignore the carriage return character
+			if (oldPos == mInteractiveEnd)
+				mInteractiveEnd = mState.mCursorPosition;
+			else if (oldPos == mInteractiveStart)
+				mInteractiveStart = mState.mCursorPosition;
+			else
+			{
+				mInteractiveStart = oldPos;
+				mInteractiveEnd = mState.mCursorPosition;
+			}
 		}
-		else if (chr == '\n')
-			mLines.emplace_back(Line());
 		else
-		{
-			mLines.back().emplace_back(Glyph(chr, PaletteIndex::Default));
-		}
+			mInteractiveStart = mInteractiveEnd = mState.mCursorPosition;
+		SetSelection(mInteractiveStart, mInteractiveEnd);
 	}
-
-	mTextChanged = mTextChangedSinceLastTime = true;
-	mScrollToTop = true;
-
-	mUndoBuffer.clear();
-	mUndoIndex = 0;
-
-	Colorize();
 }
 
-void TextEditor::SetTextLines(const std::vector<std::string> & aLines)
+void TextEditor::Delete()
 {
-	mLines.clear();
+	assert(!mReadOnly);
 
-	if (aLines.empty())
+	if (mLines.empty())
+		return;
+
+	UndoRecord u;
+	u.mBefore = mState;
+
+	if (HasSelection())
 	{
-		mLines.emplace_back(Line());
+		u.mRemoved = GetSelectedText();
+		u.mRemovedStart = mState.mSelectionStart;
+		u.mRemovedEnd = mState.mSelectionEnd;
+
+		DeleteSelection();
 	}
 	else
 	{
-		mLines.resize(aLines.size());
+		u.mTextVersion = mTextVersion;
+		auto pos = GetActualCursorCoordinates();
+		SetCursorPosition(pos);
+		auto& line = mLines[pos.mLine];
+		auto cindex = GetCharacterIndex(pos);
 
-		for (size_t i = 0; i < aLines.size(); ++i)
+		if (cindex >= (int)line.size())
 		{
-			const std::string & aLine = aLines[i];
+			if (pos.mLine == (int)mLines.size() - 1)
+				return;
+
+			u.mRemoved = '\n';
+			u.mRemovedStart = u.mRemovedEnd = Coordinates(pos.mLine, GetLineMaxColumn(pos.mLine));
+			Advance(u.mRemovedEnd);
 
-			mLines[i].reserve(aLine.size());
-			for (size_t j = 0; j < aLine.size(); ++j)
-				mLines[i].emplace_back(Glyph(aLine[j], PaletteIndex::Default));
+			AddLinesChange(pos.mLine, 1, 1);
+			auto& nextLine = mLines[pos.mLine + 1];
+			line.insert(line.size(), nextLine, 0, nextLine.size());
+			RemoveLine(pos.mLine + 1);
+		}
+		else
+		{
+			// the cursor can be in the middle of a tab, so the undo step uses the columns of the removed character
+			auto cend = std::min(cindex + UTF8CharLength(line[cindex].mChar), (int)line.size());
+			u.mRemovedStart = Coordinates(pos.mLine, GetCharacterColumn(pos.mLine, cindex));
+			u.mRemovedEnd = Coordinates(pos.mLine, GetCharacterColumn(pos.mLine, cend));
+			u.mRemoved.assign(line.GetChars() + cindex, (size_t)(cend - cindex));
+
+			AddLinesChange(pos.mLine, 1, 1);
+			while (cend-- > cindex)
+				line.erase(cindex);
 		}
-	}
 
-	mTextChanged = mTextChangedSinceLastTime = true;
-	mScrollToTop = true;
+		mTextChanged = mTextChangedSinceLastTime = true;
+		++mTextVersion;
 
-	mUndoBuffer.clear();
-	mUndoIndex = 0;
 
-	Colorize();
+		Colorize(pos.mLine, 1);
+	}
+
+	u.mAfter = mState;
+	AddUndo(u);
+	FlushTextChange();
 }
 
-void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
+void TextEditor::Backspace()
 {
 	assert(!mReadOnly);
 
-	UndoRecord u;
+	if (mLines.empty())
+		return;
 
+	UndoRecord u;
 	u.mBefore = mState;
 
 	if (HasSelection())
 	{
-		if (aChar == '\t' && mState.mSelectionStart.mLine != mState.mSelectionEnd.mLine)
+		u.mRemoved = GetSelectedText();
+		u.mRemovedStart = mState.mSelectionStart;
+		u.mRemovedEnd = mState.mSelectionEnd;
+
+		DeleteSelection();
+	}
+	else
+	{
+		u.mTextVersion = mTextVersion;
+		auto pos = GetActualCursorCoordinates();
+		SetCursorPosition(pos);
+
+		if (mState.mCursorPosition.mColumn == 0)
 		{
+			if (mState.mCursorPosition.mLine == 0)
+				return;
 
-			auto start = mState.mSelectionStart;
-			auto end = mState.mSelectionEnd;
-			auto originalEnd = end;
+			u.mRemoved = '\n';
+			u.mRemovedStart = u.mRemovedEnd = Coordinates(pos.mLine - 1, GetLineMaxColumn(pos.mLine - 1));
+			Advance(u.mRemovedEnd);
 
-			if (start > end)
-				std::swap(start, end);
-			start.mColumn = 0;
-			//			end.mColumn = end.mLine < mLines.size() ? mLines[end.mLine].size() : 0;
-			if (end.mColumn == 0 && end.mLine > 0)
-				--end.mLine;
-			if (end.mLine >= (int)mLines.size())
-				end.mLine = mLines.empty() ? 0 : (int)mLines.size() - 1;
-			end.mColumn = GetLineMaxColumn(end.mLine);
+			auto& line = mLines[mState.mCursorPosition.mLine];
+			auto& prevLine = mLines[mState.mCursorPosition.mLine - 1];
+			auto prevSize = GetLineMaxColumn(mState.mCursorPosition.mLine - 1);
+			AddLinesChange(mState.mCursorPosition.mLine - 1, 1, 1);
+			prevLine.insert(prevLine.size(), line, 0, line.size());
 
-			//if (end.mColumn >= GetLineMaxColumn(end.mLine))
-			//	end.mColumn = GetLineMaxColumn(end.mLine) - 1;
+			ErrorMarkers etmp;
+			for (auto& i : mErrorMarkers)
+				etmp.insert(ErrorMarkers::value_type(i.first - 1 == mState.mCursorPosition.mLine ? i.first - 1 : i.first, i.second));
+			mErrorMarkers = std::move(etmp);
 
-			u.mRemovedStart = start;
-			u.mRemovedEnd = end;
-			u.mRemoved = GetText(start, end);
+			RemoveLine(mState.mCursorPosition.mLine);
+			--mState.mCursorPosition.mLine;
+			mState.mCursorPosition.mColumn = prevSize;
+		}
+		else
+		{
+			auto& line = mLines[mState.mCursorPosition.mLine];
+			auto cindex = GetCharacterIndex(pos) - 1;
+			auto cend = cindex + 1;
+			while (cindex > 0 && IsUTFSequence(line[cindex].mChar))
+				--cindex;
 
-			bool modified = false;
+			//if (cindex > 0 && UTF8CharLength(line[cindex].mChar) > 1)
+			//	--cindex;
 
-			for (int i = start.mLine; i <= end.mLine; i++)
+			// same as for Delete(), the cursor can be in the middle of a tab
+			u.mRemovedStart = Coordinates(pos.mLine, GetCharacterColumn(pos.mLine, cindex));
+			u.mRemovedEnd = Coordinates(pos.mLine, GetCharacterColumn(pos.mLine, cend));
+			mState.mCursorPosition = u.mRemovedStart;
+
+			AddLinesChange(mState.mCursorPosition.mLine, 1, 1);
+			while (cindex < line.size() && cend-- > cindex)
 			{
-				auto& line = mLines[i];
-				if (aShift)
-				{
-					if (!line.empty())
-					{
-						if (line.front().mChar == '\t')
-						{
-							line.erase(line.begin());
-							modified = true;
-						}
-						else
-						{
-							for (int j = 0; j < mTabSize && !line.empty() && line.front().mChar == ' '; j++)
-							{
-								line.erase(line.begin());
-								modified = true;
-							}
-						}
-					}
-				}
-				else
-				{
-					line.insert(line.begin(), Glyph('\t', TextEditor::PaletteIndex::Background));
-					modified = true;
-				}
+				u.mRemoved += line[cindex].mChar;
+				line.erase(cindex);
 			}
+		}
 
-			if (modified)
-			{
-				start = Coordinates(start.mLine, GetCharacterColumn(start.mLine, 0));
-				Coordinates rangeEnd;
-				if (originalEnd.mColumn != 0)
-				{
-					end = Coordinates(end.mLine, GetLineMaxColumn(end.mLine));
-					rangeEnd = end;
-					u.mAdded = GetText(start, end);
-				}
-				else
-				{
-					end = Coordinates(originalEnd.mLine, 0);
-					rangeEnd = Coordinates(end.mLine - 1, GetLineMaxColumn(end.mLine - 1));
-					u.mAdded = GetText(start, rangeEnd);
-				}
+		mTextChanged = mTextChangedSinceLastTime = true;
+		++mTextVersion;
 
-				u.mAddedStart = start;
-				u.mAddedEnd = rangeEnd;
-				u.mAfter = mState;
 
-				mState.mSelectionStart = start;
-				mState.mSelectionEnd = end;
-				AddUndo(u);
+		EnsureCursorVisible();
+		Colorize(mState.mCursorPosition.mLine, 1);
+	}
+
+	u.mAfter = mState;
+	AddUndo(u);
+}
+
+void TextEditor::SelectWordUnderCursor()
+{
+	auto c = GetCursorPosition();
+	SetSelection(FindWordStart(c), FindWordEnd(c));
+}
 
-				mTextChanged = mTextChangedSinceLastTime = true;
+void TextEditor::SelectAll()
+{
+	SetSelection(Coordinates(0, 0), Coordinates((int)mLines.size(), 0));
+}
 
-				EnsureCursorVisible();
-			}
+bool TextEditor::HasSelection() const
+{
+	return mState.mSelectionEnd > mState.mSelectionStart;
+}
 
-			return;
-		} // c == '\t'
-		else
+void TextEditor::Copy()
+{
+	if (HasSelection())
+	{
+		ImGui::SetClipboardText(GetSelectedText().c_str());
+	}
+	else
+	{
+		if (!mLines.empty())
 		{
-			u.mRemoved = GetSelectedText();
-			u.mRemovedStart = mState.mSelectionStart;
-			u.mRemovedEnd = mState.mSelectionEnd;
-			DeleteSelection();
+			auto& line = mLines[GetActualCursorCoordinates().mLine];
+			std::string str(line.GetChars(), line.size());
+			ImGui::SetClipboardText(str.c_str());
 		}
-	} // HasSelection
-
-	auto coord = GetActualCursorCoordinates();
-	u.mAddedStart = coord;
-
-	assert(!mLines.empty());
+	}
+}
 
-	if (aChar == '\n')
+void TextEditor::Cut()
+{
+	if (IsReadOnly())
 	{
-		InsertLine(coord.mLine + 1);
-		auto& line = mLines[coord.mLine];
-		auto& newLine = mLines[coord.mLine + 1];
-
-		if (mLanguageDefinition.mAutoIndentation)
-			for (size_t it = 0; it < line.size() && isascii(line[it].mChar) && isblank(line[it].mChar); ++it)
-				newLine.push_back(line[it]);
-
-		const size_t whitespaceSize = newLine.size();
-		auto cindex = GetCharacterIndex(coord);
-		newLine.insert(newLine.end(), line.begin() + cindex, line.end());
-		line.erase(line.begin() + cindex, line.begin() + line.size());
-		SetCursorPosition(Coordinates(coord.mLine + 1, GetCharacterColumn(coord.mLine + 1, (int)whitespaceSize)));
-		u.mAdded = (char)aChar;
+		Copy();
 	}
 	else
 	{
-		char buf[7];
-		int e = ImTextCharToUtf8(buf, 7, aChar);
-		if (e > 0)
+		if (HasSelection())
 		{
-			buf[e] = '\0';
-			auto& line = mLines[coord.mLine];
-			auto cindex = GetCharacterIndex(coord);
+			UndoRecord u;
+			u.mBefore = mState;
+			u.mRemoved = GetSelectedText();
+			u.mRemovedStart = mState.mSelectionStart;
+			u.mRemovedEnd = mState.mSelectionEnd;
 
-			if (mOverwrite && cindex < (int)line.size())
-			{
-				auto d = UTF8CharLength(line[cindex].mChar);
+			Copy();
+			DeleteSelection();
 
-				u.mRemovedStart = mState.mCursorPosition;
-				u.mRemovedEnd = Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex + d));
+			u.mAfter = mState;
+			AddUndo(u);
+			FlushTextChange();
+		}
+	}
+}
 
-				while (d-- > 0 && cindex < (int)line.size())
-				{
-					u.mRemoved += line[cindex].mChar;
-					line.erase(line.begin() + cindex);
-				}
-			}
+void TextEditor::Paste()
+{
+	if (IsReadOnly())
+		return;
 
-			for (auto p = buf; *p != '\0'; p++, ++cindex)
-				line.insert(line.begin() + cindex, Glyph(*p, PaletteIndex::Default));
-			u.mAdded = buf;
+	auto clipText = ImGui::GetClipboardText();
+	if (clipText != nullptr && strlen(clipText) > 0)
+	{
+		UndoRecord u;
+		u.mBefore = mState;
 
-			SetCursorPosition(Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex)));
+		if (HasSelection())
+		{
+			u.mRemoved = GetSelectedText();
+			u.mRemovedStart = mState.mSelectionStart;
+			u.mRemovedEnd = mState.mSelectionEnd;
+			DeleteSelection();
 		}
-		else
-			return;
-	}
-
-	mTextChanged = mTextChangedSinceLastTime = true;
 
-	u.mAddedEnd = GetActualCursorCoordinates();
-	u.mAfter = mState;
+		u.mAdded = clipText;
+		u.mAddedStart = GetActualCursorCoordinates();
 
-	AddUndo(u);
+		InsertText(clipText);
 
-	Colorize(coord.mLine - 1, 3);
-	EnsureCursorVisible();
+		u.mAddedEnd = GetActualCursorCoordinates();
+		u.mAfter = mState;
+		AddUndo(u);
+		FlushTextChange();
+	}
 }
 
-void TextEditor::SetReadOnly(bool aValue)
+bool TextEditor::CanUndo() const
 {
-	mReadOnly = aValue;
+	return !mReadOnly && mUndoIndex > 0;
 }
 
-bool TextEditor::IsTextChangedSinceLastTime()
+bool TextEditor::CanRedo() const
 {
-	bool changed = mTextChangedSinceLastTime;
-	mTextChangedSinceLastTime = false;
-	return changed;
+	return !mReadOnly && mUndoIndex < (int)mUndoBuffer.size();
 }
 
-void TextEditor::SetColorizerEnable(bool aValue)
+void TextEditor::Undo(int aSteps)
 {
-	mColorizerEnabled = aValue;
+	while (CanUndo() && aSteps-- > 0)
+		mUndoBuffer[--mUndoIndex].Undo(this);
+	FlushTextChange();
 }
 
-void TextEditor::SetCursorPosition(const Coordinates & aPosition)
+void TextEditor::Redo(int aSteps)
 {
-	if (mState.mCursorPosition != aPosition)
-	{
-		mState.mCursorPosition = aPosition;
-		mCursorPositionChanged = true;
-		EnsureCursorVisible();
-	}
+	while (CanRedo() && aSteps-- > 0)
+		mUndoBuffer[mUndoIndex++].Redo(this);
+	FlushTextChange();
 }
 
-void TextEditor::SetSelectionStart(const Coordinates & aPosition)
+void TextEditor::SetUndoMemoryLimit(size_t aBytes)
 {
-	mState.mSelectionStart = SanitizeCoordinates(aPosition);
-	if (mState.mSelectionStart > mState.mSelectionEnd)
-		std::swap(mState.mSelectionStart, mState.mSelectionEnd);
+	mUndoMemoryLimit = aBytes;
+	TrimUndo();
 }
 
-void TextEditor::SetSelectionEnd(const Coordinates & aPosition)
+static inline char FoldCase(char c)
 {
-	mState.mSelectionEnd = SanitizeCoordinates(aPosition);
-	if (mState.mSelectionStart > mState.mSelectionEnd)
-		std::swap(mState.mSelectionStart, mState.mSelectionEnd);
+	return c >= 'A' && c <= 'Z' ? (char)(c | 0x20) : c;
 }
 
-void TextEditor::SetSelection(const Coordinates & aStart, const Coordinates & aEnd, SelectionMode aMode)
+static inline bool IsSearchWordChar(char c)
 {
-	auto oldSelStart = mState.mSelectionStart;
-	auto oldSelEnd = mState.mSelectionEnd;
-
-	mState.mSelectionStart = SanitizeCoordinates(aStart);
-	mState.mSelectionEnd = SanitizeCoordinates(aEnd);
-	if (mState.mSelectionStart > mState.mSelectionEnd)
-		std::swap(mState.mSelectionStart, mState.mSelectionEnd);
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || (c & 0x80) != 0;
+}
 
-	switch (aMode)
-	{
-	case TextEditor::SelectionMode::Normal:
-		break;
-	case TextEditor::SelectionMode::Word:
-	{
-		mState.mSelectionStart = FindWordStart(mState.mSelectionStart);
-		if (!IsOnWordBoundary(mState.mSelectionEnd))
-			mState.mSelectionEnd = FindWordEnd(FindWordStart(mState.mSelectionEnd));
-		break;
-	}
-	case TextEditor::SelectionMode::Line:
-	{
-		const auto lineNo = mState.mSelectionEnd.mLine;
-		// const auto lineSize = (size_t)lineNo < mLines.size() ? mLines[lineNo].size() : 0;
-		mState.mSelectionStart = Coordinates(mState.mSelectionStart.mLine, 0);
-		mState.mSelectionEnd = Coordinates(lineNo, GetLineMaxColumn(lineNo));
-		break;
-	}
-	default:
-		break;
-	}
+static inline bool EqualsFolded(const char* aText, const char* aNeedle, size_t aSize, bool aFoldCase)
+{
+	if (!aFoldCase)
+		return memcmp(aText, aNeedle, aSize) == 0;
 
-	if (mState.mSelectionStart != oldSelStart ||
-		mState.mSelectionEnd != oldSelEnd)
-		mCursorPositionChanged = true;
+	for (size_t i = 0; i < aSize; ++i)
+		if (FoldCase(aText[i]) != aNeedle[i])
+			return false;
+	return true;
 }
 
-void TextEditor::SetTabSize(int aValue)
+#if defined(TEXTEDITOR_SEARCH_AVX2)
+static inline __m256i FoldCase(__m256i aBytes)
 {
-	mTabSize = std::max(0, std::min(32, aValue));
+	const __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(aBytes, _mm256_set1_epi8('A' - 1)),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), aBytes));
+	return _mm256_or_si256(aBytes, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
 }
-
-void TextEditor::InsertText(const std::string & aValue)
+#elif defined(TEXTEDITOR_SEARCH_SSE2)
+static inline __m128i FoldCase(__m128i aBytes)
 {
-	InsertText(aValue.c_str());
+	const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(aBytes, _mm_set1_epi8('A' - 1)),
+		_mm_cmplt_epi8(aBytes, _mm_set1_epi8('Z' + 1)));
+	return _mm_or_si128(aBytes, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
 }
+#endif
 
-void TextEditor::InsertText(const char * aValue)
+// Returns the first position of aNeedle in aText at or after aFrom, or std::string::npos.
+// When folding case, ASCII letters of aText are lower cased before comparing and aNeedle must be lower case already.
+// Candidates are found by comparing the first and last bytes of the needle against 32 (AVX2) or 16 (SSE2) positions
+// at once, then checked byte by byte, the remaining positions are checked one at a time.
+static size_t SearchBytes(const char* aText, size_t aSize, size_t aFrom, const char* aNeedle, size_t aNeedleSize, bool aFoldCase)
 {
-	if (aValue == nullptr)
-		return;
+	if (aNeedleSize == 0 || aNeedleSize > aSize)
+		return std::string::npos;
 
-	auto pos = GetActualCursorCoordinates();
-	auto start = std::min(pos, mState.mSelectionStart);
-	int totalLines = pos.mLine - start.mLine;
+	const size_t end = aSize - aNeedleSize + 1; // one past the last possible match position
+	size_t i = aFrom;
 
-	totalLines += InsertTextAt(pos, aValue);
+#if defined(TEXTEDITOR_SEARCH_AVX2)
+	const __m256i first = _mm256_set1_epi8(aNeedle[0]);
+	const __m256i last = _mm256_set1_epi8(aNeedle[aNeedleSize - 1]);
 
-	SetSelection(pos, pos);
-	SetCursorPosition(pos);
-	Colorize(start.mLine - 1, totalLines + 2);
-}
+	for (; i + 32 <= end; i += 32)
+	{
+		__m256i firstBytes = _mm256_loadu_si256((const __m256i*)(aText + i));
+		__m256i lastBytes = _mm256_loadu_si256((const __m256i*)(aText + i + aNeedleSize - 1));
+		if (aFoldCase)
+		{
+			firstBytes = FoldCase(firstBytes);
+			lastBytes = FoldCase(lastBytes);
+		}
 
-void TextEditor::DeleteSelection()
-{
-	assert(mState.mSelectionEnd >= mState.mSelectionStart);
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(firstBytes, first), _mm256_cmpeq_epi8(lastBytes, last)));
+		for (; mask != 0; mask &= mask - 1)
+		{
+			const size_t index = i + CountTrailingZeros(mask);
+			if (EqualsFolded(aText + index, aNeedle, aNeedleSize, aFoldCase))
+				return index;
+		}
+	}
+#elif defined(TEXTEDITOR_SEARCH_SSE2)
+	const __m128i first = _mm_set1_epi8(aNeedle[0]);
+	const __m128i last = _mm_set1_epi8(aNeedle[aNeedleSize - 1]);
 
-	if (mState.mSelectionEnd == mState.mSelectionStart)
-		return;
+	for (; i + 16 <= end; i += 16)
+	{
+		__m128i firstBytes = _mm_loadu_si128((const __m128i*)(aText + i));
+		__m128i lastBytes = _mm_loadu_si128((const __m128i*)(aText + i + aNeedleSize - 1));
+		if (aFoldCase)
+		{
+			firstBytes = FoldCase(firstBytes);
+			lastBytes = FoldCase(lastBytes);
+		}
 
-	DeleteRange(mState.mSelectionStart, mState.mSelectionEnd);
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(firstBytes, first), _mm_cmpeq_epi8(lastBytes, last)));
+		for (; mask != 0; mask &= mask - 1)
+		{
+			const size_t index = i + CountTrailingZeros(mask);
+			if (EqualsFolded(aText + index, aNeedle, aNeedleSize, aFoldCase))
+				return index;
+		}
+	}
+#endif
 
-	SetSelection(mState.mSelectionStart, mState.mSelectionStart);
-	SetCursorPosition(mState.mSelectionStart);
-	Colorize(mState.mSelectionStart.mLine, 1);
+	for (; i < end; ++i)
+	{
+		if ((aFoldCase ? FoldCase(aText[i]) : aText[i]) == aNeedle[0] && EqualsFolded(aText + i, aNeedle, aNeedleSize, aFoldCase))
+			return i;
+	}
+
+	return std::string::npos;
 }
 
-void TextEditor::MoveUp(int aAmount, bool aSelect)
+void TextEditor::SetSearch(const std::string& aText, bool aCaseSensitive, bool aWholeWord)
 {
-	auto oldPos = mState.mCursorPosition;
-	mState.mCursorPosition.mLine = std::max(0, mState.mCursorPosition.mLine - aAmount);
-	if (oldPos != mState.mCursorPosition)
-	{
-		if (aSelect)
-		{
-			if (oldPos == mInteractiveStart)
-				mInteractiveStart = mState.mCursorPosition;
-			else if (oldPos == mInteractiveEnd)
-				mInteractiveEnd = mState.mCursorPosition;
-			else
-			{
-				mInteractiveStart = mState.mCursorPosition;
-				mInteractiveEnd = oldPos;
-			}
-		}
-		else
-			mInteractiveStart = mInteractiveEnd = mState.mCursorPosition;
-		SetSelection(mInteractiveStart, mInteractiveEnd);
+	mSearchText = aText;
+	mSearchNeedle = aText;
+	mSearchCaseSensitive = aCaseSensitive;
+	mSearchWholeWord = aWholeWord;
 
-		EnsureCursorVisible();
+	if (!aCaseSensitive)
+	{
+		for (auto& c : mSearchNeedle)
+			c = FoldCase(c);
 	}
 }
 
-void TextEditor::MoveDown(int aAmount, bool aSelect)
+// Returns the byte index of the first match in a line at or after aFrom, or std::string::npos.
+size_t TextEditor::FindInLine(const Line& aLine, size_t aFrom) const
 {
-	assert(mState.mCursorPosition.mColumn >= 0);
-	auto oldPos = mState.mCursorPosition;
-	mState.mCursorPosition.mLine = std::max(0, std::min((int)mLines.size() - 1, mState.mCursorPosition.mLine + aAmount));
+	const char* chars = aLine.GetChars();
+	const size_t size = aLine.size();
+	const size_t needleSize = mSearchNeedle.size();
 
-	if (mState.mCursorPosition != oldPos)
+	for (size_t index = aFrom; (index = SearchBytes(chars, size, index, mSearchNeedle.data(), needleSize, !mSearchCaseSensitive)) != std::string::npos; ++index)
 	{
-		if (aSelect)
-		{
-			if (oldPos == mInteractiveEnd)
-				mInteractiveEnd = mState.mCursorPosition;
-			else if (oldPos == mInteractiveStart)
-				mInteractiveStart = mState.mCursorPosition;
-			else
-			{
-				mInteractiveStart = oldPos;
-				mInteractiveEnd = mState.mCursorPosition;
-			}
-		}
-		else
-			mInteractiveStart = mInteractiveEnd = mState.mCursorPosition;
-		SetSelection(mInteractiveStart, mInteractiveEnd);
+		if (!mSearchWholeWord)
+			return index;
 
-		EnsureCursorVisible();
+		if ((index == 0 || !IsSearchWordChar(chars[index - 1])) && (index + needleSize == size || !IsSearchWordChar(chars[index + needleSize])))
+			return index;
 	}
+
+	return std::string::npos;
 }
 
-static bool IsUTFSequence(char c)
+void TextEditor::SelectMatch(int aLine, size_t aIndex)
 {
-	return (c & 0xC0) == 0x80;
+	const Coordinates start(aLine, GetCharacterColumn(aLine, (int)aIndex));
+	const Coordinates end(aLine, GetCharacterColumn(aLine, (int)(aIndex + mSearchNeedle.size())));
+
+	SetSelection(start, end);
+	SetCursorPosition(end);
 }
 
-void TextEditor::MoveLeft(int aAmount, bool aSelect, bool aWordMode)
+bool TextEditor::FindNext(bool aBackwards)
 {
-	if (mLines.empty())
-		return;
+	if (mSearchNeedle.empty())
+		return false;
 
-	auto oldPos = mState.mCursorPosition;
-	mState.mCursorPosition = GetActualCursorCoordinates();
-	auto line = mState.mCursorPosition.mLine;
-	auto cindex = GetCharacterIndex(mState.mCursorPosition);
+	const int lineCount = (int)mLines.size();
 
-	while (aAmount-- > 0)
+	if (!aBackwards)
 	{
-		if (cindex == 0)
+		// search after the selection, the line of the cursor is visited twice to wrap around to its start
+		const Coordinates from = HasSelection() ? mState.mSelectionEnd : GetActualCursorCoordinates();
+		const size_t fromIndex = (size_t)std::max(0, GetCharacterIndex(from));
+
+		for (int i = 0; i <= lineCount; ++i)
 		{
-			if (line > 0)
+			const int lineNo = (from.mLine + i) % lineCount;
+			const size_t index = FindInLine(mLines[lineNo], i == 0 ? fromIndex : 0);
+			if (index != std::string::npos)
 			{
-				--line;
-				if ((int)mLines.size() > line)
-					cindex = (int)mLines[line].size();
-				else
-					cindex = 0;
+				SelectMatch(lineNo, index);
+				return true;
 			}
 		}
-		else
+	}
+	else
+	{
+		// search for the last match starting before the selection
+		const Coordinates to = HasSelection() ? mState.mSelectionStart : GetActualCursorCoordinates();
+		const size_t toIndex = (size_t)std::max(0, GetCharacterIndex(to));
+
+		for (int i = 0; i <= lineCount; ++i)
 		{
-			--cindex;
-			if (cindex > 0)
+			const int lineNo = ((to.mLine - i) % lineCount + lineCount) % lineCount;
+			const size_t limit = i == 0 ? toIndex : std::string::npos;
+			size_t found = std::string::npos;
+
+			for (size_t index = FindInLine(mLines[lineNo], 0); index < limit; index = FindInLine(mLines[lineNo], index + 1))
+				found = index;
+
+			if (found != std::string::npos)
 			{
-				if ((int)mLines.size() > line)
-				{
-					while (cindex > 0 && IsUTFSequence(mLines[line][cindex].mChar))
-						--cindex;
-				}
+				SelectMatch(lineNo, found);
+				return true;
 			}
 		}
-
-		mState.mCursorPosition = Coordinates(line, GetCharacterColumn(line, cindex));
-		if (aWordMode)
-		{
-			mState.mCursorPosition = FindWordStart(mState.mCursorPosition);
-			cindex = GetCharacterIndex(mState.mCursorPosition);
-		}
 	}
 
-	mState.mCursorPosition = Coordinates(line, GetCharacterColumn(line, cindex));
+	return false;
+}
 
-	assert(mState.mCursorPosition.mColumn >= 0);
-	if (aSelect)
+int TextEditor::ReplaceAll(const std::string& aReplacement)
+{
+	if (mReadOnly || mSearchNeedle.empty())
+		return 0;
+
+	const int lineCount = (int)mLines.size();
+	const size_t needleSize = mSearchNeedle.size();
+
+	int firstLine = 0;
+	while (firstLine < lineCount && FindInLine(mLines[firstLine], 0) == std::string::npos)
+		++firstLine;
+
+	if (firstLine == lineCount)
+		return 0;
+
+	int lastLine = lineCount - 1;
+	while (lastLine > firstLine && FindInLine(mLines[lastLine], 0) == std::string::npos)
+		--lastLine;
+
+	// build the new text of all the lines between the first and last match, replaced as a single block
+	std::string replaced;
+	int count = 0;
+
+	for (int lineNo = firstLine; lineNo <= lastLine; ++lineNo)
 	{
-		if (oldPos == mInteractiveStart)
-			mInteractiveStart = mState.mCursorPosition;
-		else if (oldPos == mInteractiveEnd)
-			mInteractiveEnd = mState.mCursorPosition;
-		else
+		const Line& line = mLines[lineNo];
+		const char* chars = line.GetChars();
+		size_t copied = 0;
+
+		for (size_t index = FindInLine(line, 0); index != std::string::npos; index = FindInLine(line, index + needleSize))
 		{
-			mInteractiveStart = mState.mCursorPosition;
-			mInteractiveEnd = oldPos;
+			replaced.append(chars + copied, index - copied);
+			replaced += aReplacement;
+			copied = index + needleSize;
+			++count;
 		}
+
+		replaced.append(chars + copied, line.size() - copied);
+
+		if (lineNo != lastLine)
+			replaced += '\n';
 	}
-	else
-		mInteractiveStart = mInteractiveEnd = mState.mCursorPosition;
-	SetSelection(mInteractiveStart, mInteractiveEnd, aSelect && aWordMode ? SelectionMode::Word : SelectionMode::Normal);
 
-	EnsureCursorVisible();
+	UndoRecord u;
+	u.mBefore = mState;
+	u.mRemovedStart = Coordinates(firstLine, 0);
+	u.mRemovedEnd = Coordinates(lastLine, GetLineMaxColumn(lastLine));
+	u.mRemoved = GetText(u.mRemovedStart, u.mRemovedEnd);
+
+	DeleteRange(u.mRemovedStart, u.mRemovedEnd);
+
+	auto where = u.mRemovedStart;
+	const int addedLines = InsertTextAt(where, replaced.c_str());
+
+	u.mAddedStart = u.mRemovedStart;
+	u.mAddedEnd = Coordinates(firstLine + addedLines, GetLineMaxColumn(firstLine + addedLines));
+	u.mAdded = std::move(replaced);
+
+	const auto cursor = SanitizeCoordinates(mState.mCursorPosition);
+	SetSelection(cursor, cursor);
+	SetCursorPosition(cursor);
+	Colorize(firstLine - 1, addedLines + 2);
+
+	u.mAfter = mState;
+	AddUndo(u);
+	FlushTextChange();
+
+	return count;
 }
 
-void TextEditor::MoveRight(int aAmount, bool aSelect, bool aWordMode)
+const TextEditor::Palette & TextEditor::GetDarkPalette()
 {
-	auto oldPos = mState.mCursorPosition;
+	const static Palette p = { {
+			0xff7f7f7f,	// Default
+			0xffd69c56,	// Keyword
+			0xff00ff00,	// Number
+			0xff7070e0,	// String
+			0xff70a0e0, // Char literal
+			0xffffffff, // Punctuation
+			0xff408080,	// Preprocessor
+			0xffaaaaaa, // Identifier
+			0xff9bc64d, // Known identifier
+			0xffc040a0, // Preproc identifier
+			0xff206020, // Comment (single line)
+			0xff406020, // Comment (multi line)
+			0xff101010, // Background
+			0xffe0e0e0, // Cursor
+			0x80a06020, // Selection
+			0x800020ff, // ErrorMarker
+			0x40f08000, // Breakpoint
+			0xff707000, // Line number
+			0x40000000, // Current line fill
+			0x40808080, // Current line fill (inactive)
+			0x40a0a0a0, // Current line edge
+			0x6000a0ff, // Search match
+		} };
+	return p;
+}
 
-	if (mLines.empty() || oldPos.mLine >= mLines.size())
-		return;
+const TextEditor::Palette & TextEditor::GetLightPalette()
+{
+	const static Palette p = { {
+			0xff7f7f7f,	// None
+			0xffff0c06,	// Keyword
+			0xff008000,	// Number
+			0xff2020a0,	// String
+			0xff304070, // Char literal
+			0xff000000, // Punctuation
+			0xff406060,	// Preprocessor
+			0xff404040, // Identifier
+			0xff606010, // Known identifier
+			0xffc040a0, // Preproc identifier
+			0xff205020, // Comment (single line)
+			0xff405020, // Comment (multi line)
+			0xffffffff, // Background
+			0xff000000, // Cursor
+			0x80600000, // Selection
+			0xa00010ff, // ErrorMarker
+			0x80f08000, // Breakpoint
+			0xff505000, // Line number
+			0x40000000, // Current line fill
+			0x40808080, // Current line fill (inactive)
+			0x40000000, // Current line edge
+			0x6000c0ff, // Search match
+		} };
+	return p;
+}
 
-	auto cindex = GetCharacterIndex(mState.mCursorPosition);
-	while (aAmount-- > 0)
+const TextEditor::Palette & TextEditor::GetRetroBluePalette()
+{
+	const static Palette p = { {
+			0xff00ffff,	// None
+			0xffffff00,	// Keyword
+			0xff00ff00,	// Number
+			0xff808000,	// String
+			0xff808000, // Char literal
+			0xffffffff, // Punctuation
+			0xff008000,	// Preprocessor
+			0xff00ffff, // Identifier
+			0xffffffff, // Known identifier
+			0xffff00ff, // Preproc identifier
+			0xff808080, // Comment (single line)
+			0xff404040, // Comment (multi line)
+			0xff800000, // Background
+			0xff0080ff, // Cursor
+			0x80ffff00, // Selection
+			0xa00000ff, // ErrorMarker
+			0x80ff8000, // Breakpoint
+			0xff808000, // Line number
+			0x40000000, // Current line fill
+			0x40808080, // Current line fill (inactive)
+			0x40000000, // Current line edge
+			0x6000c0ff, // Search match
+		} };
+	return p;
+}
+
+
+std::string TextEditor::GetText() const
+{
+	return GetText(Coordinates(), Coordinates((int)mLines.size(), 0));
+}
+
+bool TextEditor::WriteText(WriteCallback aWrite, void * aUserData) const
+{
+	// short lines are gathered in a buffer, so aWrite is not called for every single line
+	static const size_t kBufferSize = 64 * 1024;
+	std::string buffer;
+	buffer.reserve(kBufferSize);
+
+	for (size_t i = 0, count = mLines.size(); i < count; ++i)
 	{
-		auto lindex = mState.mCursorPosition.mLine;
-		auto& line = mLines[lindex];
+		auto& line = mLines[i];
 
-		if (cindex >= line.size())
+		if (!buffer.empty() && buffer.size() + line.size() >= kBufferSize)
 		{
-			if (mState.mCursorPosition.mLine < mLines.size() - 1)
-			{
-				mState.mCursorPosition.mLine = std::max(0, std::min((int)mLines.size() - 1, mState.mCursorPosition.mLine + 1));
-				mState.mCursorPosition.mColumn = 0;
-			}
-			else
-				return;
+			if (!aWrite(buffer.data(), buffer.size(), aUserData))
+				return false;
+			buffer.clear();
+		}
+
+		if (line.size() >= kBufferSize)
+		{
+			if (!aWrite(line.GetChars(), line.size(), aUserData))
+				return false;
 		}
 		else
 		{
-			cindex += UTF8CharLength(line[cindex].mChar);
-			mState.mCursorPosition = Coordinates(lindex, GetCharacterColumn(lindex, cindex));
-			if (aWordMode)
-				mState.mCursorPosition = FindNextWord(mState.mCursorPosition);
+			buffer.append(line.GetChars(), line.size());
 		}
+
+		if (i + 1 < count)
+			buffer += '\n';
 	}
 
-	if (aSelect)
+	return buffer.empty() || aWrite(buffer.data(), buffer.size(), aUserData);
+}
+
+std::vector<std::string> TextEditor::GetTextLines() const
+{
+	std::vector<std::string> result;
+
+	result.reserve(mLines.size());
+
+	for (auto & line : mLines)
 	{
-		if (oldPos == mInteractiveEnd)
-			mInteractiveEnd = SanitizeCoordinates(mState.mCursorPosition);
-		else if (oldPos == mInteractiveStart)
-			mInteractiveStart = mState.mCursorPosition;
-		else
-		{
-			mInteractiveStart = oldPos;
-			mInteractiveEnd = mState.mCursorPosition;
-		}
+		result.emplace_back(line.GetChars(), line.size());
 	}
-	else
-		mInteractiveStart = mInteractiveEnd = mState.mCursorPosition;
-	SetSelection(mInteractiveStart, mInteractiveEnd, aSelect && aWordMode ? SelectionMode::Word : SelectionMode::Normal);
 
-	EnsureCursorVisible();
+	return result;
+}
+
+std::string TextEditor::GetSelectedText() const
+{
+	return GetText(mState.mSelectionStart, mState.mSelectionEnd);
+}
+
+std::string TextEditor::GetCurrentLineText()const
+{
+	auto lineLength = GetLineMaxColumn(mState.mCursorPosition.mLine);
+	return GetText(
+		Coordinates(mState.mCursorPosition.mLine, 0),
+		Coordinates(mState.mCursorPosition.mLine, lineLength));
+}
+
+void TextEditor::ProcessInputs()
+{
 }
 
-void TextEditor::MoveTop(bool aSelect)
+void TextEditor::Colorize(int aFromLine, int aLines)
 {
-	auto oldPos = mState.mCursorPosition;
-	SetCursorPosition(Coordinates(0, 0));
+	int toLine = aLines == -1 ? (int)mLines.size() : std::min((int)mLines.size(), aFromLine + aLines);
+	mColorRangeMin = std::min(mColorRangeMin, aFromLine);
+	mColorRangeMax = std::max(mColorRangeMax, toLine);
+	mColorRangeMin = std::max(0, mColorRangeMin);
+	mColorRangeMax = std::max(mColorRangeMin, mColorRangeMax);
+	mCheckComments = true;
+}
 
-	if (mState.mCursorPosition != oldPos)
-	{
-		if (aSelect)
-		{
-			mInteractiveEnd = oldPos;
-			mInteractiveStart = mState.mCursorPosition;
-		}
-		else
-			mInteractiveStart = mInteractiveEnd = mState.mCursorPosition;
-		SetSelection(mInteractiveStart, mInteractiveEnd);
-	}
+void TextEditor::ColorizeRange(int aFromLine, int aToLine)
+{
+	const int endLine = std::max(0, std::min((int)mLines.size(), aToLine));
+	if (mLines.empty() || aFromLine >= endLine)
+		return;
+
+	ColorizeSnapshot snapshot;
+	TakeSnapshot(snapshot, aFromLine, endLine);
+	ColorizeTokens(*mLanguageDefinition, mTokenScanner.get(), *mRegexList, *mWordTable, snapshot, aFromLine, endLine);
+	ApplySnapshot(snapshot, aFromLine, endLine);
 }
 
-void TextEditor::TextEditor::MoveBottom(bool aSelect)
+void TextEditor::TakeSnapshot(ColorizeSnapshot& aSnapshot, int aFromLine, int aToLine) const
 {
-	auto oldPos = GetCursorPosition();
-	auto newPos = Coordinates((int)mLines.size() - 1, 0);
-	SetCursorPosition(newPos);
-	if (aSelect)
+	aSnapshot.mFirstLine = aFromLine;
+	aSnapshot.mLineStarts.resize(aToLine - aFromLine + 1);
+	aSnapshot.mStates.resize(aToLine - aFromLine + 1);
+
+	size_t size = 0;
+	for (int i = aFromLine; i < aToLine; ++i)
 	{
-		mInteractiveStart = oldPos;
-		mInteractiveEnd = newPos;
+		aSnapshot.mLineStarts[i - aFromLine] = size;
+		aSnapshot.mStates[i - aFromLine] = (uint8_t)mLines[i].mCommentState;
+		size += mLines[i].size();
 	}
-	else
-		mInteractiveStart = mInteractiveEnd = newPos;
-	SetSelection(mInteractiveStart, mInteractiveEnd);
-}
+	aSnapshot.mLineStarts.back() = size;
 
-void TextEditor::MoveHome(bool aSelect)
-{
-	auto oldPos = mState.mCursorPosition;
-	SetCursorPosition(Coordinates(mState.mCursorPosition.mLine, 0));
+	// a line moved up to the top keeps its state from before
+	if (aFromLine == 0)
+		aSnapshot.mStates[0] = 0;
 
-	if (mState.mCursorPosition != oldPos)
+	aSnapshot.mChars.resize(size);
+	aSnapshot.mInfo.resize(size);
+
+	char * chars = &aSnapshot.mChars[0];
+	uint8_t * info = aSnapshot.mInfo.data();
+
+	for (int i = aFromLine; i < aToLine; ++i)
 	{
-		if (aSelect)
-		{
-			if (oldPos == mInteractiveStart)
-				mInteractiveStart = mState.mCursorPosition;
-			else if (oldPos == mInteractiveEnd)
-				mInteractiveEnd = mState.mCursorPosition;
-			else
-			{
-				mInteractiveStart = mState.mCursorPosition;
-				mInteractiveEnd = oldPos;
-			}
-		}
-		else
-			mInteractiveStart = mInteractiveEnd = mState.mCursorPosition;
-		SetSelection(mInteractiveStart, mInteractiveEnd);
+		auto& line = mLines[i];
+		if (line.empty())
+			continue;
+		memcpy(chars, line.GetChars(), line.size());
+		memcpy(info, line.GetInfo(), line.size());
+		chars += line.size();
+		info += line.size();
 	}
 }
 
-void TextEditor::MoveEnd(bool aSelect)
+void TextEditor::ApplySnapshot(const ColorizeSnapshot& aSnapshot, int aFromLine, int aToLine)
 {
-	auto oldPos = mState.mCursorPosition;
-	SetCursorPosition(Coordinates(mState.mCursorPosition.mLine, GetLineMaxColumn(oldPos.mLine)));
-
-	if (mState.mCursorPosition != oldPos)
+	for (int i = aFromLine; i < aToLine; ++i)
 	{
-		if (aSelect)
-		{
-			if (oldPos == mInteractiveEnd)
-				mInteractiveEnd = mState.mCursorPosition;
-			else if (oldPos == mInteractiveStart)
-				mInteractiveStart = mState.mCursorPosition;
-			else
-			{
-				mInteractiveStart = oldPos;
-				mInteractiveEnd = mState.mCursorPosition;
-			}
-		}
-		else
-			mInteractiveStart = mInteractiveEnd = mState.mCursorPosition;
-		SetSelection(mInteractiveStart, mInteractiveEnd);
+		auto& line = mLines[i];
+		const uint8_t * info = aSnapshot.mInfo.data() + aSnapshot.mLineStarts[i - aSnapshot.mFirstLine];
+
+		if (!line.empty())
+			memcpy(line.GetInfo(), info, line.size());
+		line.mCommentState = aSnapshot.mStates[i - aSnapshot.mFirstLine];
 	}
 }
 
-void TextEditor::Delete()
+void TextEditor::ColorizeTokens(const LanguageDefinition& aLanguage, const TokenScanner* aTokenScanner, const RegexList& aRegexList, const WordTable& aWordTable, ColorizeSnapshot& aSnapshot, int aFromLine, int aToLine)
 {
-	assert(!mReadOnly);
+	std::cmatch results;
 
-	if (mLines.empty())
-		return;
+	for (int i = aFromLine; i < aToLine; ++i)
+	{
+		const size_t lineStart = aSnapshot.mLineStarts[i - aSnapshot.mFirstLine];
+		const size_t lineEnd = aSnapshot.mLineStarts[i - aSnapshot.mFirstLine + 1];
 
-	UndoRecord u;
-	u.mBefore = mState;
+		if (lineStart == lineEnd)
+			continue;
 
-	if (HasSelection())
-	{
-		u.mRemoved = GetSelectedText();
-		u.mRemovedStart = mState.mSelectionStart;
-		u.mRemovedEnd = mState.mSelectionEnd;
+		uint8_t * info = aSnapshot.mInfo.data() + lineStart;
 
-		DeleteSelection();
-	}
-	else
-	{
-		auto pos = GetActualCursorCoordinates();
-		SetCursorPosition(pos);
-		auto& line = mLines[pos.mLine];
+		for (size_t j = 0; j < lineEnd - lineStart; ++j)
+			info[j] &= ~Line::kColorMask;
 
-		if (pos.mColumn == GetLineMaxColumn(pos.mLine))
-		{
-			if (pos.mLine == (int)mLines.size() - 1)
-				return;
+		const char * bufferBegin = aSnapshot.mChars.data() + lineStart;
+		const char * bufferEnd = aSnapshot.mChars.data() + lineEnd;
 
-			u.mRemoved = '\n';
-			u.mRemovedStart = u.mRemovedEnd = GetActualCursorCoordinates();
-			Advance(u.mRemovedEnd);
+		auto last = bufferEnd;
 
-			auto& nextLine = mLines[pos.mLine + 1];
-			line.insert(line.end(), nextLine.begin(), nextLine.end());
-			RemoveLine(pos.mLine + 1);
-		}
-		else
+		for (auto first = bufferBegin; first != last; )
 		{
-			auto cindex = GetCharacterIndex(pos);
-			u.mRemovedStart = u.mRemovedEnd = GetActualCursorCoordinates();
-			u.mRemovedEnd.mColumn++;
-			u.mRemoved = GetText(u.mRemovedStart, u.mRemovedEnd);
+			const char * token_begin = nullptr;
+			const char * token_end = nullptr;
+			PaletteIndex token_color = PaletteIndex::Default;
 
-			auto d = UTF8CharLength(line[cindex].mChar);
-			while (d-- > 0 && cindex < (int)line.size())
-				line.erase(line.begin() + cindex);
-		}
+			bool hasTokenizeResult = false;
 
-		mTextChanged = mTextChangedSinceLastTime = true;
+			if (aLanguage.mTokenize != nullptr)
+			{
+				if (aLanguage.mTokenize(first, last, token_begin, token_end, token_color))
+					hasTokenizeResult = true;
+			}
 
-		Colorize(pos.mLine, 1);
-	}
+			if (hasTokenizeResult == false)
+			{
+				// todo : remove
+				//printf("using regex for %.*s\n", first + 10 < last ? 10 : int(last - first), first);
 
-	u.mAfter = mState;
-	AddUndo(u);
-}
+				if (aTokenScanner != nullptr)
+				{
+					if (aTokenScanner->Match(first, last, token_end, token_color))
+					{
+						hasTokenizeResult = true;
+						token_begin = first;
+					}
+				}
+				else
+				{
+					for (auto& p : aRegexList)
+					{
+						if (std::regex_search(first, last, results, p.first, std::regex_constants::match_continuous))
+						{
+							hasTokenizeResult = true;
 
-void TextEditor::Backspace()
-{
-	assert(!mReadOnly);
+							auto& v = *results.begin();
+							token_begin = v.first;
+							token_end = v.second;
+							token_color = p.second;
+							break;
+						}
+					}
+				}
+			}
 
-	if (mLines.empty())
-		return;
+			if (hasTokenizeResult == false)
+			{
+				first++;
+			}
+			else
+			{
+				const size_t token_length = token_end - token_begin;
 
-	UndoRecord u;
-	u.mBefore = mState;
+				if (token_color == PaletteIndex::Identifier)
+				{
+					// todo : allmost all language definitions use lower case to specify keywords, so shouldn't this use ::tolower ?
+					const PaletteIndex wordColor = aWordTable.Find(token_begin, token_end, (info[first - bufferBegin] & Line::kPreprocessor) != 0);
+					if (wordColor != PaletteIndex::Max)
+						token_color = wordColor;
+				}
 
-	if (HasSelection())
-	{
-		u.mRemoved = GetSelectedText();
-		u.mRemovedStart = mState.mSelectionStart;
-		u.mRemovedEnd = mState.mSelectionEnd;
+				for (size_t j = 0; j < token_length; ++j)
+				{
+					auto& tokenInfo = info[(token_begin - bufferBegin) + j];
+					tokenInfo = (tokenInfo & ~Line::kColorMask) | (uint8_t)token_color;
+				}
 
-		DeleteSelection();
+				first = token_end;
+			}
+		}
 	}
-	else
-	{
-		auto pos = GetActualCursorCoordinates();
-		SetCursorPosition(pos);
-
-		if (mState.mCursorPosition.mColumn == 0)
-		{
-			if (mState.mCursorPosition.mLine == 0)
-				return;
-
-			u.mRemoved = '\n';
-			u.mRemovedStart = u.mRemovedEnd = Coordinates(pos.mLine - 1, GetLineMaxColumn(pos.mLine - 1));
-			Advance(u.mRemovedEnd);
+}
 
-			auto& line = mLines[mState.mCursorPosition.mLine];
-			auto& prevLine = mLines[mState.mCursorPosition.mLine - 1];
-			auto prevSize = GetLineMaxColumn(mState.mCursorPosition.mLine - 1);
-			prevLine.insert(prevLine.end(), line.begin(), line.end());
+static void SetColorizeFlag(uint8_t& aInfo, uint8_t aFlag, bool aValue)
+{
+	aInfo = aValue ? (aInfo | aFlag) : (aInfo & ~aFlag);
+}
 
-			ErrorMarkers etmp;
-			for (auto& i : mErrorMarkers)
-				etmp.insert(ErrorMarkers::value_type(i.first - 1 == mState.mCursorPosition.mLine ? i.first - 1 : i.first, i.second));
-			mErrorMarkers = std::move(etmp);
+// State of the comment scanner in between lines, see Line::mCommentState. The single line comment, preprocessor
+// and first character flags only carry over to the next line after a '\' on the very end of a line.
+static const uint8_t kCommentStateComment = 0x01;
+static const uint8_t kCommentStateString = 0x02;
+static const uint8_t kCommentStateConcatenate = 0x04;
+static const uint8_t kCommentStateSingleLineComment = 0x08;
+static const uint8_t kCommentStatePreprocessor = 0x10;
+static const uint8_t kCommentStateFirstChar = 0x20;
+
+// Scans the lines [aFromLine, aToLine) of a snapshot from the state at the start of the first one,
+// setting the state at the start of each following line.
+void TextEditor::ColorizeComments(const LanguageDefinition& aLanguage, ColorizeSnapshot& aSnapshot, int aFromLine, int aToLine)
+{
+	const int noComment = std::numeric_limits<int>::max();
 
-			RemoveLine(mState.mCursorPosition.mLine);
-			--mState.mCursorPosition.mLine;
-			mState.mCursorPosition.mColumn = prevSize;
-		}
-		else
+	for (int currentLine = aFromLine; currentLine < aToLine; ++currentLine)
+	{
+		const int lineIndex = currentLine - aSnapshot.mFirstLine;
+		const size_t lineStart = aSnapshot.mLineStarts[lineIndex];
+		const int lineSize = (int)(aSnapshot.mLineStarts[lineIndex + 1] - lineStart);
+		const char * line = aSnapshot.mChars.data() + lineStart;
+		uint8_t * info = aSnapshot.mInfo.data() + lineStart;
+
+		const uint8_t state = aSnapshot.mStates[lineIndex];
+		auto commentStartIndex = (state & kCommentStateComment) != 0 ? -1 : noComment;
+		auto withinString = (state & kCommentStateString) != 0;
+		auto concatenate = (state & kCommentStateConcatenate) != 0;	// '\' on the very end of the line before, then of this one
+		auto withinSingleLineComment = concatenate && (state & kCommentStateSingleLineComment) != 0;
+		auto withinPreproc = concatenate && (state & kCommentStatePreprocessor) != 0;
+		auto firstChar = !concatenate || (state & kCommentStateFirstChar) != 0;	// there is no other non-whitespace characters in the line before
+
+		concatenate = false;
+
+		for (int currentIndex = 0; currentIndex < lineSize; )
 		{
-			auto& line = mLines[mState.mCursorPosition.mLine];
-			auto cindex = GetCharacterIndex(pos) - 1;
-			auto cend = cindex + 1;
-			while (cindex > 0 && IsUTFSequence(line[cindex].mChar))
-				--cindex;
+			auto c = (Char)line[currentIndex];
 
-			//if (cindex > 0 && UTF8CharLength(line[cindex].mChar) > 1)
-			//	--cindex;
+			if (c != aLanguage.mPreprocChar && !isspace(c))
+				firstChar = false;
 
-			u.mRemovedStart = u.mRemovedEnd = GetActualCursorCoordinates();
-			--u.mRemovedStart.mColumn;
-			--mState.mCursorPosition.mColumn;
+			if (currentIndex == lineSize - 1 && line[lineSize - 1] == '\\')
+				concatenate = true;
 
-			while (cindex < line.size() && cend-- > cindex)
+			bool inComment = commentStartIndex <= currentIndex;
+
+			if (withinString)
 			{
-				u.mRemoved += line[cindex].mChar;
-				line.erase(line.begin() + cindex);
+				SetColorizeFlag(info[currentIndex], Line::kMultiLineComment, inComment);
+
+				if (c == '\"')
+				{
+					if (currentIndex + 1 < lineSize && line[currentIndex + 1] == '\"')
+					{
+						currentIndex += 1;
+						if (currentIndex < lineSize)
+							SetColorizeFlag(info[currentIndex], Line::kMultiLineComment, inComment);
+					}
+					else
+						withinString = false;
+				}
+				else if (c == '\\')
+				{
+					currentIndex += 1;
+					if (currentIndex < lineSize)
+						SetColorizeFlag(info[currentIndex], Line::kMultiLineComment, inComment);
+				}
 			}
-		}
+			else
+			{
+				if (firstChar && c == aLanguage.mPreprocChar)
+					withinPreproc = true;
 
-		mTextChanged = mTextChangedSinceLastTime = true;
+				if (c == '\"')
+				{
+					withinString = true;
+					SetColorizeFlag(info[currentIndex], Line::kMultiLineComment, inComment);
+				}
+				else
+				{
+					auto pred = [](const char& a, const char& b) { return a == b; };
+					auto from = line + currentIndex;
+					auto& startStr = aLanguage.mCommentStart;
+					auto& singleStartStr = aLanguage.mSingleLineComment;
+
+					if (singleStartStr.size() > 0 &&
+						currentIndex + singleStartStr.size() <= (size_t)lineSize &&
+						equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
+					{
+						if (currentIndex + startStr.size() > (size_t)lineSize)
+						{
+							withinSingleLineComment = true;
+						}
+						else if (!equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
+						{
+							withinSingleLineComment = true;
+						}
+					}
+					else if (!withinSingleLineComment && currentIndex + startStr.size() <= (size_t)lineSize &&
+						equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
+					{
+						commentStartIndex = currentIndex;
+					}
+
+					inComment = commentStartIndex <= currentIndex;
+
+					SetColorizeFlag(info[currentIndex], Line::kMultiLineComment, inComment);
+					SetColorizeFlag(info[currentIndex], Line::kComment, withinSingleLineComment);
+
+					auto& endStr = aLanguage.mCommentEnd;
+					if (currentIndex + 1 >= (int)endStr.size() &&
+						equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
+					{
+						commentStartIndex = noComment;
+					}
+				}
+			}
+			if (currentIndex < lineSize)
+				SetColorizeFlag(info[currentIndex], Line::kPreprocessor, withinPreproc);
+			currentIndex += UTF8CharLength(c);
+		}
 
-		EnsureCursorVisible();
-		Colorize(mState.mCursorPosition.mLine, 1);
+		uint8_t nextState = 0;
+		if (commentStartIndex != noComment)
+			nextState |= kCommentStateComment;
+		if (withinString)
+			nextState |= kCommentStateString;
+		if (concatenate)
+		{
+			nextState |= kCommentStateConcatenate;
+			if (withinSingleLineComment)
+				nextState |= kCommentStateSingleLineComment;
+			if (withinPreproc)
+				nextState |= kCommentStatePreprocessor;
+			if (firstChar)
+				nextState |= kCommentStateFirstChar;
+		}
+		aSnapshot.mStates[lineIndex + 1] = nextState;
 	}
-
-	u.mAfter = mState;
-	AddUndo(u);
 }
 
-void TextEditor::SelectWordUnderCursor()
+void TextEditor::ColorizeInternal()
 {
-	auto c = GetCursorPosition();
-	SetSelection(FindWordStart(c), FindWordEnd(c));
-}
+	if (mLines.empty() || !mColorizerEnabled)
+		return;
 
-void TextEditor::SelectAll()
-{
-	SetSelection(Coordinates(0, 0), Coordinates((int)mLines.size(), 0));
-}
+	if (mLanguageDefinition->mColorize && (mCheckComments || mColorRangeMin < mColorRangeMax))
+	{
+		mCheckComments = false;
+		mColorRangeMin = std::numeric_limits<int>::max();
+		mColorRangeMax = 0;
+		return mLanguageDefinition->mColorize(mLines, mLanguageDefinition->mColorizeData);
+	}
 
-bool TextEditor::HasSelection() const
-{
-	return mState.mSelectionEnd > mState.mSelectionStart;
-}
+#ifndef TEXTEDITOR_NO_THREADS
+	if (mColorizerThreaded)
+		return ColorizeThreaded();
+#endif
 
-void TextEditor::Copy()
-{
-	if (HasSelection())
+	if (mCheckComments)
 	{
-		ImGui::SetClipboardText(GetSelectedText().c_str());
+		ColorizeSnapshot snapshot;
+		TakeSnapshot(snapshot, 0, (int)mLines.size());
+		ColorizeComments(*mLanguageDefinition, snapshot, 0, (int)mLines.size());
+		ApplySnapshot(snapshot, 0, (int)mLines.size());
+		mCheckComments = false;
 	}
-	else
+
+	if (mColorRangeMin < mColorRangeMax)
 	{
-		if (!mLines.empty())
+		const int increment = (mLanguageDefinition->mTokenize == nullptr && mTokenScanner == nullptr) ? 10 : 10000;
+		const int to = std::min(mColorRangeMin + increment, mColorRangeMax);
+		ColorizeRange(mColorRangeMin, to);
+		mColorRangeMin = to;
+
+		if (mColorRangeMax == mColorRangeMin)
 		{
-			std::string str;
-			auto& line = mLines[GetActualCursorCoordinates().mLine];
-			for (auto& g : line)
-				str.push_back(g.mChar);
-			ImGui::SetClipboardText(str.c_str());
+			mColorRangeMin = std::numeric_limits<int>::max();
+			mColorRangeMax = 0;
 		}
+		return;
 	}
 }
 
-void TextEditor::Cut()
+#ifndef TEXTEDITOR_NO_THREADS
+void TextEditor::ColorizeThreaded()
 {
-	if (IsReadOnly())
+	if (mColorizeWorker == nullptr)
+		mColorizeWorker.reset(new ColorizeWorker());
+
+	ColorizeWorker& worker(*mColorizeWorker);
+	const int totalLines = (int)mLines.size();
+
+	// lines visible with the current scroll position, word wrapped lines can take more than one row
+	const float lineHeight = ImGui::GetTextLineHeightWithSpacing() * mLineSpacing;
+	int firstVisible = (int)floor(ImGui::GetScrollY() / lineHeight);
+	if (mWordWrap)
 	{
-		Copy();
+		int rowInLine;
+		firstVisible = mWrapIndex.FindLine(firstVisible, rowInLine);
 	}
-	else
+	firstVisible = std::max(0, std::min(totalLines, firstVisible));
+	const int lastVisible = std::min(totalLines, firstVisible + (int)ceil(ImGui::GetWindowHeight() / lineHeight) + 1);
+
+	// lines to scan for comments only, left over by the last job
+	int commentFrom = std::numeric_limits<int>::max();
+	int commentTo = 0;
+
+	if (worker.mActive != nullptr)
 	{
-		if (HasSelection())
+		ColorizeJob& job(*worker.mActive);
+		const ColorizeSnapshot& snapshot(job.mSnapshot);
+		const int jobFrom = snapshot.mFirstLine;
+		const int jobTo = jobFrom + (int)snapshot.mLineStarts.size() - 1;
+
+		std::lock_guard<std::mutex> lock(worker.mMutex);
+
+		if (job.mDone || mColorRangeMin < mColorRangeMax)
 		{
-			UndoRecord u;
-			u.mBefore = mState;
-			u.mRemoved = GetSelectedText();
-			u.mRemovedStart = mState.mSelectionStart;
-			u.mRemovedEnd = mState.mSelectionEnd;
+			// the job is done or replaced by one for newer edits, either way its results are kept
+			ApplyColorizeJob(job, jobFrom, jobTo);
 
-			Copy();
-			DeleteSelection();
+			// and the lines it did not get to are queued again
+			int colorFrom = job.mColorTo;
+			int colorTo = job.mColorFrom;
+			for (int i = job.mColorFrom; i < job.mColorTo; ++i)
+			{
+				if (!job.mReady[i - jobFrom])
+				{
+					colorFrom = std::min(colorFrom, i);
+					colorTo = i + 1;
+				}
+			}
+			commentFrom = job.mScannedTo;
+			commentTo = jobTo;
 
-			u.mAfter = mState;
-			AddUndo(u);
+			// when the state after the last line changed, the lines below need to be scanned too, as many as it takes
+			const int nextLine = job.FindLine(jobTo);
+			if (job.mScannedTo == jobTo && nextLine >= 0 && nextLine < totalLines && snapshot.mStates.back() != mLines[nextLine].mCommentState)
+			{
+				commentFrom = jobTo;
+				commentTo = jobTo + std::max(kColorizeFollowLines, 2 * (jobTo - jobFrom));
+			}
+
+			if (job.mChangeFirst >= 0)
+			{
+				const int removed = job.mChangeOldEnd - job.mChangeFirst;
+				const int added = job.mChangeNewEnd - job.mChangeFirst;
+				ShiftLineRange(colorFrom, colorTo, job.mChangeFirst, removed, added);
+				ShiftLineRange(commentFrom, commentTo, job.mChangeFirst, removed, added);
+			}
+
+			if (colorFrom < colorTo)
+				Colorize(colorFrom, colorTo - colorFrom);
+
+			worker.mActive.reset();
+		}
+		else
+		{
+			// visible lines are shown as soon as they are ready
+			ApplyColorizeJob(job, std::max(jobFrom, firstVisible), std::min(jobTo, lastVisible));
 		}
 	}
-}
-
-void TextEditor::Paste()
-{
-	if (IsReadOnly())
-		return;
 
-	auto clipText = ImGui::GetClipboardText();
-	if (clipText != nullptr && strlen(clipText) > 0)
+	if (worker.mActive == nullptr && (mColorRangeMin < mColorRangeMax || commentFrom < commentTo))
 	{
-		UndoRecord u;
-		u.mBefore = mState;
+		// the lines to tokenize are scanned for comments too, along with the ones in between
+		const int colorFrom = std::min(mColorRangeMin, totalLines);
+		const int colorTo = std::min(mColorRangeMax, totalLines);
+		const int to = std::min(std::max(colorTo, commentTo), totalLines);
+		const int from = std::min(std::min(colorFrom, commentFrom), to);
 
-		if (HasSelection())
+		if (from < to)
 		{
-			u.mRemoved = GetSelectedText();
-			u.mRemovedStart = mState.mSelectionStart;
-			u.mRemovedEnd = mState.mSelectionEnd;
-			DeleteSelection();
+			// all lines outside of the ranges to colorize are up to date, so the scan starts from the state of the line before
+			std::shared_ptr<ColorizeJob> job(new ColorizeJob());
+			job->mVersion = mTextVersion;
+			job->mLanguage = mLanguageDefinition;
+			job->mTokenScanner = mTokenScanner;
+			job->mRegexList = mRegexList;
+			job->mWordTable = mWordTable;
+			TakeSnapshot(job->mSnapshot, std::max(0, from - 1), to);
+			job->mColorFrom = colorFrom < colorTo ? colorFrom : 0;
+			job->mColorTo = colorFrom < colorTo ? colorTo : 0;
+			job->mVisibleFrom = firstVisible;
+			job->mVisibleTo = lastVisible;
+			job->mReady.assign(job->mSnapshot.mLineStarts.size() - 1, 0);
+			job->mScannedTo = job->mSnapshot.mFirstLine;
+			job->mDone = false;
+
+			worker.mActive = job;
+			worker.Submit(job);
 		}
+	}
 
-		u.mAdded = clipText;
-		u.mAddedStart = GetActualCursorCoordinates();
+	mCheckComments = false;
+	mColorRangeMin = std::numeric_limits<int>::max();
+	mColorRangeMax = 0;
+}
 
-		InsertText(clipText);
+// Applies the results of a job for the lines [aFromLine, aToLine) of its snapshot that are ready and not applied yet,
+// where those lines are now, leaving out the lines edited since the snapshot was taken. The worker mutex has to be locked.
+void TextEditor::ApplyColorizeJob(ColorizeJob& aJob, int aFromLine, int aToLine)
+{
+	const ColorizeSnapshot& snapshot(aJob.mSnapshot);
+	const bool moved = aJob.mVersion != mTextVersion;
 
-		u.mAddedEnd = GetActualCursorCoordinates();
-		u.mAfter = mState;
-		AddUndo(u);
+	for (int i = aFromLine; i < aToLine; ++i)
+	{
+		const int index = i - snapshot.mFirstLine;
+		const int lineIndex = moved ? aJob.FindLine(i) : i;
+		if (aJob.mReady[index] != 1 || lineIndex < 0)
+			continue;
+
+		aJob.mReady[index] = 2;
+
+		auto& line = mLines[lineIndex];
+		const size_t lineStart = snapshot.mLineStarts[index];
+		if (line.size() != snapshot.mLineStarts[index + 1] - lineStart)
+			continue;
+
+		if (!line.empty())
+			memcpy(line.GetInfo(), snapshot.mInfo.data() + lineStart, line.size());
+		line.mCommentState = snapshot.mStates[index];
 	}
 }
+#endif
 
-bool TextEditor::CanUndo() const
+float TextEditor::TextDistanceToLineStart(const Coordinates& aFrom) const
 {
-	return !mReadOnly && mUndoIndex > 0;
-}
+	auto& line = mLines[aFrom.mLine];
+	int colIndex = GetCharacterIndex(aFrom);
+	if (colIndex < 0 || colIndex > (int)line.size())
+		colIndex = (int)line.size();
 
-bool TextEditor::CanRedo() const
-{
-	return !mReadOnly && mUndoIndex < (int)mUndoBuffer.size();
+	return GetGlyphOffsets(line)[colIndex];
 }
 
-void TextEditor::Undo(int aSteps)
-{
-	while (CanUndo() && aSteps-- > 0)
-		mUndoBuffer[--mUndoIndex].Undo(this);
-}
+// Lines keeping their glyph offsets and wraps at once, a power of two well above the lines visible at a time.
+static const size_t kLineLayoutCacheSize = 1024;
 
-void TextEditor::Redo(int aSteps)
+// Entries taken over for another line release their arrays above this many elements, long lines being rare.
+static const size_t kLineLayoutKeptCapacity = 1024;
+
+// Returns the layout cache entry of a line, taking over the oldest entry if the line has none or lost it.
+// Entries stay valid until kLineLayoutCacheSize other lines took one, so a few lines can be used at once.
+TextEditor::LineLayout& TextEditor::GetLineLayout(const Line& aLine) const
 {
-	while (CanRedo() && aSteps-- > 0)
-		mUndoBuffer[mUndoIndex++].Redo(this);
+	if (mLineLayouts.empty())
+		mLineLayouts.resize(kLineLayoutCacheSize);
+
+	LineLayout& layout = mLineLayouts[aLine.mLayoutId & (kLineLayoutCacheSize - 1)];
+	if (aLine.mLayoutId != 0 && layout.mId == aLine.mLayoutId)
+		return layout;
+
+	aLine.mLayoutId = ++mLastLayoutId;
+
+	LineLayout& oldest = mLineLayouts[aLine.mLayoutId & (kLineLayoutCacheSize - 1)];
+	oldest.mId = aLine.mLayoutId;
+	oldest.mOffsetsGeneration = 0;
+	oldest.mWrapGeneration = 0;
+	if (oldest.mOffsets.capacity() > kLineLayoutKeptCapacity)
+		std::vector<float>().swap(oldest.mOffsets);
+	if (oldest.mWraps.capacity() > kLineLayoutKeptCapacity)
+		std::vector<int>().swap(oldest.mWraps);
+	return oldest;
 }
 
-const TextEditor::Palette & TextEditor::GetDarkPalette()
+// Returns the x offset of each byte of a line from its start, plus one more for the end of the line.
+// The bytes following the first one of an UTF-8 sequence get the offset after their character.
+// Offsets are cached for the lines last used, until the line is edited, or the font or tab size change.
+const float* TextEditor::GetGlyphOffsets(const Line& aLine) const
 {
-	const static Palette p = { {
-			0xff7f7f7f,	// Default
-			0xffd69c56,	// Keyword
-			0xff00ff00,	// Number
-			0xff7070e0,	// String
-			0xff70a0e0, // Char literal
-			0xffffffff, // Punctuation
-			0xff408080,	// Preprocessor
-			0xffaaaaaa, // Identifier
-			0xff9bc64d, // Known identifier
-			0xffc040a0, // Preproc identifier
-			0xff206020, // Comment (single line)
-			0xff406020, // Comment (multi line)
-			0xff101010, // Background
-			0xffe0e0e0, // Cursor
-			0x80a06020, // Selection
-			0x800020ff, // ErrorMarker
-			0x40f08000, // Breakpoint
-			0xff707000, // Line number
-			0x40000000, // Current line fill
-			0x40808080, // Current line fill (inactive)
-			0x40a0a0a0, // Current line edge
-		} };
-	return p;
+	LineLayout& layout = GetLineLayout(aLine);
+
+	if (layout.mOffsetsGeneration != mLayoutGeneration)
+	{
+		BuildGlyphOffsets(aLine, layout.mOffsets);
+		layout.mOffsetsGeneration = mLayoutGeneration;
+	}
+
+	return layout.mOffsets.data();
 }
 
-const TextEditor::Palette & TextEditor::GetLightPalette()
+void TextEditor::BuildGlyphOffsets(const Line& aLine, std::vector<float>& aOffsets) const
 {
-	const static Palette p = { {
-			0xff7f7f7f,	// None
-			0xffff0c06,	// Keyword
-			0xff008000,	// Number
-			0xff2020a0,	// String
-			0xff304070, // Char literal
-			0xff000000, // Punctuation
-			0xff406060,	// Preprocessor
-			0xff404040, // Identifier
-			0xff606010, // Known identifier
-			0xffc040a0, // Preproc identifier
-			0xff205020, // Comment (single line)
-			0xff405020, // Comment (multi line)
-			0xffffffff, // Background
-			0xff000000, // Cursor
-			0x80600000, // Selection
-			0xa00010ff, // ErrorMarker
-			0x80f08000, // Breakpoint
-			0xff505000, // Line number
-			0x40000000, // Current line fill
-			0x40808080, // Current line fill (inactive)
-			0x40000000, // Current line edge
-		} };
-	return p;
+	const size_t size = aLine.size();
+	const auto font = ImGui::GetFont();
+	const float fontSize = ImGui::GetFontSize();
+	const float spaceSize = font->CalcTextSizeA(fontSize, FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
+	const char* chars = aLine.GetChars();
+	float distance = 0.0f;
+
+	aOffsets.resize(size + 1);
+
+	for (size_t it = 0; it < size; )
+	{
+		aOffsets[it] = distance;
+
+		if (chars[it] == '\t')
+		{
+			distance = (1.0f + std::floor((1.0f + distance) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
+			++it;
+		}
+		else
+		{
+			const size_t end = std::min(it + UTF8CharLength(chars[it]), size);
+			distance += font->CalcTextSizeA(fontSize, FLT_MAX, -1.0f, chars + it, chars + end, nullptr).x;
+			while (++it < end)
+				aOffsets[it] = distance;
+		}
+	}
+
+	aOffsets[size] = distance;
 }
 
-const TextEditor::Palette & TextEditor::GetRetroBluePalette()
+// Invalidates the cached glyph offsets of all lines when the font changed since the last frame.
+void TextEditor::UpdateLayoutGeneration()
 {
-	const static Palette p = { {
-			0xff00ffff,	// None
-			0xffffff00,	// Keyword
-			0xff00ff00,	// Number
-			0xff808000,	// String
-			0xff808000, // Char literal
-			0xffffffff, // Punctuation
-			0xff008000,	// Preprocessor
-			0xff00ffff, // Identifier
-			0xffffffff, // Known identifier
-			0xffff00ff, // Preproc identifier
-			0xff808080, // Comment (single line)
-			0xff404040, // Comment (multi line)
-			0xff800000, // Background
-			0xff0080ff, // Cursor
-			0x80ffff00, // Selection
-			0xa00000ff, // ErrorMarker
-			0x80ff8000, // Breakpoint
-			0xff808000, // Line number
-			0x40000000, // Current line fill
-			0x40808080, // Current line fill (inactive)
-			0x40000000, // Current line edge
-		} };
-	return p;
-}
+	const ImFont* font = ImGui::GetFont();
+	const float fontSize = ImGui::GetFontSize();
 
+	if (font != mLayoutFont || fontSize != mLayoutFontSize)
+	{
+		mLayoutFont = font;
+		mLayoutFontSize = fontSize;
+		++mLayoutGeneration;
+	}
+}
 
-std::string TextEditor::GetText() const
+void TextEditor::WrapIndex::Reset(int aLines)
 {
-	return GetText(Coordinates(), Coordinates((int)mLines.size(), 0));
+	mRows.assign(aLines, 1);
+	mDirtyFirst = 0;
+	mDirtyEnd = aLines;
+	mPendingFirst = -1;
+	Build();
 }
 
-std::vector<std::string> TextEditor::GetTextLines() const
+void TextEditor::WrapIndex::Splice(int aFirst, int aRemoved, int aAdded)
 {
-	std::vector<std::string> result;
-
-	result.reserve(mLines.size());
+	aFirst = std::min(aFirst, size());
+	aRemoved = std::min(aRemoved, size() - aFirst);
 
-	for (auto & line : mLines)
+	// the dirty range moves along with the lines after the change, and grows to cover the added lines
+	const int removedEnd = aFirst + aRemoved;
+	const int addedEnd = aFirst + aAdded;
+	if (mDirtyFirst < mDirtyEnd)
 	{
-		std::string text;
-
-		text.resize(line.size());
+		mDirtyFirst = mDirtyFirst <= aFirst ? mDirtyFirst : mDirtyFirst >= removedEnd ? mDirtyFirst + aAdded - aRemoved : aFirst;
+		mDirtyEnd = mDirtyEnd <= aFirst ? mDirtyEnd : mDirtyEnd >= removedEnd ? mDirtyEnd + aAdded - aRemoved : addedEnd;
+		mDirtyFirst = std::min(mDirtyFirst, aFirst);
+		mDirtyEnd = std::max(mDirtyEnd, addedEnd);
+	}
+	else
+	{
+		mDirtyFirst = aFirst;
+		mDirtyEnd = addedEnd;
+	}
 
-		for (size_t i = 0; i < line.size(); ++i)
-			text[i] = line[i].mChar;
+	// replaced lines keep their row count until rewrapped, which is usually right
+	if (aRemoved == aAdded)
+		return;
 
-		result.emplace_back(std::move(text));
+	// merged like the pending text change, see AddLinesChange()
+	if (mPendingFirst < 0)
+	{
+		mPendingFirst = aFirst;
+		mPendingOldEnd = removedEnd;
+		mPendingNewEnd = addedEnd;
+		return;
 	}
 
-	return result;
+	if (aFirst < mPendingFirst)
+		mPendingFirst = aFirst;
+	if (removedEnd > mPendingNewEnd)
+	{
+		mPendingOldEnd += removedEnd - mPendingNewEnd;
+		mPendingNewEnd = removedEnd;
+	}
+	mPendingNewEnd += aAdded - aRemoved;
 }
 
-std::string TextEditor::GetSelectedText() const
+void TextEditor::WrapIndex::SetRows(int aLine, int aRows)
 {
-	return GetText(mState.mSelectionStart, mState.mSelectionEnd);
-}
+	Apply();
 
-std::string TextEditor::GetCurrentLineText()const
-{
-	auto lineLength = GetLineMaxColumn(mState.mCursorPosition.mLine);
-	return GetText(
-		Coordinates(mState.mCursorPosition.mLine, 0),
-		Coordinates(mState.mCursorPosition.mLine, lineLength));
-}
+	const int delta = aRows - mRows[aLine];
+	if (delta == 0)
+		return;
 
-void TextEditor::ProcessInputs()
-{
+	mRows[aLine] = aRows;
+	for (size_t i = aLine + 1; i < mTree.size(); i += i & (0 - i))
+		mTree[i] += delta;
 }
 
-void TextEditor::Colorize(int aFromLine, int aLines)
+int TextEditor::WrapIndex::GetFirstRow(int aLine)
 {
-	int toLine = aLines == -1 ? (int)mLines.size() : std::min((int)mLines.size(), aFromLine + aLines);
-	mColorRangeMin = std::min(mColorRangeMin, aFromLine);
-	mColorRangeMax = std::max(mColorRangeMax, toLine);
-	mColorRangeMin = std::max(0, mColorRangeMin);
-	mColorRangeMax = std::max(mColorRangeMin, mColorRangeMax);
-	mCheckComments = true;
+	Apply();
+
+	int row = 0;
+	for (size_t i = aLine; i > 0; i -= i & (0 - i))
+		row += mTree[i];
+	return row;
 }
 
-void TextEditor::ColorizeRange(int aFromLine, int aToLine)
+int TextEditor::WrapIndex::FindLine(int aRow, int& aRowInLine)
 {
-	if (mLines.empty() || aFromLine >= aToLine)
-		return;
+	Apply();
 
-	std::string buffer;
-	std::cmatch results;
-	std::string id;
-
-	int endLine = std::max(0, std::min((int)mLines.size(), aToLine));
-	for (int i = aFromLine; i < endLine; ++i)
+	const size_t count = mRows.size();
+	if (count == 0 || aRow < 0)
 	{
-		auto& line = mLines[i];
-
-		if (line.empty())
-			continue;
+		aRowInLine = 0;
+		return 0;
+	}
 
-		buffer.resize(line.size());
-		for (size_t j = 0; j < line.size(); ++j)
+	// descend the tree, skipping every line ending at or before the row
+	size_t line = 0;
+	int row = aRow;
+	size_t step = 1;
+	while (step * 2 <= count)
+		step *= 2;
+	for (; step > 0; step /= 2)
+	{
+		if (line + step <= count && mTree[line + step] <= row)
 		{
-			auto& col = line[j];
-			buffer[j] = col.mChar;
-			col.mColorIndex = PaletteIndex::Default;
+			line += step;
+			row -= mTree[line];
 		}
+	}
 
-		const char * bufferBegin = &buffer.front();
-		const char * bufferEnd = bufferBegin + buffer.size();
-
-		auto last = bufferEnd;
+	if (line >= count)
+	{
+		aRowInLine = mRows[count - 1] - 1;
+		return (int)count - 1;
+	}
 
-		for (auto first = bufferBegin; first != last; )
-		{
-			const char * token_begin = nullptr;
-			const char * token_end = nullptr;
-			PaletteIndex token_color = PaletteIndex::Default;
+	aRowInLine = row;
+	return (int)line;
+}
 
-			bool hasTokenizeResult = false;
+void TextEditor::WrapIndex::Apply()
+{
+	if (mPendingFirst < 0)
+		return;
 
-			if (mLanguageDefinition.mTokenize != nullptr)
-			{
-				if (mLanguageDefinition.mTokenize(first, last, token_begin, token_end, token_color))
-					hasTokenizeResult = true;
-			}
+	const int removed = mPendingOldEnd - mPendingFirst;
+	const int added = mPendingNewEnd - mPendingFirst;
+	const int kept = std::min(removed, added);
+	if (removed > kept)
+		mRows.erase(mRows.begin() + mPendingFirst + kept, mRows.begin() + mPendingOldEnd);
+	else
+		mRows.insert(mRows.begin() + mPendingFirst + kept, added - kept, 1);
 
-			if (hasTokenizeResult == false)
-			{
-				// todo : remove
-				//printf("using regex for %.*s\n", first + 10 < last ? 10 : int(last - first), first);
+	mPendingFirst = -1;
+	Build();
+}
 
-				for (auto& p : mRegexList)
-				{
-					if (std::regex_search(first, last, results, p.first, std::regex_constants::match_continuous))
-					{
-						hasTokenizeResult = true;
+void TextEditor::WrapIndex::Build()
+{
+	const size_t count = mRows.size();
+	mTree.assign(count + 1, 0);
+	for (size_t i = 1; i <= count; ++i)
+	{
+		mTree[i] += mRows[i - 1];
+		const size_t parent = i + (i & (0 - i));
+		if (parent <= count)
+			mTree[parent] += mTree[i];
+	}
+}
 
-						auto& v = *results.begin();
-						token_begin = v.first;
-						token_end = v.second;
-						token_color = p.second;
-						break;
-					}
-				}
-			}
+// Returns where the visual rows of a line start when word wrapped, but for the first one starting at 0.
+// Wraps are cached along with the glyph offsets of the line, and its row count is updated in the wrap index.
+const std::vector<int>& TextEditor::GetLineWraps(int aLine) const
+{
+	const Line& line = mLines[aLine];
+	LineLayout& layout = GetLineLayout(line);
 
-			if (hasTokenizeResult == false)
-			{
-				first++;
-			}
-			else
-			{
-				const size_t token_length = token_end - token_begin;
+	if (layout.mWrapGeneration != mWrapGeneration)
+	{
+		BuildLineWraps(line, GetGlyphOffsets(line), layout.mWraps);
+		layout.mWrapGeneration = mWrapGeneration;
+		mWrapIndex.SetRows(aLine, (int)layout.mWraps.size() + 1);
+	}
 
-				if (token_color == PaletteIndex::Identifier)
-				{
-					id.assign(token_begin, token_end);
+	return layout.mWraps;
+}
 
-					// todo : allmost all language definitions use lower case to specify keywords, so shouldn't this use ::tolower ?
-					if (!mLanguageDefinition.mCaseSensitive)
-						std::transform(id.begin(), id.end(), id.begin(), ::toupper);
+// Lines wrap after the last space or tab fitting in the wrap width, or within a word longer than the width.
+void TextEditor::BuildLineWraps(const Line& aLine, const float* aOffsets, std::vector<int>& aWraps) const
+{
+	const char* chars = aLine.GetChars();
+	const int size = (int)aLine.size();
 
-					if (!line[first - bufferBegin].mPreprocessor)
-					{
-						if (mLanguageDefinition.mKeywords.count(id) != 0)
-							token_color = PaletteIndex::Keyword;
-						else if (mLanguageDefinition.mIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::KnownIdentifier;
-						else if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::PreprocIdentifier;
-					}
-					else
-					{
-						if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::PreprocIdentifier;
-					}
-				}
+	aWraps.clear();
 
-				for (size_t j = 0; j < token_length; ++j)
-					line[(token_begin - bufferBegin) + j].mColorIndex = token_color;
+	for (int rowStart = 0; mWrapWidth > 0.0f;)
+	{
+		// the row can go up to the last character ending within the width
+		int end = (int)(std::upper_bound(aOffsets + rowStart + 1, aOffsets + size + 1, aOffsets[rowStart] + mWrapWidth) - aOffsets) - 1;
+		if (end >= size)
+			break;
+		while (end > rowStart && IsUTFSequence(chars[end]))
+			--end;
+
+		// a single space overflowing the width is kept at the end of the row, rather than starting the next one
+		int wrap = chars[end] == ' ' || chars[end] == '\t' ? end + 1 : end;
+		while (wrap > rowStart && chars[wrap - 1] != ' ' && chars[wrap - 1] != '\t')
+			--wrap;
+		if (wrap == rowStart)
+			wrap = end > rowStart ? end : std::min(rowStart + UTF8CharLength(chars[rowStart]), size);
+		if (wrap >= size)
+			break;
 
-				first = token_end;
-			}
-		}
+		aWraps.push_back(wrap);
+		rowStart = wrap;
 	}
 }
 
-void TextEditor::ColorizeInternal()
+// Lines rewrapped per frame besides the visible ones, once the wrap width changed.
+static const int kWrapLinesPerFrame = 4096;
+
+// Updates the wrap width from the window and rewraps the lines the index does not know the rows of.
+void TextEditor::UpdateWraps()
 {
-	if (mLines.empty() || !mColorizerEnabled)
+	if (!mWordWrap)
 		return;
 
-	if (mLanguageDefinition.mColorize && (mCheckComments || mColorRangeMin < mColorRangeMax))
+	if (mWrapIndex.size() != (int)mLines.size())
+		mWrapIndex.Reset((int)mLines.size());
+
+	// the vertical scrollbar is always left out, so it showing up or not does not rewrap the lines
+	const float width = std::max(mCharAdvance.x, ImGui::GetWindowWidth() - ImGui::GetStyle().ScrollbarSize - mTextStart - mCharAdvance.x);
+	if (width != mWrapWidth || mWrapLayoutGeneration != mLayoutGeneration)
 	{
-		mCheckComments = false;
-		mColorRangeMin = std::numeric_limits<int>::max();
-		mColorRangeMax = 0;
-		return mLanguageDefinition.mColorize(mLines, mLanguageDefinition.mColorizeData);
+		mWrapWidth = width;
+		mWrapLayoutGeneration = mLayoutGeneration;
+		++mWrapGeneration;
+		mWrapIndex.mDirtyFirst = 0;
+		mWrapIndex.mDirtyEnd = (int)mLines.size();
 	}
 
-	if (mCheckComments)
+	// lines only wrapped to count their rows are not cached, that would push the visible ones out
+	std::vector<float> offsets;
+	std::vector<int> wraps;
+	const int end = std::min(mWrapIndex.mDirtyEnd, mWrapIndex.mDirtyFirst + kWrapLinesPerFrame);
+	for (int i = mWrapIndex.mDirtyFirst; i < end; ++i)
 	{
-		auto endLine = mLines.size();
-		auto endIndex = 0;
-		auto commentStartLine = endLine;
-		auto commentStartIndex = endIndex;
-		auto withinString = false;
-		auto withinSingleLineComment = false;
-		auto withinPreproc = false;
-		auto firstChar = true;			// there is no other non-whitespace characters in the line before
-		auto concatenate = false;		// '\' on the very end of the line
-		auto currentLine = 0;
-		auto currentIndex = 0;
-		while (currentLine < endLine || currentIndex < endIndex)
-		{
-			auto& line = mLines[currentLine];
-
-			if (currentIndex == 0 && !concatenate)
-			{
-				withinSingleLineComment = false;
-				withinPreproc = false;
-				firstChar = true;
-			}
-
-			concatenate = false;
-
-			if (!line.empty())
-			{
-				auto& g = line[currentIndex];
-				auto c = g.mChar;
-
-				if (c != mLanguageDefinition.mPreprocChar && !isspace(c))
-					firstChar = false;
-
-				if (currentIndex == (int)line.size() - 1 && line[line.size() - 1].mChar == '\\')
-					concatenate = true;
-
-				bool inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+		const Line& line = mLines[i];
+		BuildGlyphOffsets(line, offsets);
+		BuildLineWraps(line, offsets.data(), wraps);
+		mWrapIndex.SetRows(i, (int)wraps.size() + 1);
+	}
+	mWrapIndex.mDirtyFirst = end;
+}
 
-				if (withinString)
-				{
-					line[currentIndex].mMultiLineComment = inComment;
+// Returns the visual row showing a position, and the x offset of the position from the start of that row.
+int TextEditor::GetVisualRow(const Coordinates& aPosition, float& aX) const
+{
+	if (!mWordWrap)
+	{
+		aX = TextDistanceToLineStart(aPosition);
+		return aPosition.mLine;
+	}
 
-					if (c == '\"')
-					{
-						if (currentIndex + 1 < (int)line.size() && line[currentIndex + 1].mChar == '\"')
-						{
-							currentIndex += 1;
-							if (currentIndex < (int)line.size())
-								line[currentIndex].mMultiLineComment = inComment;
-						}
-						else
-							withinString = false;
-					}
-					else if (c == '\\')
-					{
-						currentIndex += 1;
-						if (currentIndex < (int)line.size())
-							line[currentIndex].mMultiLineComment = inComment;
-					}
-				}
-				else
-				{
-					if (firstChar && c == mLanguageDefinition.mPreprocChar)
-						withinPreproc = true;
+	const int index = GetCharacterIndex(aPosition);
+	const auto& wraps = GetLineWraps(aPosition.mLine);
+	const float* offsets = GetGlyphOffsets(mLines[aPosition.mLine]);
+	const int rowInLine = (int)(std::upper_bound(wraps.begin(), wraps.end(), index) - wraps.begin());
 
-					if (c == '\"')
-					{
-						withinString = true;
-						line[currentIndex].mMultiLineComment = inComment;
-					}
-					else
-					{
-						auto pred = [](const char& a, const Glyph& b) { return a == b.mChar; };
-						auto from = line.begin() + currentIndex;
-						auto& startStr = mLanguageDefinition.mCommentStart;
-						auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
-
-						if (singleStartStr.size() > 0 &&
-							currentIndex + singleStartStr.size() <= line.size() &&
-							equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
-						{
-							if (currentIndex + startStr.size() > line.size())
-							{
-								withinSingleLineComment = true;
-							}
-							else if (!equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
-							{
-								withinSingleLineComment = true;
-							}
-						}
-						else if (!withinSingleLineComment && currentIndex + startStr.size() <= line.size() &&
-							equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
-						{
-							commentStartLine = currentLine;
-							commentStartIndex = currentIndex;
-						}
+	aX = offsets[index] - offsets[rowInLine > 0 ? wraps[rowInLine - 1] : 0];
+	return mWrapIndex.GetFirstRow(aPosition.mLine) + rowInLine;
+}
 
-						inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+// Returns the position closest to aX along a visual row, aX being relative to the left of the editor like mTextStart.
+TextEditor::Coordinates TextEditor::VisualRowToCoordinates(int aRow, float aX) const
+{
+	int lineNo = aRow;
+	int rowInLine = 0;
+	if (mWordWrap && aRow < mWrapIndex.GetTotalRows())
+		lineNo = mWrapIndex.FindLine(aRow, rowInLine);
 
-						line[currentIndex].mMultiLineComment = inComment;
-						line[currentIndex].mComment = withinSingleLineComment;
+	if (lineNo < 0 || lineNo >= (int)mLines.size())
+		return SanitizeCoordinates(Coordinates(lineNo, 0));
 
-						auto& endStr = mLanguageDefinition.mCommentEnd;
-						if (currentIndex + 1 >= (int)endStr.size() &&
-							equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
-						{
-							commentStartIndex = endIndex;
-							commentStartLine = endLine;
-						}
-					}
-				}
-				line[currentIndex].mPreprocessor = withinPreproc;
-				currentIndex += UTF8CharLength(c);
-				if (currentIndex >= (int)line.size())
-				{
-					currentIndex = 0;
-					++currentLine;
-				}
-			}
-			else
-			{
-				currentIndex = 0;
-				++currentLine;
-			}
-		}
-		mCheckComments = false;
-	}
+	auto& line = mLines[lineNo];
+	const float* offsets = GetGlyphOffsets(line);
+	const char* chars = line.GetChars();
 
-	if (mColorRangeMin < mColorRangeMax)
+	size_t rowStart = 0;
+	size_t rowEnd = line.size();
+	if (mWordWrap)
 	{
-		const int increment = (mLanguageDefinition.mTokenize == nullptr) ? 10 : 10000;
-		const int to = std::min(mColorRangeMin + increment, mColorRangeMax);
-		ColorizeRange(mColorRangeMin, to);
-		mColorRangeMin = to;
-
-		if (mColorRangeMax == mColorRangeMin)
-		{
-			mColorRangeMin = std::numeric_limits<int>::max();
-			mColorRangeMax = 0;
-		}
-		return;
+		const auto& wraps = GetLineWraps(lineNo);
+		rowInLine = std::min(rowInLine, (int)wraps.size());
+		rowStart = rowInLine > 0 ? wraps[rowInLine - 1] : 0;
+		rowEnd = rowInLine < (int)wraps.size() ? wraps[rowInLine] : line.size();
 	}
-}
+	const float rowX = offsets[rowStart];
 
-float TextEditor::TextDistanceToLineStart(const Coordinates& aFrom) const
-{
-	auto& line = mLines[aFrom.mLine];
-	float distance = 0.0f;
-	float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
-	int colIndex = GetCharacterIndex(aFrom);
-	for (size_t it = 0u; it < line.size() && it < colIndex; )
+	// Binary search for the first character whose middle is past the position.
+	// Bytes of the same character share its middle, so the search lands on the first byte of that character.
+	size_t first = rowStart;
+	size_t count = rowEnd - rowStart;
+
+	while (count > 0)
 	{
-		if (line[it].mChar == '\t')
+		const size_t step = count / 2;
+		size_t index = first + step;
+		while (index > 0 && IsUTFSequence(chars[index]))
+			--index;
+
+		const float columnX = offsets[index] - rowX;
+		const float columnWidth = offsets[index + 1] - offsets[index];
+		if (mTextStart + columnX + columnWidth * 0.5f > aX)
 		{
-			distance = (1.0f + std::floor((1.0f + distance) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-			++it;
+			count = step;
 		}
 		else
 		{
-			auto d = UTF8CharLength(line[it].mChar);
-			char tempCString[7];
-			int i = 0;
-			for (; i < 6 && d-- > 0 && it < (int)line.size(); i++, it++)
-				tempCString[i] = line[it].mChar;
-
-			tempCString[i] = '\0';
-			distance += ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, tempCString, nullptr, nullptr).x;
+			first += step + 1;
+			count -= step + 1;
 		}
 	}
 
-	return distance;
+	// the end of a wrapped row is the start of the next one, stay on the last character instead
+	if (first == rowEnd && rowEnd < line.size())
+	{
+		do
+			--first;
+		while (first > rowStart && IsUTFSequence(chars[first]));
+	}
+
+	return SanitizeCoordinates(Coordinates(lineNo, GetCharacterColumn(lineNo, (int)first)));
 }
 
 void TextEditor::EnsureCursorVisible()
@@ -2466,12 +5351,13 @@ void TextEditor::EnsureCursorVisible()
 	auto right = (int)ceil((scrollX + width) / mCharAdvance.x);
 
 	auto pos = GetActualCursorCoordinates();
-	auto len = TextDistanceToLineStart(pos);
+	float len;
+	auto row = GetVisualRow(pos, len);
 
-	if (pos.mLine < top)
-		ImGui::SetScrollY(std::max(0.0f, (pos.mLine - 1) * mCharAdvance.y));
-	if (pos.mLine > bottom - 4)
-		ImGui::SetScrollY(std::max(0.0f, (pos.mLine + 4) * mCharAdvance.y - height));
+	if (row < top)
+		ImGui::SetScrollY(std::max(0.0f, (row - 1) * mCharAdvance.y));
+	if (row > bottom - 4)
+		ImGui::SetScrollY(std::max(0.0f, (row + 4) * mCharAdvance.y - height));
 	if (len + mTextStart < left + 4)
 		ImGui::SetScrollX(std::max(0.0f, len + mTextStart - 4));
 	if (len + mTextStart > right - 4)
@@ -2506,6 +5392,185 @@ TextEditor::UndoRecord::UndoRecord(
 	assert(mRemovedStart <= mRemovedEnd);
 }
 
+// Undo texts of at least this size are compressed while in the history.
+static const size_t kUndoCompressMinSize = 16 * 1024;
+
+// Minimal LZ77 compression for large undo texts. The data is the original size followed by literal runs,
+// each one but the last followed by a back reference, with all sizes and offsets as LEB128 varints.
+static void AppendVarint(std::string& aOut, size_t aValue)
+{
+	while (aValue >= 0x80)
+	{
+		aOut += (char)(aValue | 0x80);
+		aValue >>= 7;
+	}
+	aOut += (char)aValue;
+}
+
+static size_t ReadVarint(const char *& aIn)
+{
+	size_t value = 0;
+	for (int shift = 0;; shift += 7)
+	{
+		const uint8_t b = (uint8_t)*aIn++;
+		value |= (size_t)(b & 0x7f) << shift;
+		if (b < 0x80)
+			return value;
+	}
+}
+
+static std::string CompressText(const std::string& aText)
+{
+	static const int kHashBits = 14;
+	std::vector<uint32_t> table(1u << kHashBits, 0); // last position + 1 of each hashed 4 byte sequence
+
+	const char * const src = aText.data();
+	const size_t size = aText.size();
+
+	std::string out;
+	out.reserve(size / 2);
+	AppendVarint(out, size);
+
+	size_t anchor = 0;
+	size_t i = 0;
+	while (i + 4 <= size)
+	{
+		uint32_t word;
+		memcpy(&word, src + i, 4);
+		const uint32_t hash = (word * 2654435761u) >> (32 - kHashBits);
+		const size_t candidate = table[hash];
+		table[hash] = (uint32_t)(i + 1);
+
+		if (candidate == 0 || memcmp(src + candidate - 1, src + i, 4) != 0)
+		{
+			++i;
+			continue;
+		}
+
+		const size_t match = candidate - 1;
+		size_t length = 4;
+		while (i + length < size && src[match + length] == src[i + length])
+			++length;
+
+		AppendVarint(out, i - anchor);
+		out.append(src + anchor, i - anchor);
+		AppendVarint(out, length - 4);
+		AppendVarint(out, i - match);
+
+		i += length;
+		anchor = i;
+	}
+
+	AppendVarint(out, size - anchor);
+	out.append(src + anchor, size - anchor);
+	return out;
+}
+
+static std::string DecompressText(const std::string& aData)
+{
+	const char * in = aData.data();
+	const size_t size = ReadVarint(in);
+
+	std::string out(size, '\0');
+	char * const dst = &out[0];
+	size_t pos = 0;
+
+	for (;;)
+	{
+		const size_t literals = ReadVarint(in);
+		memcpy(dst + pos, in, literals);
+		in += literals;
+		pos += literals;
+
+		if (pos >= size)
+			break;
+
+		const size_t length = ReadVarint(in) + 4;
+		const size_t offset = ReadVarint(in);
+		for (size_t j = 0; j < length; ++j, ++pos)
+			dst[pos] = dst[pos - offset];
+	}
+
+	return out;
+}
+
+static void CompactUndoText(std::string& aText, bool& aCompressed)
+{
+	if (aCompressed)
+		return;
+
+	if (aText.size() >= kUndoCompressMinSize)
+	{
+		std::string compressed = CompressText(aText);
+		if (compressed.size() < aText.size())
+		{
+			compressed.shrink_to_fit();
+			aText.swap(compressed);
+			aCompressed = true;
+			return;
+		}
+	}
+
+	aText.shrink_to_fit();
+}
+
+// Merges a typing or deleting step that directly follows this one, returns false if it can not be merged.
+bool TextEditor::UndoRecord::Merge(const UndoRecord& aOther)
+{
+	if (mTextVersion == 0 || mAddedCompressed || mRemovedCompressed)
+		return false;
+
+	if (mRemoved.empty() && aOther.mRemoved.empty() && !mAdded.empty() && !aOther.mAdded.empty())
+	{
+		// typing, broken at new lines and at the start of each word
+		if (aOther.mAddedStart != mAddedEnd || mAdded.find('\n') != std::string::npos || aOther.mAdded.find('\n') != std::string::npos)
+			return false;
+		if (isblank((uint8_t)mAdded.back()) && !isblank((uint8_t)aOther.mAdded.front()))
+			return false;
+
+		mAdded += aOther.mAdded;
+		mAddedEnd = aOther.mAddedEnd;
+	}
+	else if (mAdded.empty() && aOther.mAdded.empty() && !mRemoved.empty() && !aOther.mRemoved.empty())
+	{
+		if (mRemoved.find('\n') != std::string::npos || aOther.mRemoved.find('\n') != std::string::npos)
+			return false;
+
+		if (aOther.mRemovedEnd == mRemovedStart)
+		{
+			// backspacing
+			mRemoved.insert(0, aOther.mRemoved);
+			mRemovedStart = aOther.mRemovedStart;
+		}
+		else if (aOther.mRemovedStart == mRemovedStart && mRemovedStart.mLine == mRemovedEnd.mLine
+			&& mRemoved.find('\t') == std::string::npos && aOther.mRemoved.find('\t') == std::string::npos)
+		{
+			// deleting, without tabs every removed character takes a single column
+			mRemoved += aOther.mRemoved;
+			mRemovedEnd.mColumn += aOther.mRemovedEnd.mColumn - aOther.mRemovedStart.mColumn;
+		}
+		else
+			return false;
+	}
+	else
+		return false;
+
+	mAfter = aOther.mAfter;
+	return true;
+}
+
+void TextEditor::UndoRecord::Compact()
+{
+	CompactUndoText(mAdded, mAddedCompressed);
+	CompactUndoText(mRemoved, mRemovedCompressed);
+}
+
+// Approximate, string sizes are used instead of capacities as those are kept when records move around.
+size_t TextEditor::UndoRecord::GetMemoryUsage() const
+{
+	return sizeof(UndoRecord) + mAdded.size() + mRemoved.size();
+}
+
 void TextEditor::UndoRecord::Undo(TextEditor * aEditor)
 {
 	if (!mAdded.empty())
@@ -2517,7 +5582,7 @@ void TextEditor::UndoRecord::Undo(TextEditor * aEditor)
 	if (!mRemoved.empty())
 	{
 		auto start = mRemovedStart;
-		aEditor->InsertTextAt(start, mRemoved.c_str());
+		aEditor->InsertTextAt(start, mRemovedCompressed ? DecompressText(mRemoved).c_str() : mRemoved.c_str());
 		aEditor->Colorize(mRemovedStart.mLine - 1, mRemovedEnd.mLine - mRemovedStart.mLine + 2);
 	}
 
@@ -2537,7 +5602,7 @@ void TextEditor::UndoRecord::Redo(TextEditor * aEditor)
 	if (!mAdded.empty())
 	{
 		auto start = mAddedStart;
-		aEditor->InsertTextAt(start, mAdded.c_str());
+		aEditor->InsertTextAt(start, mAddedCompressed ? DecompressText(mAdded).c_str() : mAdded.c_str());
 		aEditor->Colorize(mAddedStart.mLine - 1, mAddedEnd.mLine - mAddedStart.mLine + 1);
 	}
 
@@ -2764,10 +5829,9 @@ static bool TokenizeCStylePunctuation(const char * in_begin, const char * in_end
 
 const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::CPlusPlus()
 {
-	static bool inited = false;
-	static LanguageDefinition langDef;
-	if (!inited)
+	static const LanguageDefinition& langDef = LanguageCache::Add([]() -> LanguageDefinition
 	{
+		LanguageDefinition langDef;
 		static const char* const cppKeywords[] = {
 			"alignas", "alignof", "and", "and_eq", "asm", "atomic_cancel", "atomic_commit", "atomic_noexcept", "auto", "bitand", "bitor", "bool", "break", "case", "catch", "char", "char16_t", "char32_t", "class",
 			"compl", "concept", "const", "constexpr", "const_cast", "continue", "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float",
@@ -2826,17 +5890,16 @@ const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::CPlusPlus(
 
 		langDef.mName = "C++";
 
-		inited = true;
-	}
+		return langDef;
+	}());
 	return langDef;
 }
 
 const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::HLSL()
 {
-	static bool inited = false;
-	static LanguageDefinition langDef;
-	if (!inited)
+	static const LanguageDefinition& langDef = LanguageCache::Add([]() -> LanguageDefinition
 	{
+		LanguageDefinition langDef;
 		static const char* const keywords[] = {
 			"AppendStructuredBuffer", "asm", "asm_fragment", "BlendState", "bool", "break", "Buffer", "ByteAddressBuffer", "case", "cbuffer", "centroid", "class", "column_major", "compile", "compile_fragment",
 			"CompileShader", "const", "continue", "ComputeShader", "ConsumeStructuredBuffer", "default", "DepthStencilState", "DepthStencilView", "discard", "do", "double", "DomainShader", "dword", "else",
@@ -2898,17 +5961,16 @@ const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::HLSL()
 
 		langDef.mName = "HLSL";
 
-		inited = true;
-	}
+		return langDef;
+	}());
 	return langDef;
 }
 
 const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::GLSL()
 {
-	static bool inited = false;
-	static LanguageDefinition langDef;
-	if (!inited)
+	static const LanguageDefinition& langDef = LanguageCache::Add([]() -> LanguageDefinition
 	{
+		LanguageDefinition langDef;
 		static const char* const keywords[] = {
 			"auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum", "extern", "float", "for", "goto", "if", "inline", "int", "long", "register", "restrict", "return", "short",
 			"signed", "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void", "volatile", "while", "_Alignas", "_Alignof", "_Atomic", "_Bool", "_Complex", "_Generic", "_Imaginary",
@@ -2947,17 +6009,16 @@ const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::GLSL()
 
 		langDef.mName = "GLSL";
 
-		inited = true;
-	}
+		return langDef;
+	}());
 	return langDef;
 }
 
 const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::C()
 {
-	static bool inited = false;
-	static LanguageDefinition langDef;
-	if (!inited)
+	static const LanguageDefinition& langDef = LanguageCache::Add([]() -> LanguageDefinition
 	{
+		LanguageDefinition langDef;
 		static const char* const keywords[] = {
 			"auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum", "extern", "float", "for", "goto", "if", "inline", "int", "long", "register", "restrict", "return", "short",
 			"signed", "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void", "volatile", "while", "_Alignas", "_Alignof", "_Atomic", "_Bool", "_Complex", "_Generic", "_Imaginary",
@@ -3013,17 +6074,16 @@ const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::C()
 
 		langDef.mName = "C";
 
-		inited = true;
-	}
+		return langDef;
+	}());
 	return langDef;
 }
 
 const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::SQL()
 {
-	static bool inited = false;
-	static LanguageDefinition langDef;
-	if (!inited)
+	static const LanguageDefinition& langDef = LanguageCache::Add([]() -> LanguageDefinition
 	{
+		LanguageDefinition langDef;
 		static const char* const keywords[] = {
 			"ADD", "EXCEPT", "PERCENT", "ALL", "EXEC", "PLAN", "ALTER", "EXECUTE", "PRECISION", "AND", "EXISTS", "PRIMARY", "ANY", "EXIT", "PRINT", "AS", "FETCH", "PROC", "ASC", "FILE", "PROCEDURE",
 			"AUTHORIZATION", "FILLFACTOR", "PUBLIC", "BACKUP", "FOR", "RAISERROR", "BEGIN", "FOREIGN", "READ", "BETWEEN", "FREETEXT", "READTEXT", "BREAK", "FREETEXTTABLE", "RECONFIGURE",
@@ -3077,17 +6137,16 @@ const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::SQL()
 
 		langDef.mName = "SQL";
 
-		inited = true;
-	}
+		return langDef;
+	}());
 	return langDef;
 }
 
 const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::AngelScript()
 {
-	static bool inited = false;
-	static LanguageDefinition langDef;
-	if (!inited)
+	static const LanguageDefinition& langDef = LanguageCache::Add([]() -> LanguageDefinition
 	{
+		LanguageDefinition langDef;
 		static const char* const keywords[] = {
 			"and", "abstract", "auto", "bool", "break", "case", "cast", "class", "const", "continue", "default", "do", "double", "else", "enum", "false", "final", "float", "for",
 			"from", "funcdef", "function", "get", "if", "import", "in", "inout", "int", "interface", "int8", "int16", "int32", "int64", "is", "mixin", "namespace", "not",
@@ -3127,17 +6186,16 @@ const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::AngelScrip
 
 		langDef.mName = "AngelScript";
 
-		inited = true;
-	}
+		return langDef;
+	}());
 	return langDef;
 }
 
 const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::Lua()
 {
-	static bool inited = false;
-	static LanguageDefinition langDef;
-	if (!inited)
+	static const LanguageDefinition& langDef = LanguageCache::Add([]() -> LanguageDefinition
 	{
+		LanguageDefinition langDef;
 		static const char* const keywords[] = {
 			"and", "break", "do", "", "else", "elseif", "end", "false", "for", "function", "if", "in", "", "local", "nil", "not", "or", "repeat", "return", "then", "true", "until", "while"
 		};
@@ -3181,7 +6239,7 @@ const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::Lua()
 
 		langDef.mName = "Lua";
 
-		inited = true;
-	}
+		return langDef;
+	}());
 	return langDef;
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdlib>
+#include <cstring>
+#include <new>
 #include <string>
 #include <vector>
 #include <array>
@@ -36,6 +39,7 @@ public:
 		CurrentLineFill,
 		CurrentLineFillInactive,
 		CurrentLineEdge,
+		SearchMatch,
 		Max
 	};
 
@@ -145,8 +149,292 @@ public:
 			mComment(false), mMultiLineComment(false), mPreprocessor(false) {}
 	};
 
-	typedef std::vector<Glyph> Line;
-	typedef std::vector<Line> Lines;
+	// A line of glyphs, stored as its raw UTF-8 bytes followed by as many info bytes packing the palette index
+	// with the comment and preprocessor flags, so each character takes 2 bytes and a line a single allocation.
+	// Lines made from a whole text share larger blocks instead, see ParseText(), and move to their own allocation
+	// once they need to grow. Glyphs are read and written by value, GetChars() and GetInfo() give direct access to both arrays.
+	class Line
+	{
+	public:
+		// layout of the info bytes
+		static const uint8_t kColorMask = 0x1f;
+		static const uint8_t kComment = 0x20;
+		static const uint8_t kMultiLineComment = 0x40;
+		static const uint8_t kPreprocessor = 0x80;
+
+		Line() : mData(nullptr), mSize(0), mCapacity(0), mLayoutId(0), mCommentState(0) {}
+		Line(const Line& aOther) : Line() { *this = aOther; }
+		Line(Line&& aOther) noexcept : mData(aOther.mData), mSize(aOther.mSize), mCapacity(aOther.mCapacity), mLayoutId(aOther.mLayoutId), mCommentState(aOther.mCommentState)
+		{
+			aOther.mData = nullptr;
+			aOther.mSize = aOther.mCapacity = 0;
+			aOther.mLayoutId = 0;
+		}
+		~Line() { Release(); }
+
+		Line& operator=(const Line& aOther)
+		{
+			if (this != &aOther)
+			{
+				clear();
+				reserve(aOther.mSize);
+				append(aOther, 0, aOther.mSize);
+				mCommentState = aOther.mCommentState;
+			}
+			return *this;
+		}
+
+		Line& operator=(Line&& aOther) noexcept
+		{
+			std::swap(mData, aOther.mData);
+			std::swap(mSize, aOther.mSize);
+			std::swap(mCapacity, aOther.mCapacity);
+			const uint64_t layoutId = mLayoutId;
+			mLayoutId = aOther.mLayoutId;
+			aOther.mLayoutId = layoutId;
+			mCommentState = aOther.mCommentState;
+			return *this;
+		}
+
+		size_t size() const { return mSize; }
+		bool empty() const { return mSize == 0; }
+		void clear() { mSize = 0; ClearLayout(); }
+		void reserve(size_t aSize) { if (aSize > GetCapacity()) Grow(aSize); }
+
+		Glyph operator[](size_t aIndex) const { return MakeGlyph((Char)mData[aIndex], GetInfo()[aIndex]); }
+		Glyph front() const { return (*this)[0]; }
+		Glyph back() const { return (*this)[mSize - 1]; }
+
+		void push_back(const Glyph& aGlyph) { insert(mSize, aGlyph); }
+
+		void insert(size_t aIndex, const Glyph& aGlyph)
+		{
+			uint8_t* info = MakeRoom(aIndex, 1);
+			mData[aIndex] = (char)aGlyph.mChar;
+			info[aIndex] = MakeInfo(aGlyph);
+		}
+
+		// Inserts the glyphs [aFirst, aLast) of another line at aIndex.
+		void insert(size_t aIndex, const Line& aOther, size_t aFirst, size_t aLast)
+		{
+			assert(&aOther != this);
+			if (aFirst == aLast)
+				return;
+			uint8_t* info = MakeRoom(aIndex, aLast - aFirst);
+			std::memcpy(mData + aIndex, aOther.mData + aFirst, aLast - aFirst);
+			std::memcpy(info + aIndex, aOther.GetInfo() + aFirst, aLast - aFirst);
+		}
+
+		void append(const Line& aOther, size_t aFirst, size_t aLast) { insert(mSize, aOther, aFirst, aLast); }
+
+		// Appends raw bytes, all of them using the same palette index.
+		void append(const char* aChars, size_t aSize, PaletteIndex aColorIndex = PaletteIndex::Default)
+		{
+			if (aSize == 0)
+				return;
+			const size_t index = mSize;
+			uint8_t* info = MakeRoom(index, aSize);
+			std::memcpy(mData + index, aChars, aSize);
+			std::memset(info + index, (uint8_t)aColorIndex, aSize);
+		}
+
+		void erase(size_t aIndex) { erase(aIndex, aIndex + 1); }
+		void erase(size_t aFirst, size_t aLast)
+		{
+			if (aFirst == aLast)
+				return;
+			uint8_t* info = GetInfo();
+			std::memmove(mData + aFirst, mData + aLast, mSize - aLast);
+			std::memmove(info + aFirst, info + aLast, mSize - aLast);
+			mSize -= (uint32_t)(aLast - aFirst);
+			ClearLayout();
+		}
+
+		const char* GetChars() const { return mData != nullptr ? mData : ""; }
+		const uint8_t* GetInfo() const { return reinterpret_cast<const uint8_t*>(mData) + GetCapacity(); }
+		uint8_t* GetInfo() { return reinterpret_cast<uint8_t*>(mData) + GetCapacity(); }
+
+		PaletteIndex GetColorIndex(size_t aIndex) const { return (PaletteIndex)(GetInfo()[aIndex] & kColorMask); }
+		void SetColorIndex(size_t aIndex, PaletteIndex aColorIndex) { uint8_t& info = GetInfo()[aIndex]; info = (info & ~kColorMask) | (uint8_t)aColorIndex; }
+
+		static uint8_t MakeInfo(const Glyph& aGlyph)
+		{
+			return (uint8_t)aGlyph.mColorIndex
+				| (aGlyph.mComment ? kComment : 0)
+				| (aGlyph.mMultiLineComment ? kMultiLineComment : 0)
+				| (aGlyph.mPreprocessor ? kPreprocessor : 0);
+		}
+
+		static Glyph MakeGlyph(Char aChar, uint8_t aInfo)
+		{
+			Glyph glyph(aChar, (PaletteIndex)(aInfo & kColorMask));
+			glyph.mComment = (aInfo & kComment) != 0;
+			glyph.mMultiLineComment = (aInfo & kMultiLineComment) != 0;
+			glyph.mPreprocessor = (aInfo & kPreprocessor) != 0;
+			return glyph;
+		}
+
+	private:
+		friend class TextEditor;
+
+		// set in mCapacity when mData is within a block shared with other lines
+		static const uint32_t kShared = 0x80000000u;
+
+		// capacity chars followed by capacity info bytes, the first mSize of each being used
+		char* mData;
+		uint32_t mSize;
+		uint32_t mCapacity;
+
+		// Entry of the editor's layout cache holding the glyph offsets and wraps of this line, 0 for none.
+		// Edits drop it, see GetLineLayout().
+		mutable uint64_t mLayoutId : 56;
+
+		// State of the comment scanner at the start of this line, so the colorizer can resume from any line, see ColorizeComments().
+		uint64_t mCommentState : 8;
+
+		void ClearLayout() { mLayoutId = 0; }
+
+		size_t GetCapacity() const { return mCapacity & ~kShared; }
+
+		// Drops this line's use of a shared block, freeing the block along with its last line.
+		static void ReleaseShared(char* aData);
+
+		// Makes this empty line use aCapacity chars and info bytes at aData, within a shared block.
+		void SetShared(char* aData, size_t aSize, size_t aCapacity)
+		{
+			assert(mData == nullptr && aSize <= aCapacity && aCapacity < kShared);
+			mData = aData;
+			mSize = (uint32_t)aSize;
+			mCapacity = (uint32_t)aCapacity | kShared;
+		}
+
+		void Release()
+		{
+			if (mCapacity & kShared)
+				ReleaseShared(mData);
+			else
+				std::free(mData);
+		}
+
+		void Grow(size_t aCapacity)
+		{
+			assert(aCapacity < kShared);
+			char* data;
+			if (mCapacity & kShared)
+			{
+				data = static_cast<char*>(std::malloc(aCapacity * 2));
+				if (data == nullptr)
+					throw std::bad_alloc();
+				std::memcpy(data, mData, mSize);
+				std::memcpy(data + aCapacity, GetInfo(), mSize);
+				ReleaseShared(mData);
+			}
+			else
+			{
+				data = static_cast<char*>(std::realloc(mData, aCapacity * 2));
+				if (data == nullptr)
+					throw std::bad_alloc();
+				// the info bytes follow the chars, move them past the new capacity
+				std::memmove(data + aCapacity, data + mCapacity, mSize);
+			}
+			mData = data;
+			mCapacity = (uint32_t)aCapacity;
+		}
+
+		// Opens a gap of aCount glyphs at aIndex, returns the info bytes
+		uint8_t* MakeRoom(size_t aIndex, size_t aCount)
+		{
+			if (mSize + aCount > GetCapacity())
+			{
+				const size_t doubled = GetCapacity() < 4 ? 8 : GetCapacity() * 2;
+				Grow(mSize + aCount > doubled ? mSize + aCount : doubled);
+			}
+			uint8_t* info = GetInfo();
+			std::memmove(mData + aIndex + aCount, mData + aIndex, mSize - aIndex);
+			std::memmove(info + aIndex + aCount, info + aIndex, mSize - aIndex);
+			mSize += (uint32_t)aCount;
+			ClearLayout();
+			return info;
+		}
+	};
+
+	// Line storage, a B+ tree of lines keyed by line index.
+	// Inserting, removing and looking up lines is O(log n) regardless of the document size,
+	// and sequential access is O(1) thanks to the last used leaf being cached.
+	// Like std::vector, references to lines are invalidated by inserting or removing lines.
+	class Lines
+	{
+	public:
+		template<class L, class T>
+		class Iterator
+		{
+		public:
+			Iterator(L* aLines, size_t aIndex) : mLines(aLines), mIndex(aIndex) {}
+
+			T& operator*() const { return (*mLines)[mIndex]; }
+			T* operator->() const { return &(*mLines)[mIndex]; }
+			Iterator& operator++() { ++mIndex; return *this; }
+			Iterator& operator--() { --mIndex; return *this; }
+			bool operator==(const Iterator& o) const { return mIndex == o.mIndex; }
+			bool operator!=(const Iterator& o) const { return mIndex != o.mIndex; }
+
+		private:
+			L* mLines;
+			size_t mIndex;
+		};
+
+		typedef Iterator<Lines, Line> iterator;
+		typedef Iterator<const Lines, const Line> const_iterator;
+
+		Lines();
+		Lines(const Lines& aOther);
+		Lines(Lines&& aOther) noexcept;
+		~Lines();
+
+		Lines& operator=(const Lines& aOther);
+		Lines& operator=(Lines&& aOther) noexcept;
+
+		size_t size() const { return mSize; }
+		bool empty() const { return mSize == 0; }
+
+		Line& operator[](size_t aIndex) { return aIndex - mCachedStart < mCachedCount ? mCachedLines[aIndex - mCachedStart] : Lookup(aIndex); }
+		const Line& operator[](size_t aIndex) const { return aIndex - mCachedStart < mCachedCount ? mCachedLines[aIndex - mCachedStart] : Lookup(aIndex); }
+		Line& at(size_t aIndex);
+		const Line& at(size_t aIndex) const;
+		Line& front() { return (*this)[0]; }
+		const Line& front() const { return (*this)[0]; }
+		Line& back() { return (*this)[mSize - 1]; }
+		const Line& back() const { return (*this)[mSize - 1]; }
+
+		iterator begin() { return iterator(this, 0); }
+		iterator end() { return iterator(this, mSize); }
+		const_iterator begin() const { return const_iterator(this, 0); }
+		const_iterator end() const { return const_iterator(this, mSize); }
+
+		void clear();
+		Line& insert(size_t aIndex, Line&& aLine);
+		// Adds aCount empty lines to the end at once, much faster than inserting them one by one.
+		void append(size_t aCount);
+		// Returns the line at aIndex and sets aCount to how many lines follow it contiguously in memory, itself included.
+		// Unlike operator[], several threads can call this at once.
+		Line* GetContiguous(size_t aIndex, size_t& aCount);
+		void erase(size_t aIndex) { erase(aIndex, aIndex + 1); }
+		void erase(size_t aFirst, size_t aLast);
+		Line& push_back(Line&& aLine) { return insert(mSize, std::move(aLine)); }
+		Line& emplace_back(Line&& aLine) { return insert(mSize, std::move(aLine)); }
+
+	private:
+		struct Node;
+
+		Node* FindLeaf(size_t aIndex, size_t& aOffset) const;
+		Line& Lookup(size_t aIndex) const;
+
+		Node* mRoot;
+		size_t mSize;
+		mutable Line* mCachedLines;
+		mutable size_t mCachedStart;
+		mutable size_t mCachedCount;
+	};
 
 	struct LanguageDefinition
 	{
@@ -182,6 +470,8 @@ public:
 		{
 		}
 
+		// Built on first use and shared by all editors, safe to call from any thread.
+		// Editors using these do not copy or compile anything.
 		static const LanguageDefinition& CPlusPlus();
 		static const LanguageDefinition& HLSL();
 		static const LanguageDefinition& GLSL();
@@ -192,10 +482,11 @@ public:
 	};
 
 	TextEditor();
+	explicit TextEditor(const LanguageDefinition& aLanguageDef);
 	~TextEditor();
 
 	void SetLanguageDefinition(const LanguageDefinition& aLanguageDef);
-	const LanguageDefinition& GetLanguageDefinition() const { return mLanguageDefinition; }
+	const LanguageDefinition& GetLanguageDefinition() const { return *mLanguageDefinition; }
 
 	const Palette& GetPalette() const { return mPaletteBase; }
 	void SetPalette(const Palette& aValue);
@@ -207,6 +498,14 @@ public:
 	void SetText(const std::string& aText);
 	std::string GetText() const;
 
+	// Appends text at the end of the document without touching the undo history, for loading a document in pieces.
+	void AppendText(const char* aText, size_t aSize);
+
+	// Passes the lines joined by new lines to aWrite in consecutive pieces, without building the whole text first.
+	// Stops as soon as aWrite returns false, in which case false is returned.
+	typedef bool(*WriteCallback)(const char* aData, size_t aSize, void* aUserData);
+	bool WriteText(WriteCallback aWrite, void* aUserData) const;
+
 	void SetTextLines(const std::vector<std::string>& aLines);
 	std::vector<std::string> GetTextLines() const;
 
@@ -223,9 +522,31 @@ public:
 
 	bool IsTextChangedSinceLastTime();
 
+	// A change of the text, mRemovedLines lines starting at mFirstLine were replaced by mAddedLines lines.
+	// mText holds the added lines joined by new lines.
+	struct TextChange
+	{
+		int mFirstLine;
+		int mRemovedLines;
+		int mAddedLines;
+		std::string mText;
+	};
+
+	// Called with the text changes and the text version after them, which only ever increases.
+	// All edits of a single operation arrive as one change: a paste, an undo step, a replace all, a whole frame of typing.
+	// The callback must not modify the editor.
+	typedef void(*TextChangeCallback)(const TextChange& aChange, uint64_t aVersion, void* aUserData);
+	void SetTextChangeCallback(TextChangeCallback aCallback, void* aUserData);
+	uint64_t GetTextVersion() const { return mTextVersion; }
+
 	bool IsColorizerEnabled() const { return mColorizerEnabled; }
 	void SetColorizerEnable(bool aValue);
 
+	// Tokenize in a background thread on a copy of the text, results are only applied to visible lines
+	bool IsColorizerThreaded() const { return mColorizerThreaded; }
+	void SetColorizerThreaded(bool aValue);
+	bool IsColorizing() const;
+
 	Coordinates GetCursorPosition() const { return GetActualCursorCoordinates(); }
 	void SetCursorPosition(const Coordinates& aPosition);
 
@@ -241,6 +562,11 @@ public:
 	inline void SetShowWhitespaces(bool aValue) { mShowWhitespaces = aValue; }
 	inline bool IsShowingWhitespaces() const { return mShowWhitespaces; }
 
+	// Soft wraps lines at the width of the editor, there is no horizontal scrolling then.
+	// Moving up and down and page up and down go through visual rows instead of lines.
+	void SetWordWrap(bool aValue);
+	inline bool IsWordWrapEnabled() const { return mWordWrap; }
+
 	void SetTabSize(int aValue);
 	inline int GetTabSize() const { return mTabSize; }
 
@@ -273,6 +599,23 @@ public:
 	void Undo(int aSteps = 1);
 	void Redo(int aSteps = 1);
 
+	// Consecutive typing, backspacing and deleting are merged into a single undo step.
+	// Once the history takes more than the memory limit (0 for none), the oldest steps are dropped.
+	void SetUndoMemoryLimit(size_t aBytes);
+	size_t GetUndoMemoryLimit() const { return mUndoMemoryLimit; }
+	size_t GetUndoMemoryUsage() const { return mUndoMemoryUsage; }
+
+	// Matches of the search text are highlighted in the visible lines, an empty text turns the search off.
+	// Matches never span several lines, case insensitive matching only folds ASCII letters.
+	void SetSearch(const std::string& aText, bool aCaseSensitive = true, bool aWholeWord = false);
+	const std::string& GetSearchText() const { return mSearchText; }
+
+	// Selects the next or previous match from the cursor, wrapping around the document. Returns false if there are none.
+	bool FindNext(bool aBackwards = false);
+
+	// Replaces all matches as a single undo step, returns how many were replaced.
+	int ReplaceAll(const std::string& aReplacement);
+
 	static const Palette& GetDarkPalette();
 	static const Palette& GetLightPalette();
 	static const Palette& GetRetroBluePalette();
@@ -280,6 +623,63 @@ public:
 private:
 	typedef std::vector<std::pair<std::regex, PaletteIndex>> RegexList;
 
+	class TokenScanner;
+	class WordTable;
+	class LanguageCache;
+	struct ColorizeSnapshot;
+	struct ColorizeJob;
+	class ColorizeWorker;
+
+	// Visual rows of the lines when word wrapped, as a Fenwick tree over the row count of each line.
+	// Finding the line at a row and the first row of a line are O(log n). Lines inserted or removed are
+	// merged into a single pending change, applied by rebuilding the tree in one O(n) pass when next needed.
+	class WrapIndex
+	{
+	public:
+		WrapIndex() : mDirtyFirst(0), mDirtyEnd(0), mPendingFirst(-1), mPendingOldEnd(0), mPendingNewEnd(0) {}
+
+		// Sets aLines lines of one row each, all of them dirty.
+		void Reset(int aLines);
+		// Replaces aRemoved lines at aFirst by aAdded dirty ones, counting one row each.
+		void Splice(int aFirst, int aRemoved, int aAdded);
+		void SetRows(int aLine, int aRows);
+
+		int size() const { return (int)mRows.size() + (mPendingFirst >= 0 ? mPendingNewEnd - mPendingOldEnd : 0); }
+		int GetRows(int aLine) { Apply(); return mRows[aLine]; }
+		int GetFirstRow(int aLine);
+		int GetTotalRows() { return GetFirstRow(size()); }
+		// Returns the line showing aRow and the row within that line, clamped to the last row.
+		int FindLine(int aRow, int& aRowInLine);
+
+		// lines whose row count may be out of date, all lines after changing the wrap width
+		int mDirtyFirst;
+		int mDirtyEnd;
+
+	private:
+		void Apply();
+		void Build();
+
+		std::vector<int> mRows;
+		std::vector<int> mTree;
+
+		// lines [mPendingFirst, mPendingOldEnd) of mRows are now [mPendingFirst, mPendingNewEnd), mPendingFirst is -1 when none
+		int mPendingFirst;
+		int mPendingOldEnd;
+		int mPendingNewEnd;
+	};
+
+	// Glyph offsets and wraps of a line, see GetGlyphOffsets() and GetLineWraps().
+	// Only the lines last drawn or navigated keep them, in a ring of entries reused oldest first.
+	// Lines refer to their entry by id, which stays valid while lines move around in the tree.
+	struct LineLayout
+	{
+		uint64_t mId = 0;
+		uint32_t mOffsetsGeneration = 0;
+		uint32_t mWrapGeneration = 0;
+		std::vector<float> mOffsets;
+		std::vector<int> mWraps;
+	};
+
 	struct EditorState
 	{
 		Coordinates mSelectionStart;
@@ -308,6 +708,10 @@ private:
 		void Undo(TextEditor* aEditor);
 		void Redo(TextEditor* aEditor);
 
+		bool Merge(const UndoRecord& aOther);
+		void Compact();
+		size_t GetMemoryUsage() const;
+
 		std::string mAdded;
 		Coordinates mAddedStart;
 		Coordinates mAddedEnd;
@@ -318,6 +722,10 @@ private:
 
 		EditorState mBefore;
 		EditorState mAfter;
+
+		uint64_t mTextVersion = 0;       // text version before a typing or deleting step, 0 if it can not be merged
+		bool mAddedCompressed = false;   // large texts are kept compressed
+		bool mRemovedCompressed = false;
 	};
 
 	typedef std::vector<UndoRecord> UndoBuffer;
@@ -326,7 +734,24 @@ private:
 	void Colorize(int aFromLine = 0, int aCount = -1);
 	void ColorizeRange(int aFromLine = 0, int aToLine = 0);
 	void ColorizeInternal();
+	void ColorizeThreaded();
+	void TakeSnapshot(ColorizeSnapshot& aSnapshot, int aFromLine, int aToLine) const;
+	void ApplySnapshot(const ColorizeSnapshot& aSnapshot, int aFromLine, int aToLine);
+	void ApplyColorizeJob(ColorizeJob& aJob, int aFromLine, int aToLine);
+	static void ColorizeComments(const LanguageDefinition& aLanguage, ColorizeSnapshot& aSnapshot, int aFromLine, int aToLine);
+	static void ColorizeTokens(const LanguageDefinition& aLanguage, const TokenScanner* aTokenScanner, const RegexList& aRegexList, const WordTable& aWordTable, ColorizeSnapshot& aSnapshot, int aFromLine, int aToLine);
 	float TextDistanceToLineStart(const Coordinates& aFrom) const;
+	LineLayout& GetLineLayout(const Line& aLine) const;
+	void BuildGlyphOffsets(const Line& aLine, std::vector<float>& aOffsets) const;
+	void BuildLineWraps(const Line& aLine, const float* aOffsets, std::vector<int>& aWraps) const;
+	const float* GetGlyphOffsets(const Line& aLine) const;
+	const std::vector<int>& GetLineWraps(int aLine) const;
+	void UpdateWraps();
+	int GetVisualRow(const Coordinates& aPosition, float& aX) const;
+	Coordinates VisualRowToCoordinates(int aRow, float aX) const;
+	size_t FindInLine(const Line& aLine, size_t aFrom) const;
+	void SelectMatch(int aLine, size_t aIndex);
+	void UpdateLayoutGeneration();
 	void EnsureCursorVisible();
 	int GetPageSize() const;
 	std::string GetText(const Coordinates& aStart, const Coordinates& aEnd) const;
@@ -336,6 +761,8 @@ private:
 	void DeleteRange(const Coordinates& aStart, const Coordinates& aEnd);
 	int InsertTextAt(Coordinates& aWhere, const char* aValue);
 	void AddUndo(UndoRecord& aValue);
+	void ParseText(const char* aText, size_t aSize);
+	void TrimUndo();
 	Coordinates ScreenPosToCoordinates(const ImVec2& aPosition) const;
 	Coordinates FindWordStart(const Coordinates& aFrom) const;
 	Coordinates FindWordEnd(const Coordinates& aFrom) const;
@@ -348,12 +775,14 @@ private:
 	void RemoveLine(int aStart, int aEnd);
 	void RemoveLine(int aIndex);
 	Line& InsertLine(int aIndex);
+	void AddLinesChange(int aFirst, int aRemoved, int aAdded);
+	void FlushTextChange();
 	void EnterCharacter(ImWchar aChar, bool aShift);
 	void Backspace();
 	void DeleteSelection();
 	std::string GetWordUnderCursor() const;
 	std::string GetWordAt(const Coordinates& aCoords) const;
-	ImU32 GetGlyphColor(const Glyph& aGlyph) const;
+	ImU32 GetGlyphColor(uint8_t aInfo) const;
 
 	void HandleKeyboardInputs();
 	void HandleMouseInputs();
@@ -364,6 +793,9 @@ private:
 	EditorState mState;
 	UndoBuffer mUndoBuffer;
 	int mUndoIndex;
+	size_t mUndoMemoryUsage;
+	size_t mUndoMemoryLimit;
+	uint64_t mUndoTextVersion;          // text version right after the last undo step was added
 
 	int mTabSize;
 	bool mOverwrite;
@@ -374,7 +806,12 @@ private:
 	bool mTextChanged;
 	bool mTextChangedSinceLastTime;
 	bool mColorizerEnabled;
+	bool mColorizerThreaded;
+	uint64_t mTextVersion;              // incremented on every text change, used to discard stale colorizer results
 	float mTextStart;                   // position (in pixels) where a code line starts relative to the left of the TextEditor.
+	uint32_t mLayoutGeneration;         // incremented when the font or tab size change, invalidates the glyph offsets of all lines
+	const ImFont* mLayoutFont;
+	float mLayoutFontSize;
 	int  mLeftMargin;
 	bool mCursorPositionChanged;
 	int mColorRangeMin, mColorRangeMax;
@@ -383,19 +820,41 @@ private:
 	bool mHandleMouseInputs;
 	bool mIgnoreImGuiChild;
 	bool mShowWhitespaces;
+	bool mWordWrap;
+	float mWrapWidth;                   // width lines are wrapped at, 0 until the first frame with word wrap on
+	uint32_t mWrapGeneration;           // incremented when the wrap width or the layout change, invalidates the wraps of all lines
+	uint32_t mWrapLayoutGeneration;     // layout generation the wraps are made for
+	mutable WrapIndex mWrapIndex;       // row counts are updated whenever a line gets wrapped
+	mutable std::vector<LineLayout> mLineLayouts; // see GetLineLayout()
+	mutable uint64_t mLastLayoutId;
 
 	Palette mPaletteBase;
 	Palette mPalette;
-	LanguageDefinition mLanguageDefinition;
-	RegexList mRegexList;
+	std::shared_ptr<const LanguageDefinition> mLanguageDefinition; // shared with the colorizer thread, never modified
+	std::shared_ptr<const TokenScanner> mTokenScanner; // shared by all editors using the same token regexes
+	std::shared_ptr<const RegexList> mRegexList;        // only used when the token regexes can not be compiled into a scanner
+	std::shared_ptr<const WordTable> mWordTable;        // keywords and identifiers, shared like the token scanner
+	std::unique_ptr<ColorizeWorker> mColorizeWorker;
 
 	bool mCheckComments;
 	Breakpoints mBreakpoints;
 	ErrorMarkers mErrorMarkers;
 	ImVec2 mCharAdvance;
 	Coordinates mInteractiveStart, mInteractiveEnd;
-	std::string mLineBuffer;
+	Line mInsertBuffer;
 	uint64_t mStartTime;
 
 	float mLastClick;
+
+	std::string mSearchText;
+	std::string mSearchNeedle;          // search text as matched, lower cased when not case sensitive
+	bool mSearchCaseSensitive;
+	bool mSearchWholeWord;
+
+	// lines changed since the last text change callback, mChangeFirst is -1 when there are none
+	TextChangeCallback mTextChangeCallback;
+	void* mTextChangeUserData;
+	int mChangeFirst;
+	int mChangeOldEnd;
+	int mChangeNewEnd;
 };
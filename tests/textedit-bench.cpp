@@ -0,0 +1,170 @@
+/*
+ * DISTRHO Plugin Framework (DPF)
+ * Copyright (C) 2012-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Compares the TextEditor line storage against the old vector-of-vectors layout, no window needed
+#include "../opengl/DearImGui/imgui.h"
+#include "../opengl/DearImGuiColorTextEditor/TextEditor.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+typedef std::vector<TextEditor::Line> VectorLines;
+
+static const size_t kDocumentLines = 100000;
+
+static uint32_t randomState = 1;
+
+static size_t randomIndex(const size_t count)
+{
+    randomState = randomState * 1664525u + 1013904223u;
+    return count != 0 ? (randomState >> 8) % count : 0;
+}
+
+static TextEditor::Line makeLine(const size_t length)
+{
+    TextEditor::Line line;
+    line.reserve(length);
+    for (size_t i = 0; i < length; ++i)
+        line.push_back(TextEditor::Glyph('a' + i % 26, TextEditor::PaletteIndex::Default));
+    return line;
+}
+
+// small adapters so the same benchmark code runs on both layouts
+static void insertLine(VectorLines& lines, const size_t index, TextEditor::Line&& line)
+{
+    lines.insert(lines.begin() + index, std::move(line));
+}
+
+static void insertLine(TextEditor::Lines& lines, const size_t index, TextEditor::Line&& line)
+{
+    lines.insert(index, std::move(line));
+}
+
+static void eraseLines(VectorLines& lines, const size_t first, const size_t last)
+{
+    lines.erase(lines.begin() + first, lines.begin() + last);
+}
+
+static void eraseLines(TextEditor::Lines& lines, const size_t first, const size_t last)
+{
+    lines.erase(first, last);
+}
+
+template <class L>
+static void fill(L& lines)
+{
+    for (size_t i = 0; i < kDocumentLines; ++i)
+        lines.push_back(makeLine(i % 80));
+}
+
+template <class L>
+static size_t run(L& lines, const int test)
+{
+    size_t checksum = 0;
+
+    switch (test)
+    {
+    case 0:
+        fill(lines);
+        break;
+    case 1:
+        for (int i = 0; i < 2000; ++i)
+        {
+            const size_t index = randomIndex(lines.size() + 1);
+            insertLine(lines, index, makeLine(index % 80));
+        }
+        break;
+    case 2:
+        for (int i = 0; i < 2000; ++i)
+        {
+            const size_t index = randomIndex(lines.size());
+            eraseLines(lines, index, index + 1);
+        }
+        break;
+    case 3:
+        for (int i = 0; i < 100; ++i)
+        {
+            const size_t index = randomIndex(lines.size() + 1);
+            for (size_t j = 0; j < 200; ++j)
+                insertLine(lines, index + j, makeLine(j % 80));
+        }
+        break;
+    case 4:
+        for (int i = 0; i < 100; ++i)
+        {
+            const size_t index = randomIndex(lines.size() - 200);
+            eraseLines(lines, index, index + 200);
+        }
+        break;
+    case 5:
+        for (int i = 0; i < 1000000; ++i)
+            checksum += lines[randomIndex(lines.size())].size();
+        break;
+    case 6:
+        for (int i = 0; i < 10; ++i)
+            for (size_t j = 0, count = lines.size(); j < count; ++j)
+                checksum += lines[j].size();
+        break;
+    }
+
+    return checksum;
+}
+
+template <class L>
+static double measure(L& lines, const int test, size_t& checksum)
+{
+    randomState = 1;
+    const auto start = std::chrono::steady_clock::now();
+    checksum += run(lines, test);
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int, char**)
+{
+    static const char* const names[] = {
+        "append-100k-lines",
+        "insert-2k-lines",
+        "erase-2k-lines",
+        "paste-100x200-lines",
+        "cut-100x200-lines",
+        "lookup-1M-random",
+        "scan-10x-sequential",
+    };
+
+    VectorLines vectorLines;
+    TextEditor::Lines treeLines;
+    size_t vectorChecksum = 0;
+    size_t treeChecksum = 0;
+
+    std::printf("%-24s %14s %14s\n", "# test", "vector (ms)", "lines (ms)");
+
+    for (int test = 0; test < 7; ++test)
+    {
+        const double vectorTime = measure(vectorLines, test, vectorChecksum);
+        const double treeTime = measure(treeLines, test, treeChecksum);
+        std::printf("%-24s %14.3f %14.3f\n", names[test], vectorTime, treeTime);
+    }
+
+    if (vectorChecksum != treeChecksum || vectorLines.size() != treeLines.size())
+    {
+        std::fprintf(stderr, "line storage mismatch\n");
+        return 1;
+    }
+
+    return 0;
+}
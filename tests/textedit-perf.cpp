@@ -0,0 +1,247 @@
+/*
+ * DISTRHO Plugin Framework (DPF)
+ * Copyright (C) 2012-2024 Filipe Coelho <falktx@falktx.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any purpose with
+ * or without fee is hereby granted, provided that the above copyright notice and this
+ * permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD
+ * TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN
+ * NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL
+ * DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER
+ * IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Times the TextEditor paths users hit on large documents, no window needed.
+// ImGui frames are generated as usual but their draw data is never submitted anywhere.
+// Prints one "document test ms ops" line per measurement, lines starting with '#' are comments.
+#include "../opengl/DearImGui/imgui.h"
+#include "../opengl/DearImGuiColorTextEditor/TextEditor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const int kRenderFrames = 300;
+static const int kEdits = 1000;
+
+static uint32_t randomState = 1;
+
+static int randomIndex(const int count)
+{
+    randomState = randomState * 1664525u + 1013904223u;
+    return count > 0 ? (int)((randomState >> 8) % (uint32_t)count) : 0;
+}
+
+// C++ looking text, so that comments, strings, numbers, keywords and identifiers all get colorized
+static std::string makeDocument(const size_t size, const size_t lineLength)
+{
+    static const char* const snippets[] = {
+        "int ", "float ", "value", "_", "index", " = ", "0x7f", "3.25f", "(", ")", "[", "]", ", ",
+        "; ", "return ", "if ", "while ", "\"some string\" ", "'c' ", "// comment ", "/* block */ ",
+        "+ ", "- ", "* ", "std::vector<int> ", "const ", "\t", "    ", "\xc3\xa9", "\xe2\x82\xac",
+    };
+    static const int snippetCount = sizeof(snippets) / sizeof(snippets[0]);
+
+    std::string text;
+    text.reserve(size + lineLength + 64);
+    randomState = 1;
+
+    while (text.size() < size)
+    {
+        const size_t length = lineLength / 2 + (size_t)randomIndex((int)lineLength);
+        const size_t lineStart = text.size();
+
+        while (text.size() - lineStart < length)
+            text += snippets[randomIndex(snippetCount)];
+
+        text += (randomIndex(8) == 0) ? "{\n" : (randomIndex(8) == 0) ? "}\n" : "\n";
+    }
+
+    return text;
+}
+
+static void renderFrame(TextEditor& editor)
+{
+    ImGuiIO& io(ImGui::GetIO());
+    io.DeltaTime = 1.f / 60.f;
+
+    ImGui::NewFrame();
+    ImGui::SetNextWindowPos(ImVec2(0, 0));
+    ImGui::SetNextWindowSize(io.DisplaySize);
+    ImGui::Begin("textedit-perf", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoMove);
+    editor.Render("editor");
+    ImGui::End();
+    ImGui::Render();
+}
+
+// positions come from the original lines, the editor clamps them to its current text
+static TextEditor::Coordinates randomCoordinates(const TextEditor& editor, const std::vector<std::string>& lines)
+{
+    const int line = randomIndex(std::min(editor.GetTotalLines(), (int)lines.size()));
+    return TextEditor::Coordinates(line, randomIndex((int)lines[line].size() + 1));
+}
+
+template <class F>
+static void measure(const char* const document, const char* const test, F&& function)
+{
+    randomState = 1;
+    const auto start = std::chrono::steady_clock::now();
+    const size_t ops = function();
+    const auto end = std::chrono::steady_clock::now();
+    std::printf("%-12s %-20s %14.3f %10zu\n", document, test, std::chrono::duration<double, std::milli>(end - start).count(), ops);
+    std::fflush(stdout);
+}
+
+static bool runDocument(const char* const name, const std::string& text)
+{
+    TextEditor editor;
+    editor.SetLanguageDefinition(TextEditor::LanguageDefinition::CPlusPlus());
+    editor.SetColorizerThreaded(false);
+
+    measure(name, "set-text", [&]() -> size_t {
+        editor.SetText(text);
+        return text.size();
+    });
+
+    // GetText() ends every line with a newline, including the last one
+    const std::string expected(text + "\n");
+
+    bool ok = true;
+    measure(name, "get-text", [&]() -> size_t {
+        const std::string result(editor.GetText());
+        ok = result == expected;
+        return result.size();
+    });
+
+    if (! ok)
+    {
+        std::fprintf(stderr, "%s: text mismatch after SetText/GetText\n", name);
+        return false;
+    }
+
+    measure(name, "colorize", [&]() -> size_t {
+        size_t frames = 0;
+        do {
+            renderFrame(editor);
+            ++frames;
+        } while (editor.IsColorizing());
+        return frames;
+    });
+
+    // jumping the cursor scrolls the view both ways, so each frame draws a different part of the document
+    const std::vector<std::string> lines(editor.GetTextLines());
+
+    measure(name, "render", [&]() -> size_t {
+        for (int i = 0; i < kRenderFrames; ++i)
+        {
+            editor.SetCursorPosition(randomCoordinates(editor, lines));
+            renderFrame(editor);
+        }
+        return kRenderFrames;
+    });
+
+    // the first frames also wrap the lines not visible, a chunk of them per frame
+    editor.SetWordWrap(true);
+
+    measure(name, "render-wrapped", [&]() -> size_t {
+        for (int i = 0; i < kRenderFrames; ++i)
+        {
+            editor.SetCursorPosition(randomCoordinates(editor, lines));
+            renderFrame(editor);
+        }
+        return kRenderFrames;
+    });
+
+    editor.SetWordWrap(false);
+
+    // Paste and Delete go through the same undo records as typing and cutting
+    ImGui::SetClipboardText("value = index(3.25f); // pasted\n\t");
+
+    measure(name, "insert", [&]() -> size_t {
+        for (int i = 0; i < kEdits; ++i)
+        {
+            const TextEditor::Coordinates pos(randomCoordinates(editor, lines));
+            editor.SetSelection(pos, pos);
+            editor.SetCursorPosition(pos);
+            editor.Paste();
+        }
+        return kEdits;
+    });
+
+    measure(name, "delete", [&]() -> size_t {
+        for (int i = 0; i < kEdits; ++i)
+        {
+            const TextEditor::Coordinates pos(randomCoordinates(editor, lines));
+            const TextEditor::Coordinates end(pos.mLine + randomIndex(2), pos.mColumn + randomIndex(16));
+            editor.SetSelection(pos, end);
+            editor.Delete();
+        }
+        return kEdits;
+    });
+
+    measure(name, "undo", [&]() -> size_t {
+        size_t steps = 0;
+        for (; editor.CanUndo(); ++steps)
+            editor.Undo();
+        return steps;
+    });
+
+    if (editor.GetText() != expected)
+    {
+        std::fprintf(stderr, "%s: text mismatch after undoing all edits\n", name);
+        return false;
+    }
+
+    measure(name, "redo", [&]() -> size_t {
+        size_t steps = 0;
+        for (; editor.CanRedo(); ++steps)
+            editor.Redo();
+        return steps;
+    });
+
+   #ifndef TEXTEDITOR_NO_THREADS
+    editor.SetColorizerThreaded(true);
+    editor.SetText(text);
+
+    measure(name, "colorize-threaded", [&]() -> size_t {
+        size_t frames = 0;
+        do {
+            renderFrame(editor);
+            ++frames;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        } while (editor.IsColorizing());
+        return frames;
+    });
+   #endif
+
+    return true;
+}
+
+int main(int, char**)
+{
+    ImGui::CreateContext();
+
+    ImGuiIO& io(ImGui::GetIO());
+    io.DisplaySize = ImVec2(1280, 720);
+    io.IniFilename = nullptr;
+
+    // the font atlas needs to be built before the first frame, but its texture is never uploaded
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    std::printf("%-12s %-20s %14s %10s\n", "# document", "test", "ms", "ops");
+
+    bool ok = runDocument("1mb", makeDocument(1024 * 1024, 80));
+    ok = ok && runDocument("10mb", makeDocument(10 * 1024 * 1024, 80));
+    ok = ok && runDocument("long-lines", makeDocument(4 * 1024 * 1024, 64 * 1024));
+
+    ImGui::DestroyContext();
+    return ok ? 0 : 1;
+}